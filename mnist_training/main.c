@@ -13,6 +13,8 @@
 #define LEARNING_RATE 0.001f
 #define BATCH_SIZE 64
 #define NUM_EPOCHS 100
+#define NUM_THREADS 4
+#define TEST_BATCH_SIZE 1000
 
 #define SAVE_PATH_MAX 64
 
@@ -23,29 +25,30 @@ int main() {
     // === Data preparation ===
     fputs("Preparing data...\n", stdout);  // Log
 
-    float **data = read_csv_data("../mnist_preparation/data.csv", NUM_SAMPLES, INPUT_SIZE);
-    if (!data) {
+    // Converted once with synapse-convert; samples stay in the mapped files
+    // and labels are stored as class indices
+    SynDataset *dataset = syn_dataset_from_tensors("../mnist_preparation/data.syt", "../mnist_preparation/labels.syt");
+    if (!dataset) {
         fprintf(stderr, "Error: Failed to read data.\n");
         return 1;
     }
 
-    float **labels = read_csv_labels("../mnist_preparation/labels.csv", NUM_SAMPLES, NUM_CLASSES);
-    if (!labels) {
-        fprintf(stderr, "Error: Failed to read labels.\n");
+    if (syn_dataset_size(dataset) != NUM_SAMPLES || syn_dataset_input_size(dataset) != INPUT_SIZE ||
+        !syn_dataset_has_classes(dataset)
+    ) {
+        fprintf(stderr, "Error: Unexpected data shape.\n");
         return 1;
     }
     
-    // Split data
-    float **train_data, **test_data, **train_labels, **test_labels;
-    int train_count, test_count;
+    // Split data (views, nothing is copied)
+    SynDataset *train_set, *test_set;
+    if (syn_dataset_split(dataset, 0.2f, &train_set, &test_set)) {
+        return 1;
+    }
+    syn_dataset_delete(dataset);
 
-    split_data(data, labels, NUM_SAMPLES, INPUT_SIZE, NUM_CLASSES, 0.2f,
-        &train_data, &test_data, &train_labels, &test_labels,
-        &train_count, &test_count);
-    
-    // Memory deallocation
-    delete_data(data, NUM_SAMPLES);
-    delete_labels(labels, NUM_SAMPLES);
+    long train_count = syn_dataset_size(train_set);
+    long test_count = syn_dataset_size(test_set);
 
     fputs("Data preparation complete.\n", stdout);  // Log
     
@@ -61,20 +64,34 @@ int main() {
     setup_optimizer(adam, LEARNING_RATE);
     
     // === Training loop ===
+    // Reshuffled every epoch; the next batch is gathered while this one trains
+    SynBatchIter *train_batches = syn_batch_iter_create(train_set, BATCH_SIZE, 1, (unsigned long long)time(NULL));
+    if (!train_batches) {
+        return 1;
+    }
+
+    // Per-layer timings of the first epoch
+    synapse_profile_enable(1);
+
     for (int epoch = 0; epoch < NUM_EPOCHS; ++epoch) {
         float epoch_loss = 0.0f;
+        const float *inputs;
+        const int32_t *labels;
+        int batch_size;
+
+        while ((batch_size = syn_batch_iter_next_classes(train_batches, &inputs, &labels)) > 0) {
+            zero_grads();
+            epoch_loss += train_batch_parallel_sparse(inputs, labels, batch_size, NUM_THREADS);
+            update_weights();
+        }
 
-        for (int sample = 0; sample < train_count; ++sample) {
-            // Forward pass
-            forward(train_data[sample]);
-            epoch_loss += compute_loss(train_labels[sample]);
-
-            // Backward pass
-            backward(train_data[sample], train_labels[sample]);
-            if (sample % BATCH_SIZE == 0 || sample == train_count - 1) {
-                update_weights();
-                zero_grads();
-            }
+        if (batch_size < 0) {
+            return 1;
+        }
+
+        if (epoch == 0) {
+            synapse_profile_enable(0);
+            synapse_profile_report(stdout, SYN_PROFILE_TABLE);
         }
 
         if ((epoch + 1) % 10 == 0) {
@@ -82,12 +99,28 @@ int main() {
         }
     }
 
+    syn_batch_iter_delete(train_batches);
+
     // Testing loop
+    SynBatchIter *test_batches = syn_batch_iter_create(test_set, TEST_BATCH_SIZE, 0, 0);
+    if (!test_batches) {
+        return 1;
+    }
+
     int num_correct = 0;
-    for (int sample = 0; sample < test_count; ++sample) {
-        float *predicts = forward(test_data[sample]);
-        num_correct += (find_max_index(predicts, NUM_CLASSES) == find_max_index(test_labels[sample], NUM_CLASSES));
+    const float *inputs;
+    const int32_t *labels;
+    int batch_size;
+
+    while ((batch_size = syn_batch_iter_next_classes(test_batches, &inputs, &labels)) > 0) {
+        const float *predicts = forward_batch(inputs, batch_size);
+
+        for (int b = 0; b < batch_size; ++b) {
+            num_correct += (find_max_index(&predicts[b * NUM_CLASSES], NUM_CLASSES) == labels[b]);
+        }
     }
+
+    syn_batch_iter_delete(test_batches);
     
     float accuracy = (float)num_correct / test_count * 100;
     printf("Accuracy: %.1f%%\n", accuracy);
@@ -101,7 +134,8 @@ int main() {
     }
     
     // Memory deallocation
-    delete_split_data(train_data, train_labels, test_data, test_labels, NUM_SAMPLES, train_count);
+    syn_dataset_delete(train_set);
+    syn_dataset_delete(test_set);
     delete_neural_network();
 
     return 0;
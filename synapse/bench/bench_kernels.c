@@ -0,0 +1,684 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "kernels/kernels.h"
+
+// Checks the dense kernels against the reference loops the library used
+// before they existed and reports GFLOP/s for the shapes a training step hits.
+// Then checks the exp and log of every kernel table this CPU runs against
+// libm in both math modes, and their other elementwise and row kernels and
+// optimizer steps against the scalar table, including NaN, infinities and
+// denormals.
+// With --json PATH the results are also written as one JSON object to PATH.
+
+#define REPEATS 5
+#define MIN_FLOPS 2e8
+#define TOLERANCE 1e-4f
+
+// Every STRIDE-th float bit pattern, plus EDGE_FLOATS consecutive floats
+// around each edge of exp and log
+#define STRIDE 4093
+#define EDGE_FLOATS 4096
+
+// Documented bounds of the vector exp and log (activ_funcs.h), precise then fast
+static const double _exp_ulp[2] = { 1.3, 71.0 };
+static const double _log_ulp[2] = { 0.9, 26.0 };
+
+static const char *_tables[] = { "scalar", "avx2", "avx512" };
+
+
+typedef struct {
+    const char *name;
+    int batch_size;
+    int input_size;
+    int output_size;
+} Shape;
+
+
+static const Shape _shapes[] = {
+    { "mnist-hidden",  64,  784,   16 },
+    { "mnist-output",  64,   16,   10 },
+    { "wide-hidden",  128,  784,  512 },
+    { "square",       256, 1024, 1024 },
+    { "classifier",    64,  512, 4096 },
+};
+
+static FILE *_json = NULL;
+static int _num_results = 0;
+
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void fill_random(float *x, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        x[i] = rand() / (float)RAND_MAX * 2.0f - 1.0f;
+    }
+}
+
+
+static float max_rel_error(const float *ref, const float *out, size_t size) {
+    float max_err = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        float err = fabsf(ref[i] - out[i]) / fmaxf(1.0f, fabsf(ref[i]));
+        if (err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+
+// max_rel_error() where a NaN or infinite reference must be matched exactly
+// and any other mismatch in kind counts as an infinite error
+static float max_value_error(const float *ref, const float *out, size_t size) {
+    float max_err = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        if (isnan(ref[i]) || isnan(out[i])) {
+            if (isnan(ref[i]) != isnan(out[i])) return INFINITY;
+            continue;
+        }
+        if (isinf(ref[i]) || isinf(out[i])) {
+            if (ref[i] != out[i]) return INFINITY;
+            continue;
+        }
+        float err = fabsf(ref[i] - out[i]) / fmaxf(1.0f, fabsf(ref[i]));
+        if (err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+
+// Error of y in units in the last place of the float nearest to ref, with
+// the denormal spacing below FLT_MIN. Results that round to an infinity or
+// are NaN must match exactly.
+static double ulp_error(float y, double ref) {
+    if (isnan(ref) || isnan(y)) return (isnan(ref) && isnan(y)) ? 0.0 : INFINITY;
+    if (isinf((float)ref) || isinf(y)) return (y == (float)ref) ? 0.0 : INFINITY;
+
+    int exponent;
+    frexp(ref, &exponent);
+    double ulp = ldexp(1.0, ((exponent < -125) ? -125 : exponent) - 24);
+    return fabs(y - ref) / ulp;
+}
+
+
+static float float_bits(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+
+// Sampled float bit patterns, then the floats around each of the edges
+static float* sample_floats(const float *edges, int num_edges, long *count) {
+    long size = (long)((1ull << 32) / STRIDE + 1) + (long)num_edges * 2 * EDGE_FLOATS;
+    float *x = malloc(size * sizeof(float));
+    if (!x) return NULL;
+
+    long n = 0;
+    for (uint64_t bits = 0; bits < (1ull << 32); bits += STRIDE) {
+        x[n++] = float_bits((uint32_t)bits);
+    }
+
+    for (int e = 0; e < num_edges; ++e) {
+        uint32_t bits;
+        memcpy(&bits, &edges[e], sizeof(bits));
+        for (int i = -EDGE_FLOATS; i < EDGE_FLOATS; ++i) {
+            x[n++] = float_bits(bits + i);
+        }
+    }
+
+    *count = n;
+    return x;
+}
+
+
+static void report_check(const char *table, int fast, const char *op, const char *unit, double err, double bound,
+    int *failures
+) {
+    int ok = err <= bound;
+    if (!ok) ++(*failures);
+
+    printf("%-8s %-8s %-14s %12.3e %12.3e %-4s %s\n", table, fast ? "fast" : "precise", op, err, bound, unit,
+        ok ? "ok" : "MISMATCH");
+
+    if (_json) {
+        fprintf(_json, "%s\n    {\"kernels\": \"%s\", \"math\": \"%s\", \"op\": \"%s\", \"unit\": \"%s\", "
+            "\"max_err\": %.3e, \"bound\": %.3e, \"ok\": %s}",
+            _num_results ? "," : "", table, fast ? "fast" : "precise", op, unit, err, bound, ok ? "true" : "false");
+    }
+    ++_num_results;
+}
+
+
+// Largest ULP error of f over x against the double reference ref
+static double max_ulp_error(void (*f)(long, const float *, float *), double (*ref)(double), const float *x, float *y,
+    long n
+) {
+    f(n, x, y);
+
+    double max_err = 0.0;
+    for (long i = 0; i < n; ++i) {
+        double err = ulp_error(y[i], ref((double)x[i]));
+        if (!(err <= max_err)) max_err = err;
+    }
+    return max_err;
+}
+
+
+// Row lengths around the 8- and 16-float vector widths
+static const int _lengths[] = { 1, 3, 8, 10, 16, 17, 31, 100, 1000 };
+
+#define NUM_LENGTHS (int)(sizeof(_lengths) / sizeof(_lengths[0]))
+#define MAX_LENGTH 1000
+
+
+// Row kind k of length n: spreads of 1, 30 and 1e4, then rows with -inf,
+// a NaN, a +inf, all -inf, and denormals
+static void fill_row(int kind, int n, float *x) {
+    static const float spread[] = { 1.0f, 30.0f, 1e4f };
+
+    for (int i = 0; i < n; ++i) {
+        x[i] = (rand() / (float)RAND_MAX * 2.0f - 1.0f) * spread[(kind < 3) ? kind : 0];
+    }
+
+    switch (kind) {
+    case 3: for (int i = 0; i < n; i += 3) x[i] = -INFINITY; break;
+    case 4: x[n / 2] = NAN; break;
+    case 5: x[n - 1] = INFINITY; break;
+    case 6: for (int i = 0; i < n; ++i) x[i] = -INFINITY; break;
+    case 7: for (int i = 0; i < n; i += 2) x[i] = float_bits(1 + (uint32_t)rand() % 0x7fffff); break;
+    }
+}
+
+#define NUM_ROW_KINDS 8
+
+
+// softmax, logsumexp and softmax_xent of the table against the scalar one
+static float check_rows(const KernelTable *kt, int op) {
+    const KernelTable *ref = &kernels_scalar;
+    float x[MAX_LENGTH], y[MAX_LENGTH], p[2][MAX_LENGTH], d[2][MAX_LENGTH], loss[2];
+    float max_err = 0.0f;
+
+    for (int l = 0; l < NUM_LENGTHS; ++l) {
+        int n = _lengths[l];
+
+        for (int kind = 0; kind < NUM_ROW_KINDS; ++kind) {
+            fill_row(kind, n, x);
+            float err = 0.0f;
+
+            if (op == 0) {
+                ref->softmax(n, x, p[0]);
+                kt->softmax(n, x, p[1]);
+                err = max_value_error(p[0], p[1], n);
+            } else if (op == 1) {
+                loss[0] = ref->logsumexp(n, x);
+                loss[1] = kt->logsumexp(n, x);
+                err = max_value_error(&loss[0], &loss[1], 1);
+            } else {
+                // Soft targets, then a class index
+                float sum = 0.0f;
+                for (int i = 0; i < n; ++i) sum += y[i] = rand() / (float)RAND_MAX;
+                for (int i = 0; i < n; ++i) y[i] /= sum;
+
+                for (int sparse = 0; sparse < 2; ++sparse) {
+                    const float *targets = sparse ? NULL : y;
+                    for (int t = 0; t < 2; ++t) {
+                        const KernelTable *table = t ? kt : ref;
+                        loss[t] = table->softmax_xent(n, x, targets, n / 2, 0.25f, p[t], d[t]);
+                    }
+                    err = fmaxf(err, max_value_error(&loss[0], &loss[1], 1));
+                    err = fmaxf(err, max_value_error(p[0], p[1], n));
+                    err = fmaxf(err, max_value_error(d[0], d[1], n));
+                }
+            }
+
+            if (!(err <= max_err)) max_err = err;
+        }
+    }
+
+    return max_err;
+}
+
+
+// bias_activ for every op, with and without bias, in place and into a
+// separate buffer, then activ_grad, against the scalar table
+static float check_activ(const KernelTable *kt) {
+    enum { ROWS = NUM_ROW_KINDS - 1, LD = MAX_LENGTH + 3 };
+    static float c[2][ROWS * LD], out[2][ROWS * LD];
+    float bias[MAX_LENGTH], a[MAX_LENGTH], d[2][MAX_LENGTH];
+    float max_err = 0.0f;
+
+    for (int l = 0; l < NUM_LENGTHS; ++l) {
+        int n = _lengths[l];
+        fill_row(0, n, bias);
+
+        for (int op = ACTIV_LINEAR; op <= ACTIV_SOFTMAX; ++op) {
+            for (int variant = 0; variant < 4; ++variant) {
+                const float *b = (variant & 1) ? bias : NULL;
+                int in_place = (variant & 2) && op != ACTIV_SOFTMAX;
+
+                for (int r = 0; r < ROWS; ++r) {
+                    fill_row(r + 1, n, &c[0][r * LD]);
+                }
+                memcpy(c[1], c[0], sizeof(c[0]));
+                memset(out, 0, sizeof(out));
+
+                for (int t = 0; t < 2; ++t) {
+                    const KernelTable *table = t ? kt : &kernels_scalar;
+                    table->bias_activ(op, ROWS, n, b, c[t], LD, in_place ? c[t] : out[t], in_place ? LD : n);
+                }
+
+                max_err = fmaxf(max_err, max_value_error(c[0], c[1], ROWS * LD));
+                max_err = fmaxf(max_err, max_value_error(out[0], out[1], ROWS * LD));
+            }
+        }
+
+        for (int op = ACTIV_LINEAR; op <= ACTIV_SIGMOID; ++op) {
+            fill_row(0, n, a);
+            fill_row(1, n, d[0]);
+            for (int i = 0; i < n; ++i) {
+                a[i] = (op == ACTIV_SIGMOID) ? fabsf(a[i]) : a[i];
+            }
+            a[0] = 0.0f;
+            memcpy(d[1], d[0], n * sizeof(float));
+
+            kernels_scalar.activ_grad(op, n, a, d[0]);
+            kt->activ_grad(op, n, a, d[1]);
+            max_err = fmaxf(max_err, max_value_error(d[0], d[1], n));
+        }
+    }
+
+    return max_err;
+}
+
+
+static const char *_rules[] = { "sgd", "momentum", "adagrad", "rmsprop", "adam" };
+
+
+// Largest difference from ref, relative to the largest change of ref from
+// base (or to the largest magnitude of ref when base is NULL)
+static float max_change_error(const float *ref, const float *out, const float *base, long size) {
+    float max_diff = 0.0f, max_ref = 0.0f;
+    for (long i = 0; i < size; ++i) {
+        float diff = fabsf(ref[i] - out[i]);
+        if (!(diff <= max_diff)) max_diff = diff;
+        max_ref = fmaxf(max_ref, fabsf(base ? ref[i] - base[i] : ref[i]));
+    }
+    return max_diff / fmaxf(max_ref, 1e-30f);
+}
+
+
+// Three steps of an update rule on the table against the scalar one, with
+// Adam's bias corrections folded in per step as optimizer_begin_step() does
+static float check_optim(const KernelTable *kt, int rule) {
+    static float w[2][MAX_LENGTH], m[2][MAX_LENGTH], v[2][MAX_LENGTH], w0[MAX_LENGTH], g[MAX_LENGTH];
+    float max_err = 0.0f;
+
+    for (int l = 0; l < NUM_LENGTHS; ++l) {
+        int n = _lengths[l];
+
+        fill_row(0, n, w0);
+        memcpy(w[0], w0, n * sizeof(float));
+        memcpy(w[1], w0, n * sizeof(float));
+        memset(m, 0, sizeof(m));
+        memset(v, 0, sizeof(v));
+
+        for (int t = 1; t <= 3; ++t) {
+            OptimStep step = { rule, 0.01f, 0.9f, 0.999f, 1.0f, 1e-8f };
+            if (rule == OPTIM_ADAM) {
+                step.learning_rate /= 1.0f - powf(step.beta1, t);
+                step.v_scale = 1.0f / sqrtf(1.0f - powf(step.beta2, t));
+            }
+
+            fill_row(0, n, g);
+            kernels_scalar.optim_step(&step, n, w[0], g, m[0], v[0]);
+            kt->optim_step(&step, n, w[1], g, m[1], v[1]);
+        }
+
+        max_err = fmaxf(max_err, max_change_error(w[0], w[1], w0, n));
+        max_err = fmaxf(max_err, max_change_error(m[0], m[1], NULL, n));
+        max_err = fmaxf(max_err, max_change_error(v[0], v[1], NULL, n));
+    }
+
+    return max_err;
+}
+
+
+static int check_math_kernels(void) {
+    // Overflow, the smallest normal and denormal results and the cutoffs of exp;
+    // the denormal and normal boundaries, 1 and the largest float for log
+    const float exp_edges[] = { 0.0f, 88.7228394f, -87.3365479f, -103.278931f, EXP_MIN, EXP_MAX };
+    const float log_edges[] = { 0.0f, 1.17549435e-38f, 1.0f, 3.40282347e38f };
+    long num_exp, num_log;
+    float *exp_x = sample_floats(exp_edges, 6, &num_exp);
+    float *log_x = sample_floats(log_edges, 4, &num_log);
+    float *y = malloc((num_exp > num_log ? num_exp : num_log) * sizeof(float));
+    int failures = 0;
+
+    if (!exp_x || !log_x || !y) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        free(exp_x);
+        free(log_x);
+        free(y);
+        return 1;
+    }
+
+    // Specials land in the sampled range; the 0 edge covers the denormals and -0
+    exp_x[0] = NAN;
+    exp_x[1] = INFINITY;
+    exp_x[2] = -INFINITY;
+    log_x[0] = -1.0f;
+    log_x[1] = INFINITY;
+    log_x[2] = NAN;
+
+    printf("\n%-8s %-8s %-14s %12s %12s\n", "kernels", "math", "op", "max err", "bound");
+
+    const int was_fast = kernel_math_fast();
+
+    for (size_t t = 0; t < sizeof(_tables) / sizeof(_tables[0]); ++t) {
+        const KernelTable *kt = kernel_table_named(_tables[t]);
+        if (!kt) continue;
+
+        for (int fast = 0; fast < 2; ++fast) {
+            kernel_set_math_fast(fast);
+
+            report_check(kt->name, fast, "exp", "ulp", max_ulp_error(kt->vexp, exp, exp_x, y, num_exp),
+                _exp_ulp[fast], &failures);
+            report_check(kt->name, fast, "log", "ulp", max_ulp_error(kt->vlog, log, log_x, y, num_log),
+                _log_ulp[fast], &failures);
+            report_check(kt->name, fast, "softmax", "rel", check_rows(kt, 0), TOLERANCE, &failures);
+            report_check(kt->name, fast, "logsumexp", "rel", check_rows(kt, 1), TOLERANCE, &failures);
+            report_check(kt->name, fast, "softmax_xent", "rel", check_rows(kt, 2), TOLERANCE, &failures);
+            report_check(kt->name, fast, "activ", "rel", check_activ(kt), TOLERANCE, &failures);
+        }
+
+        for (int rule = OPTIM_SGD; rule <= OPTIM_ADAM; ++rule) {
+            report_check(kt->name, 0, _rules[rule], "rel", check_optim(kt, rule), TOLERANCE, &failures);
+        }
+    }
+
+    kernel_set_math_fast(was_fast);
+
+    free(exp_x);
+    free(log_x);
+    free(y);
+    return failures;
+}
+
+
+// Reference: out[b][i] = sum_j in[b][j] * w[i][j]
+static void ref_forward(const float *in, const float *w, float *out, int batch, int in_size, int out_size) {
+    for (int b = 0; b < batch; ++b) {
+        for (int i = 0; i < out_size; ++i) {
+            float sum = 0.0f;
+            for (int j = 0; j < in_size; ++j) {
+                sum += in[b * in_size + j] * w[i * in_size + j];
+            }
+            out[b * out_size + i] = sum;
+        }
+    }
+}
+
+
+// Reference: grads[i][j] += sum_b deltas[b][i] * in[b][j]
+static void ref_weight_grads(const float *deltas, const float *in, float *grads, int batch, int in_size, int out_size) {
+    for (int b = 0; b < batch; ++b) {
+        for (int i = 0; i < out_size; ++i) {
+            for (int j = 0; j < in_size; ++j) {
+                grads[i * in_size + j] += deltas[b * out_size + i] * in[b * in_size + j];
+            }
+        }
+    }
+}
+
+
+// Reference: prev[b][j] = sum_i deltas[b][i] * w[i][j]
+static void ref_propagate(const float *deltas, const float *w, float *prev, int batch, int in_size, int out_size) {
+    for (int b = 0; b < batch; ++b) {
+        for (int j = 0; j < in_size; ++j) {
+            float sum = 0.0f;
+            for (int i = 0; i < out_size; ++i) {
+                sum += deltas[b * out_size + i] * w[i * in_size + j];
+            }
+            prev[b * in_size + j] = sum;
+        }
+    }
+}
+
+
+// Reference: c[b][i] = sum_j x[b][j] * w[i][j] in int32
+static void ref_qgemm(const uint8_t *x, const int8_t *w, float *out, int batch, int k, int out_size) {
+    for (int b = 0; b < batch; ++b) {
+        for (int i = 0; i < out_size; ++i) {
+            int32_t sum = 0;
+            for (int j = 0; j < k; ++j) {
+                sum += (int32_t)x[b * k + j] * w[i * k + j];
+            }
+            out[b * out_size + i] = (float)sum;
+        }
+    }
+}
+
+
+static void report(const char *op, const Shape *shape, double flops, double seconds, float err, int *failures) {
+    int ok = err <= TOLERANCE;
+    if (!ok) ++(*failures);
+
+    printf("%-14s %-8s %5d %5d %5d %10.2f %12.2e  %s\n", shape->name, op,
+        shape->batch_size, shape->input_size, shape->output_size,
+        flops / seconds * 1e-9, err, ok ? "ok" : "MISMATCH");
+
+    if (_json) {
+        fprintf(_json, "%s\n    {\"shape\": \"%s\", \"op\": \"%s\", \"batch\": %d, \"in\": %d, \"out\": %d, "
+            "\"best_us\": %.4f, \"gflops\": %.4f, \"max_rel_err\": %.3e, \"ok\": %s}",
+            _num_results ? "," : "", shape->name, op, shape->batch_size, shape->input_size, shape->output_size,
+            seconds * 1e6, flops / seconds * 1e-9, err, ok ? "true" : "false");
+    }
+    ++_num_results;
+}
+
+
+int main(int argc, char **argv) {
+    srand(42);
+    int failures = 0;
+
+    if (argc == 3 && !strcmp(argv[1], "--json")) {
+        _json = fopen(argv[2], "w");
+        if (!_json) {
+            fprintf(stderr, "Error: Failed to open %s.\n", argv[2]);
+            return 1;
+        }
+        fprintf(_json, "{\n  \"kernels\": \"%s\",\n  \"int8\": \"%s\",\n  \"results\": [",
+            kernel_name(), kernel_qgemm_name());
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--json PATH]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Kernels: %s, int8: %s\n\n", kernel_name(), kernel_qgemm_name());
+    printf("%-14s %-8s %5s %5s %5s %10s %12s\n", "shape", "op", "batch", "in", "out", "GFLOP/s", "max rel err");
+
+    for (size_t s = 0; s < sizeof(_shapes) / sizeof(_shapes[0]); ++s) {
+        const Shape *shape = &_shapes[s];
+        int batch = shape->batch_size, in_size = shape->input_size, out_size = shape->output_size;
+
+        size_t in_len = (size_t)batch * in_size, out_len = (size_t)batch * out_size, w_len = (size_t)in_size * out_size;
+        float *in = malloc(in_len * sizeof(float));
+        float *w = malloc(w_len * sizeof(float));
+        float *deltas = malloc(out_len * sizeof(float));
+        float *ref = malloc((in_len > w_len ? in_len : w_len) * sizeof(float));
+        float *out = malloc((in_len > w_len ? in_len : w_len) * sizeof(float));
+
+        if (!in || !w || !deltas || !ref || !out) {
+            fprintf(stderr, "Error: Memory allocation failed.\n");
+            return 1;
+        }
+
+        fill_random(in, in_len);
+        fill_random(w, w_len);
+        fill_random(deltas, out_len);
+
+        double flops = 2.0 * batch * in_size * out_size;
+        int iters = (int)ceil(MIN_FLOPS / flops);
+        double start, best;
+
+        // Forward: sums = in * w^T
+        ref_forward(in, w, ref, batch, in_size, out_size);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < iters; ++i) {
+                kernel_sgemm(0, 1, batch, out_size, in_size, in, in_size, w, in_size, out, out_size, 0);
+            }
+            best = fmin(best, (now_seconds() - start) / iters);
+        }
+        report("forward", shape, flops, best, max_rel_error(ref, out, out_len), &failures);
+
+        // Weight gradients: grads += deltas^T * in
+        memset(ref, 0, w_len * sizeof(float));
+        memset(out, 0, w_len * sizeof(float));
+        ref_weight_grads(deltas, in, ref, batch, in_size, out_size);
+        kernel_sgemm(1, 0, out_size, in_size, batch, deltas, out_size, in, in_size, out, in_size, 1);
+        float err = max_rel_error(ref, out, w_len);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < iters; ++i) {
+                kernel_sgemm(1, 0, out_size, in_size, batch, deltas, out_size, in, in_size, out, in_size, 0);
+            }
+            best = fmin(best, (now_seconds() - start) / iters);
+        }
+        report("wgrad", shape, flops, best, err, &failures);
+
+        // Propagated deltas: prev = deltas * w
+        ref_propagate(deltas, w, ref, batch, in_size, out_size);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < iters; ++i) {
+                kernel_sgemm(0, 0, batch, in_size, out_size, deltas, out_size, w, in_size, out, in_size, 0);
+            }
+            best = fmin(best, (now_seconds() - start) / iters);
+        }
+        report("backprop", shape, flops, best, max_rel_error(ref, out, in_len), &failures);
+
+        // Single sample: y = w * x and x' = w^T * d
+        double gemv_flops = 2.0 * in_size * out_size;
+        int gemv_iters = (int)ceil(MIN_FLOPS / 10 / gemv_flops);
+        ref_forward(in, w, ref, 1, in_size, out_size);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < gemv_iters; ++i) {
+                kernel_sgemv(out_size, in_size, w, in_size, in, out, 0);
+            }
+            best = fmin(best, (now_seconds() - start) / gemv_iters);
+        }
+        report("gemv", shape, gemv_flops, best, max_rel_error(ref, out, out_size), &failures);
+
+        ref_propagate(deltas, w, ref, 1, in_size, out_size);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < gemv_iters; ++i) {
+                kernel_sgemv_t(out_size, in_size, w, in_size, deltas, out, 0);
+            }
+            best = fmin(best, (now_seconds() - start) / gemv_iters);
+        }
+        report("gemv_t", shape, gemv_flops, best, max_rel_error(ref, out, in_size), &failures);
+
+        // Int8 forward on rows padded to QUANT_BLOCK; results must be exact
+        int k = (in_size + QUANT_BLOCK - 1) / QUANT_BLOCK * QUANT_BLOCK;
+        uint8_t *qx = calloc((size_t)batch * k, 1);
+        int8_t *qw = calloc((size_t)out_size * k, 1);
+        int32_t *qc = malloc(out_len * sizeof(int32_t));
+        if (!qx || !qw || !qc) {
+            fprintf(stderr, "Error: Memory allocation failed.\n");
+            return 1;
+        }
+
+        for (int b = 0; b < batch; ++b) {
+            for (int j = 0; j < in_size; ++j) qx[(size_t)b * k + j] = (uint8_t)(rand() % 128);
+        }
+        for (int i = 0; i < out_size; ++i) {
+            for (int j = 0; j < in_size; ++j) qw[(size_t)i * k + j] = (int8_t)(rand() % 255 - 127);
+        }
+
+        ref_qgemm(qx, qw, ref, batch, k, out_size);
+        best = INFINITY;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = now_seconds();
+            for (int i = 0; i < iters; ++i) {
+                kernel_qgemm(batch, out_size, k, qx, k, qw, k, qc, out_size);
+            }
+            best = fmin(best, (now_seconds() - start) / iters);
+        }
+        for (size_t i = 0; i < out_len; ++i) out[i] = (float)qc[i];
+        report("qgemm", shape, flops, best, max_rel_error(ref, out, out_len), &failures);
+
+        free(qx);
+        free(qw);
+        free(qc);
+
+        // 16-bit weights, compared with fp32 on the same rounded values
+        uint16_t *hw = malloc(w_len * sizeof(uint16_t));
+        if (!hw) {
+            fprintf(stderr, "Error: Memory allocation failed.\n");
+            return 1;
+        }
+
+        for (int type = HALF_F16; type <= HALF_BF16; ++type) {
+            for (size_t i = 0; i < w_len; ++i) {
+                hw[i] = float_to_half(type, w[i]);
+                out[i] = half_to_float(type, hw[i]);
+            }
+            ref_forward(in, out, ref, batch, in_size, out_size);
+
+            best = INFINITY;
+            for (int r = 0; r < REPEATS; ++r) {
+                start = now_seconds();
+                for (int i = 0; i < iters; ++i) {
+                    kernel_hgemm(type, batch, out_size, in_size, in, in_size, hw, in_size, out, out_size);
+                }
+                best = fmin(best, (now_seconds() - start) / iters);
+            }
+            report((type == HALF_F16) ? "f16gemm" : "bf16gemm", shape, flops, best, max_rel_error(ref, out, out_len),
+                &failures);
+        }
+
+        free(hw);
+
+        free(in);
+        free(w);
+        free(deltas);
+        free(ref);
+        free(out);
+    }
+
+    if (_json) {
+        fprintf(_json, "\n  ],\n  \"accuracy\": [");
+        _num_results = 0;
+    }
+
+    failures += check_math_kernels();
+
+    if (_json) {
+        fprintf(_json, "\n  ]\n}\n");
+        fclose(_json);
+    }
+
+    if (failures) {
+        fprintf(stderr, "\nError: %d kernel result(s) differ from the reference or exceed their bound.\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,544 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "synapse.h"
+#include "kernels/kernels.h"
+
+// Times the public training API over a matrix of layer widths, batch sizes
+// and thread counts: forward, backward and parallel train steps, the
+// weight update of every optimizer, every activation and loss, and the CSV
+// loader. Each case is calibrated to samples of at least MIN_SAMPLE seconds,
+// run for warmup samples, then timed over the repeats; the median and p99
+// per call are reported with GFLOP/s (matrix products only) and GB/s, both
+// from the median and the minimum memory traffic of the call.
+//
+//   bench_network [--json PATH] [--repeats N] [--warmup N] [--threads N] [--quick] [--filter TEXT]
+//
+// --json also writes the results as one JSON object to PATH.
+
+#define MIN_SAMPLE 2e-3
+#define DEFAULT_REPEATS 30
+#define DEFAULT_WARMUP 2
+#define NUM_LAYERS 3
+#define CSV_ROWS 2000
+#define LEARNING_RATE 1e-6f
+
+
+typedef struct {
+    FILE *json;
+    const char *filter;
+    int repeats;
+    int warmup;
+    int count;
+} Bench;
+
+
+typedef struct {
+    const char *name;
+    const char *variant;
+    int width;
+    int batch;
+    int threads;
+    double flops;
+    double bytes;
+} Case;
+
+
+// Everything a timed call needs; each case reads the fields it uses
+typedef struct {
+    SynNetwork *net;
+    const float *inputs;
+    const int32_t *classes;
+    const float *labels;
+    float *out;
+    int width;
+    int batch;
+    int threads;
+    int (*activ_func)(const float *restrict, float *restrict, int);
+    float (*loss_func)(const float *restrict, const float *restrict, int);
+    const char *csv_file;
+} Args;
+
+
+typedef void (*BenchFn)(const Args *args);
+
+
+typedef struct {
+    const char *name;
+    int (*func)(float *restrict, const float *restrict, int, float, OptimizerCache *, int);
+} NamedOptimizer;
+
+
+typedef struct {
+    const char *name;
+    int (*func)(const float *restrict, float *restrict, int);
+} NamedActivation;
+
+
+typedef struct {
+    const char *name;
+    float (*func)(const float *restrict, const float *restrict, int);
+} NamedLoss;
+
+
+static const NamedOptimizer _optimizers[] = {
+    { "sgd", sgd },
+    { "momentum", momentum },
+    { "adagrad", adagrad },
+    { "rmsprop", rmsprop },
+    { "adam", adam },
+};
+
+static const NamedActivation _activations[] = {
+    { "linear", linear },
+    { "relu", relu },
+    { "sigmoid", sigmoid },
+    { "softmax", softmax },
+};
+
+// A NULL function stands for sparse_categorical_cross_entropy
+static const NamedLoss _losses[] = {
+    { "mse", mean_squared_error },
+    { "bce", binary_cross_entropy },
+    { "cce", categorical_cross_entropy },
+    { "sparse_cce", NULL },
+};
+
+static const int _widths[] = { 64, 256, 1024 };
+static const int _batches[] = { 1, 32, 256 };
+
+static const int _quick_widths[] = { 64, 256 };
+static const int _quick_batches[] = { 32 };
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void fill_random(float *x, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        x[i] = rand() / (float)RAND_MAX * 2.0f - 1.0f;
+    }
+}
+
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Seconds per call of iters back-to-back calls
+static double time_sample(BenchFn fn, const Args *args, long iters) {
+    double start = now_seconds();
+    for (long i = 0; i < iters; ++i) {
+        fn(args);
+    }
+    return (now_seconds() - start) / iters;
+}
+
+
+static void run_case(Bench *bench, const Case *c, BenchFn fn, const Args *args) {
+    if (bench->filter && !strstr(c->name, bench->filter) && !strstr(c->variant, bench->filter)) {
+        return;
+    }
+
+    // The first call also warms the caches and sizes the samples
+    double once = time_sample(fn, args, 1);
+    long iters = (once >= MIN_SAMPLE) ? 1 : (long)ceil(MIN_SAMPLE / fmax(once, 1e-9));
+
+    for (int r = 0; r < bench->warmup; ++r) {
+        time_sample(fn, args, iters);
+    }
+
+    double *samples = malloc(bench->repeats * sizeof(double));
+    if (!samples) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        exit(1);
+    }
+
+    for (int r = 0; r < bench->repeats; ++r) {
+        samples[r] = time_sample(fn, args, iters);
+    }
+    qsort(samples, bench->repeats, sizeof(double), compare_doubles);
+
+    double median = (bench->repeats % 2) ? samples[bench->repeats / 2] :
+        0.5 * (samples[bench->repeats / 2 - 1] + samples[bench->repeats / 2]);
+    double p99 = samples[(int)ceil(0.99 * bench->repeats) - 1];
+    free(samples);
+
+    double gflops = c->flops / median * 1e-9;
+    double gbps = c->bytes / median * 1e-9;
+
+    printf("%-12s %-10s %6d %6d %4d %12.2f %12.2f ", c->name, c->variant, c->width, c->batch, c->threads,
+        median * 1e6, p99 * 1e6);
+    if (c->flops > 0.0) {
+        printf("%9.2f", gflops);
+    } else {
+        printf("%9s", "-");
+    }
+    printf(" %9.2f\n", gbps);
+    fflush(stdout);
+
+    if (bench->json) {
+        fprintf(bench->json, "%s\n    {\"case\": \"%s\", \"variant\": \"%s\", \"width\": %d, \"batch\": %d, "
+            "\"threads\": %d, \"iters\": %ld, \"repeats\": %d, \"median_us\": %.4f, \"p99_us\": %.4f, ",
+            bench->count ? "," : "", c->name, c->variant, c->width, c->batch, c->threads, iters, bench->repeats,
+            median * 1e6, p99 * 1e6);
+        if (c->flops > 0.0) {
+            fprintf(bench->json, "\"gflops\": %.4f, ", gflops);
+        } else {
+            fprintf(bench->json, "\"gflops\": null, ");
+        }
+        fprintf(bench->json, "\"gbps\": %.4f}", gbps);
+    }
+
+    ++bench->count;
+}
+
+
+static void forward_fn(const Args *args) {
+    syn_forward_batch(args->net, args->inputs, args->batch);
+}
+
+
+static void backward_fn(const Args *args) {
+    syn_backward_batch_sparse(args->net, args->inputs, args->classes, args->batch);
+}
+
+
+static void train_fn(const Args *args) {
+    syn_train_batch_parallel_sparse(args->net, args->inputs, args->classes, args->batch, args->threads);
+}
+
+
+static void update_fn(const Args *args) {
+    syn_update_weights(args->net);
+}
+
+
+static void activation_fn(const Args *args) {
+    for (int b = 0; b < args->batch; ++b) {
+        const size_t row = (size_t)b * args->width;
+        args->activ_func(&args->inputs[row], &args->out[row], args->width);
+    }
+}
+
+
+static void loss_fn(const Args *args) {
+    for (int b = 0; b < args->batch; ++b) {
+        const size_t row = (size_t)b * args->width;
+        if (args->loss_func) {
+            args->loss_func(&args->labels[row], &args->out[row], args->width);
+        } else {
+            sparse_categorical_cross_entropy(args->classes[b], &args->out[row], args->width);
+        }
+    }
+}
+
+
+static void csv_fn(const Args *args) {
+    free(read_csv_matrix(args->csv_file, CSV_ROWS, args->width));
+}
+
+
+// NUM_LAYERS layers of width units: relu hidden layers and a softmax output
+// trained with categorical cross-entropy
+static SynNetwork* create_bench_network(int width, int (*optimizer)(float *restrict, const float *restrict, int, float,
+    OptimizerCache *, int)
+) {
+    SynNetwork *net = syn_create_network(NUM_LAYERS);
+    if (!net) return NULL;
+
+    for (int l = 0; l < NUM_LAYERS; ++l) {
+        if (syn_init_layer(net, width, width, (l < NUM_LAYERS - 1) ? relu : softmax)) {
+            syn_delete_network(net);
+            return NULL;
+        }
+    }
+
+    if (syn_setup_loss_function(net, categorical_cross_entropy) ||
+        syn_setup_optimizer(net, optimizer, LEARNING_RATE)
+    ) {
+        syn_delete_network(net);
+        return NULL;
+    }
+
+    return net;
+}
+
+
+static void bench_network(Bench *bench, int width, const int *batches, int num_batches,
+    const int *threads, int num_threads
+) {
+    SynNetwork *net = create_bench_network(width, sgd);
+    if (!net) exit(1);
+
+    const int max_batch = batches[num_batches - 1];
+    float *inputs = malloc((size_t)max_batch * width * sizeof(float));
+    int32_t *classes = malloc(max_batch * sizeof(int32_t));
+
+    if (!inputs || !classes) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        exit(1);
+    }
+
+    fill_random(inputs, (size_t)max_batch * width);
+    for (int b = 0; b < max_batch; ++b) {
+        classes[b] = rand() % width;
+    }
+
+    // Parameters, and the inputs, sums and activations of every layer
+    const double params = (double)NUM_LAYERS * width * (width + 1);
+    const double matmul = 2.0 * NUM_LAYERS * width * width;
+
+    for (int i = 0; i < num_batches; ++i) {
+        const int batch = batches[i];
+        const double units = 4.0 * batch * NUM_LAYERS * 3 * width;
+        Args args = { .net = net, .inputs = inputs, .classes = classes, .width = width, .batch = batch };
+
+        // Forward reads the parameters once; backward reads the weights and
+        // updates the gradients, and propagates deltas past all but layer 0
+        Case fwd = { "forward", "", width, batch, 1, batch * matmul, 4.0 * params + units };
+        Case bwd = { "backward", "", width, batch, 1, batch * matmul * (2 * NUM_LAYERS - 1) / NUM_LAYERS,
+            12.0 * params + units };
+
+        run_case(bench, &fwd, forward_fn, &args);
+        syn_forward_batch(net, inputs, batch);
+        run_case(bench, &bwd, backward_fn, &args);
+
+        // A train step also reduces the per-thread gradient buffers
+        for (int t = 0; t < num_threads; ++t) {
+            if (threads[t] > batch) break;
+
+            args.threads = threads[t];
+            Case train = { "train_step", "", width, batch, threads[t], fwd.flops + bwd.flops,
+                fwd.bytes + bwd.bytes + 4.0 * params * (threads[t] + 1) };
+            run_case(bench, &train, train_fn, &args);
+        }
+    }
+
+    syn_delete_network(net);
+    free(inputs);
+    free(classes);
+}
+
+
+// Each update streams the parameters, gradients and optimizer moments
+static void bench_optimizers(Bench *bench, int width, const int *threads, int num_threads) {
+    for (int o = 0; o < COUNT(_optimizers); ++o) {
+        for (int t = 0; t < num_threads; ++t) {
+            SynNetwork *net = create_bench_network(width, _optimizers[o].func);
+            if (!net) exit(1);
+
+            // A parallel train step sets up the thread pool the update uses
+            float *inputs = malloc((size_t)threads[t] * width * sizeof(float));
+            int32_t *classes = calloc(threads[t], sizeof(int32_t));
+            if (!inputs || !classes) {
+                fprintf(stderr, "Error: Memory allocation failed.\n");
+                exit(1);
+            }
+
+            fill_random(inputs, (size_t)threads[t] * width);
+            syn_train_batch_parallel_sparse(net, inputs, classes, threads[t], threads[t]);
+
+            const double params = (double)NUM_LAYERS * width * (width + 1);
+            const int moments = optimizer_num_moments(_optimizers[o].func);
+
+            Args args = { .net = net, .width = width, .threads = threads[t] };
+            Case c = { "update", _optimizers[o].name, width, 0, threads[t], 0.0, 4.0 * params * (3 + 2 * moments) };
+            run_case(bench, &c, update_fn, &args);
+
+            syn_delete_network(net);
+            free(inputs);
+            free(classes);
+        }
+    }
+}
+
+
+// Activations and losses run row by row over a batch; each reads and
+// writes, or reads two, batch rows
+static void bench_elementwise(Bench *bench, int width, const int *batches, int num_batches) {
+    const int max_batch = batches[num_batches - 1];
+    const size_t size = (size_t)max_batch * width;
+
+    float *inputs = malloc(size * sizeof(float));
+    float *labels = calloc(size, sizeof(float));
+    float *out = malloc(size * sizeof(float));
+    int32_t *classes = malloc(max_batch * sizeof(int32_t));
+
+    if (!inputs || !labels || !out || !classes) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        exit(1);
+    }
+
+    fill_random(inputs, size);
+    for (int b = 0; b < max_batch; ++b) {
+        classes[b] = rand() % width;
+        labels[(size_t)b * width + classes[b]] = 1.0f;
+    }
+
+    for (int i = 0; i < num_batches; ++i) {
+        const int batch = batches[i];
+        const double bytes = 8.0 * batch * width;
+        Args args = { .inputs = inputs, .labels = labels, .out = out, .classes = classes, .width = width,
+            .batch = batch };
+
+        for (int a = 0; a < COUNT(_activations); ++a) {
+            args.activ_func = _activations[a].func;
+            Case c = { "activation", _activations[a].name, width, batch, 1, 0.0, bytes };
+            run_case(bench, &c, activation_fn, &args);
+        }
+
+        // Predictions as probabilities rows, as the losses expect
+        for (int b = 0; b < batch; ++b) {
+            softmax(&inputs[(size_t)b * width], &out[(size_t)b * width], width);
+        }
+
+        for (int l = 0; l < COUNT(_losses); ++l) {
+            args.loss_func = _losses[l].func;
+            Case c = { "loss", _losses[l].name, width, batch, 1, 0.0, _losses[l].func ? bytes : bytes / 2 };
+            run_case(bench, &c, loss_fn, &args);
+        }
+    }
+
+    free(inputs);
+    free(labels);
+    free(out);
+    free(classes);
+}
+
+
+// The loader parses on all CPUs; GB/s is over the CSV text
+static void bench_csv(Bench *bench, int width) {
+    const char *dir = getenv("TMPDIR");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/synapse-bench-XXXXXX", dir ? dir : "/tmp");
+
+    int fd = mkstemp(path);
+    FILE *file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        fprintf(stderr, "Error: Failed to create a temporary CSV file.\n");
+        exit(1);
+    }
+
+    for (int r = 0; r < CSV_ROWS; ++r) {
+        for (int j = 0; j < width; ++j) {
+            fprintf(file, (j + 1 < width) ? "%.6f," : "%.6f\n", rand() / (float)RAND_MAX * 2.0f - 1.0f);
+        }
+    }
+
+    long size = ftell(file);
+    fclose(file);
+
+    Args args = { .width = width, .csv_file = path };
+    Case c = { "csv_load", "", width, CSV_ROWS, (int)sysconf(_SC_NPROCESSORS_ONLN), 0.0, (double)size };
+    run_case(bench, &c, csv_fn, &args);
+
+    remove(path);
+}
+
+
+static int parse_args(Bench *bench, int *quick, int *max_threads, int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!strcmp(argv[i], "--quick")) {
+            *quick = 1;
+            continue;
+        }
+
+        if (!value) {
+            fprintf(stderr, "Error: Invalid argument %s.\n", argv[i]);
+            return 1;
+        }
+
+        if (!strcmp(argv[i], "--json")) {
+            bench->json = fopen(value, "w");
+            if (!bench->json) {
+                fprintf(stderr, "Error: Failed to open %s.\n", value);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--repeats")) {
+            bench->repeats = atoi(value);
+        } else if (!strcmp(argv[i], "--warmup")) {
+            bench->warmup = atoi(value);
+        } else if (!strcmp(argv[i], "--threads")) {
+            *max_threads = atoi(value);
+        } else if (!strcmp(argv[i], "--filter")) {
+            bench->filter = value;
+        } else {
+            fprintf(stderr, "Error: Invalid argument %s.\n", argv[i]);
+            return 1;
+        }
+        ++i;
+    }
+
+    if (bench->repeats <= 0 || bench->warmup < 0 || *max_threads <= 0) {
+        fprintf(stderr, "Error: Invalid benchmark settings.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    srand(42);
+
+    Bench bench = { NULL, NULL, DEFAULT_REPEATS, DEFAULT_WARMUP, 0 };
+    int quick = 0;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (parse_args(&bench, &quick, &max_threads, argc, argv)) {
+        return 1;
+    }
+
+    // Powers of two up to the CPU count, and the count itself
+    int threads[32], num_threads = 0;
+    for (int t = 1; t < max_threads && num_threads < 31; t *= 2) {
+        threads[num_threads++] = t;
+    }
+    threads[num_threads++] = max_threads;
+
+    const int *widths = quick ? _quick_widths : _widths;
+    const int num_widths = quick ? COUNT(_quick_widths) : COUNT(_widths);
+    const int *batches = quick ? _quick_batches : _batches;
+    const int num_batches = quick ? COUNT(_quick_batches) : COUNT(_batches);
+
+    const char *math = (syn_math_mode() == SYN_MATH_FAST) ? "fast" : "precise";
+    printf("Kernels: %s, math: %s, repeats: %d, warmup: %d\n\n", kernel_name(), math, bench.repeats, bench.warmup);
+    printf("%-12s %-10s %6s %6s %4s %12s %12s %9s %9s\n", "case", "variant", "width", "batch", "thr",
+        "median us", "p99 us", "GFLOP/s", "GB/s");
+
+    if (bench.json) {
+        fprintf(bench.json, "{\n  \"kernels\": \"%s\",\n  \"math\": \"%s\",\n  \"results\": [", kernel_name(), math);
+    }
+
+    for (int w = 0; w < num_widths; ++w) {
+        bench_network(&bench, widths[w], batches, num_batches, threads, num_threads);
+        bench_optimizers(&bench, widths[w], threads, num_threads);
+        bench_elementwise(&bench, widths[w], batches, num_batches);
+        bench_csv(&bench, widths[w]);
+    }
+
+    if (bench.json) {
+        fprintf(bench.json, "\n  ]\n}\n");
+        fclose(bench.json);
+    }
+
+    return 0;
+}
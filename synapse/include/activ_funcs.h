@@ -6,6 +6,20 @@ int relu(const float *restrict x, float *restrict out, int size);
 int sigmoid(const float *restrict x, float *restrict out, int size);
 int softmax(const float *restrict x, float *restrict out, int size);
 
+// Accuracy of the vectorized exp and log behind sigmoid, softmax and the
+// cross-entropy losses, also set by SYNAPSE_MATH=fast|precise. Measured over
+// all floats, PRECISE (the default) stays within 1.3 ULP for exp and 0.9 ULP
+// for log. FAST stays within 71 and 26 ULP, uses shorter polynomials and
+// replaces divisions by reciprocals. The scalar kernels always use libm.
+// bench_kernels (make bench) checks these bounds for every kernel table.
+typedef enum {
+    SYN_MATH_PRECISE,
+    SYN_MATH_FAST
+} SynMathMode;
+
+void syn_set_math_mode(SynMathMode mode);
+SynMathMode syn_math_mode(void);
+
 float grad_activ_func(int (*activ_func)(const float *restrict, float *restrict, int), float x);
 
 #endif
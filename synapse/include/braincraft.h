@@ -1,15 +1,113 @@
 #ifndef BRAINCRAFT_H
 #define BRAINCRAFT_H
 
+#include <stdio.h>
+#include <stdint.h>
+
 #include "activ_funcs.h"
 #include "loss_funcs.h"
 #include "optimizers.h"
+#include "model.h"
+
+// Opaque handle to a neural network. Every handle owns all of its state,
+// so separate networks can be trained or used from different threads.
+typedef struct SynNetwork SynNetwork;
+
+SynNetwork* syn_create_network(int num_layers);
+void syn_delete_network(SynNetwork *net);
+void syn_info_network(const SynNetwork *net);
+int syn_save_network(const SynNetwork *net, const char *filename);
+SynNetwork* syn_load_network(const char *filename);
+
+// Loads only the parameters and two activation buffers sized to the widest
+// layer; forward passes work, training calls fail. The weights of a v2
+// model file are used in place from its read-only mapping.
+SynNetwork* syn_load_network_for_inference(const char *filename);
+
+// Parameters and optimizer state for resuming training. Loading requires
+// a network with the same layers and optimizer already set up.
+int syn_save_checkpoint(const SynNetwork *net, const char *filename);
+int syn_load_checkpoint(SynNetwork *net, const char *filename);
+
+// Snapshot of the current parameters for concurrent inference
+SynModel* syn_export_model(const SynNetwork *net);
+
+int syn_init_layer(SynNetwork *net, int input_size, int output_size,
+    int (*activ_func)(const float *restrict, float *restrict, int)
+);
+
+int syn_setup_loss_function(SynNetwork *net, float (*loss_func)(const float *restrict, const float *restrict, int));
+int syn_setup_optimizer(SynNetwork *net,
+    int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    float learning_rate
+);
+void syn_set_beta1(SynNetwork *net, float new_beta1);
+void syn_set_beta2(SynNetwork *net, float new_beta2);
+
+// Mixed-precision training for the batched and parallel passes: hidden
+// layers keep only their activations, in bfloat16, between the forward and
+// backward passes, and compute their sums and deltas in fp32 scratch rows
+// shared by all of them. Per hidden layer that is a sixth of the three fp32
+// buffers it would otherwise hold; the GEMMs widen the bfloat16 activations
+// while packing. Weights, gradients and optimizer moments stay fp32. A
+// loss_scale of at least 1 multiplies the output deltas and update_weights()
+// divides it out again, skipping the step and halving the scale when a
+// gradient overflows and doubling it after 2000 clean steps; 0 disables
+// scaling.
+int syn_setup_mixed_precision(SynNetwork *net, int enable, float loss_scale);
+float syn_loss_scale(const SynNetwork *net);
+
+// Softmax outputs trained with categorical_cross_entropy keep their logits:
+// compute_loss() and backward() after one forward() share a single fused
+// log-sum-exp pass for the same labels, in either order, so the labels must
+// not change in between; backward_batch() takes its output deltas from the
+// logits the same way. forward() and forward_batch() still return
+// probabilities, and a batch loss is only returned by train_batch_parallel().
+float* syn_forward(SynNetwork *net, const float *inputs);
+float* syn_forward_batch(SynNetwork *net, const float *inputs, int batch_size);
+float syn_compute_loss(SynNetwork *net, const float *y_true);
+int syn_backward(SynNetwork *net, const float *restrict inputs, const float *restrict y_true);
+int syn_backward_batch(SynNetwork *net, const float *restrict inputs, const float *restrict y_true, int batch_size);
+float syn_train_batch_parallel(SynNetwork *net, const float *inputs, const float *labels, int batch_size, int num_threads);
+
+// Labels as int32 class indices instead of one-hot rows, for softmax
+// outputs trained with categorical_cross_entropy
+float syn_compute_loss_sparse(SynNetwork *net, int32_t y_true);
+int syn_backward_sparse(SynNetwork *net, const float *restrict inputs, int32_t y_true);
+int syn_backward_batch_sparse(SynNetwork *net, const float *restrict inputs, const int32_t *restrict y_true, int batch_size);
+float syn_train_batch_parallel_sparse(SynNetwork *net, const float *inputs, const int32_t *labels, int batch_size, int num_threads);
+
+// Networks of at least 2^17 parameters run the optimizer step on a thread
+// pool with one thread per CPU, created on the first call
+int syn_update_weights(SynNetwork *net);
+int syn_zero_grads(SynNetwork *net);
+
+// Per-layer profile of the forward pass, the output loss and deltas, the
+// backward pass and the optimizer update: wall time from a monotonic clock,
+// calls, FLOPs and the minimum bytes moved. Totals cover every network in
+// the process. Work inside a parallel train step is timed on each thread,
+// so its times add up across threads. The "all" row holds network-wide work
+// such as the gradient reduction. Profiling is off by default and costs
+// one branch per layer while off; profiled updates run layer by layer.
+typedef enum {
+    SYN_PROFILE_TABLE,
+    SYN_PROFILE_JSON
+} SynProfileFormat;
+
+void synapse_profile_enable(int enable);
+int synapse_profile_enabled(void);
+void synapse_profile_reset(void);
+int synapse_profile_report(FILE *out, SynProfileFormat format);
 
+// Handle-less API operating on a single process-wide network
 int create_neural_network(int num_layers);
 void delete_neural_network(void);
 void info_neural_network(void);
 int save_neural_network(const char *filename);
 int load_neural_network(const char *filename);
+int load_neural_network_for_inference(const char *filename);
+int save_checkpoint(const char *filename);
+int load_checkpoint(const char *filename);
 
 int init_layer(int input_size, int output_size, int (*activ_func)(const float *restrict, float *restrict, int));
 
@@ -17,10 +115,18 @@ int setup_loss_function(float (*loss_func)(const float *restrict, const float *r
 int setup_optimizer(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int), 
     float learning_rate
 );
+int setup_mixed_precision(int enable, float loss_scale);
 
 float* forward(const float *inputs);
+float* forward_batch(const float *inputs, int batch_size);
 float compute_loss(const float *y_true);
 int backward(const float *restrict inputs, const float *restrict y_true);
+int backward_batch(const float *restrict inputs, const float *restrict y_true, int batch_size);
+float train_batch_parallel(const float *inputs, const float *labels, int batch_size, int num_threads);
+float compute_loss_sparse(int32_t y_true);
+int backward_sparse(const float *restrict inputs, int32_t y_true);
+int backward_batch_sparse(const float *restrict inputs, const int32_t *restrict y_true, int batch_size);
+float train_batch_parallel_sparse(const float *inputs, const int32_t *labels, int batch_size, int num_threads);
 int update_weights(void);
 int zero_grads(void);
 
@@ -0,0 +1,87 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdint.h>
+
+// Dataset held in one contiguous, 64-byte aligned buffer for features and
+// one for labels. Splits, subsets and shuffles are views: they share the
+// storage and only keep their own sample order, so nothing is copied until
+// a batch is gathered. Storage is freed once the last view is deleted.
+// Views may be read from several threads, but creating and deleting views
+// of the same storage must not race.
+
+typedef struct SynDataset SynDataset;
+
+// Uninitialized storage to be filled through syn_dataset_features()/labels()
+SynDataset* syn_dataset_create(long num_samples, int input_size, int label_size);
+
+// Zero-copy over mapped tensor files written by synapse-convert; labels may
+// be one-hot float rows or int32 class indices
+SynDataset* syn_dataset_from_tensors(const char *data_file, const char *labels_file);
+
+SynDataset* syn_dataset_from_csv(const char *data_file, const char *labels_file,
+    long num_samples, int input_size, int num_classes
+);
+SynDataset* syn_dataset_from_idx(const char *images_file, const char *labels_file, int num_classes);
+
+// Labels kept as one int32 class index per sample instead of a one-hot row,
+// num_classes times smaller. These datasets have label_size 1 and no float
+// labels; read them through the _class/_classes functions.
+SynDataset* syn_dataset_create_classes(long num_samples, int input_size);
+SynDataset* syn_dataset_from_csv_classes(const char *data_file, const char *labels_file,
+    long num_samples, int input_size, int num_classes
+);
+SynDataset* syn_dataset_from_idx_classes(const char *images_file, const char *labels_file, int num_classes);
+
+void syn_dataset_delete(SynDataset *ds);
+
+long syn_dataset_size(const SynDataset *ds);
+int syn_dataset_input_size(const SynDataset *ds);
+int syn_dataset_label_size(const SynDataset *ds);
+
+// Base of the storage in storage order, NULL for mapped read-only storage
+float* syn_dataset_features(SynDataset *ds);
+float* syn_dataset_labels(SynDataset *ds);
+int32_t* syn_dataset_classes(SynDataset *ds);
+
+int syn_dataset_has_classes(const SynDataset *ds);
+
+// First (1 - test_size) of the samples in view order go to train, the rest to test
+int syn_dataset_split(const SynDataset *ds, float test_size, SynDataset **train, SynDataset **test);
+
+// Samples [begin, end) of the view
+SynDataset* syn_dataset_subset(const SynDataset *ds, long begin, long end);
+
+// Permutes the sample order of this view only
+int syn_dataset_shuffle(SynDataset *ds, unsigned long long seed);
+
+// Zero-copy pointers to sample i of the view; labels may be NULL and is
+// set to NULL for class-index labels
+const float* syn_dataset_sample(const SynDataset *ds, long i, const float **labels);
+
+// Class index of sample i of the view, -1 without class-index labels
+int32_t syn_dataset_class(const SynDataset *ds, long i);
+
+// Copies count samples starting at view position begin into contiguous
+// (count x input_size) inputs and (count x label_size) labels
+int syn_dataset_gather(const SynDataset *ds, long begin, long count, float *inputs, float *labels);
+int syn_dataset_gather_classes(const SynDataset *ds, long begin, long count, float *inputs, int32_t *classes);
+
+
+// Mini-batch iterator over a dataset. A producer thread gathers the next
+// batch into one of two aligned buffers while the caller trains on the
+// other. With shuffle set, the sample order is reshuffled every epoch from
+// seed, so runs are reproducible.
+typedef struct SynBatchIter SynBatchIter;
+
+SynBatchIter* syn_batch_iter_create(const SynDataset *ds, int batch_size, int shuffle, unsigned long long seed);
+void syn_batch_iter_delete(SynBatchIter *it);
+
+// Returns the size of the next batch (the last one of an epoch may be
+// smaller) and points inputs/labels at it until the following call.
+// Returns 0 once at the end of every epoch and -1 on error; the call after
+// 0 starts the next epoch.
+int syn_batch_iter_next(SynBatchIter *it, const float **inputs, const float **labels);
+int syn_batch_iter_next_classes(SynBatchIter *it, const float **inputs, const int32_t **classes);
+
+#endif
@@ -1,12 +1,36 @@
 #ifndef LOADER_H
 #define LOADER_H
 
+#include <stdint.h>
+
+// CSV files are parsed in parallel straight into one contiguous block.
+// Returned sample buffers are 64-byte aligned.
+// Malformed rows are reported with their line number.
+
+// (num_rows x num_cols) row-major matrix, released with free()
+float* read_csv_matrix(const char *filename, int num_rows, int num_cols);
+
+// Row pointers into a single block; release with delete_data()/delete_labels()
 float** read_csv_data(const char *filename, int num_samples, int input_size);
 float** read_csv_labels(const char *filename, int num_samples, int num_classes);
 
+// One int32 class index per sample instead of a one-hot row, released with free()
+int32_t* read_csv_classes(const char *filename, int num_samples, int num_classes);
+
+// IDX files as distributed with MNIST, raw or gzip-compressed, are
+// decompressed straight into one contiguous (num_samples x input_size)
+// buffer released with free(). read_idx_images() scales pixels to [-1, 1];
+// read_idx_images_u8() keeps the raw bytes. Labels are one-hot rows from
+// read_idx_labels() or int32 class indices from read_idx_classes().
+float* read_idx_images(const char *filename, int *num_samples, int *input_size);
+unsigned char* read_idx_images_u8(const char *filename, int *num_samples, int *input_size);
+float* read_idx_labels(const char *filename, int *num_samples, int num_classes);
+int32_t* read_idx_classes(const char *filename, int *num_samples, int num_classes);
+
 void delete_data(float **data, int num_samples);
 void delete_labels(float **labels, int num_samples);
 
+// Copies every row; syn_dataset_split() (dataset.h) splits without copying
 int split_data(float **data, float **labels, int num_samples, int input_size, int num_classes,
     float test_size, float ***train_data, float ***test_data,
     float ***train_labels, float ***test_labels,
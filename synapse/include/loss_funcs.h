@@ -5,4 +5,7 @@ float mean_squared_error(const float *restrict y_true, const float *restrict y_p
 float binary_cross_entropy(const float *restrict y_true, const float *restrict y_pred, int size);
 float categorical_cross_entropy(const float *restrict y_true, const float *restrict y_pred, int size);
 
+// Categorical cross-entropy against a class index instead of a one-hot row
+float sparse_categorical_cross_entropy(int y_true, const float *restrict y_pred, int size);
+
 #endif
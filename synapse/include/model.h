@@ -0,0 +1,50 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+// Read-only trained model and lightweight inference contexts. A SynModel
+// is never written after loading, so any number of threads can run
+// inference on it at once, each through its own SynInferCtx.
+
+typedef struct SynModel SynModel;
+typedef struct SynInferCtx SynInferCtx;
+
+// Version 2 files are mapped read-only, so processes loading the same
+// file share one copy of the weights; older files are read into memory.
+SynModel* syn_load_model(const char *filename);
+void syn_delete_model(SynModel *model);
+
+// Checks the parameters of a mapped file against their checksum, which
+// loading skips so it never reads the weights; 0 when they match or the
+// file format has no checksum
+int syn_model_verify(const SynModel *model);
+
+// Writes a model, including quantized ones, in the current file format
+int syn_save_model(const SynModel *model, const char *filename);
+
+// INT8 post-training quantization: every layer gets per-row weight scales
+// and an activation scale calibrated by an fp32 pass over num_samples
+// inputs, which should come from the training data. The result runs
+// through syn_infer()/syn_infer_batch() like any other model.
+SynModel* syn_quantize_model(const SynModel *model, const float *calib_inputs, int num_samples);
+
+// 16-bit weight formats of syn_model_to_half()
+typedef enum {
+    SYN_HALF_F16,
+    SYN_HALF_BF16
+} SynHalfType;
+
+// Copy with the weights rounded to IEEE half or bfloat16, halving their
+// memory and bandwidth; inference widens them and sums in fp32, so unlike
+// INT8 the activations keep full precision. Biases stay fp32.
+SynModel* syn_model_to_half(const SynModel *model, SynHalfType type);
+
+int syn_model_input_size(const SynModel *model);
+int syn_model_output_size(const SynModel *model);
+
+SynInferCtx* syn_create_infer_ctx(const SynModel *model, int max_batch_size);
+void syn_delete_infer_ctx(SynInferCtx *ctx);
+
+const float* syn_infer(SynInferCtx *ctx, const float *inputs);
+const float* syn_infer_batch(SynInferCtx *ctx, const float *inputs, int batch_size);
+
+#endif
@@ -1,25 +1,34 @@
 #ifndef OPTIMIZERS_H
 #define OPTIMIZERS_H
 
+// Optimizer state over the flat parameter vector. The moment buffers are
+// borrowed from the caller (the network arena) and are not freed with the cache.
 typedef struct {
-    float *w_momentum;
-    float *b_momentum;
-    float *w_squared_grads;
-    float *b_squared_grads;
-    int w_start;
-    int b_start;
+    float *momentum;
+    float *squared_grads;
+    int t;
+    float beta1;
+    float beta2;
 } OptimizerCache;
 
+// Set the betas of the handle-less network; see syn_set_beta1()/syn_set_beta2()
 void set_beta1(float new_beta1);
 void set_beta2(float new_beta2);
 
+// Number of parameter-sized state vectors the optimizer keeps
+int optimizer_num_moments(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int));
+
+// moments must hold optimizer_num_moments() * size zeroed floats
 OptimizerCache* init_optimizer_cache(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
-    int num_weights,
-    int num_biases
+    float *moments,
+    int size
 );
 
 void free_optimizer_cache(OptimizerCache **cache);
 
+// Update size parameters in place from the matching gradients in one pass.
+// flag is unused and only kept for source compatibility.
+
 int sgd(float *restrict weights,
     const float *restrict weight_grads,
     int size,
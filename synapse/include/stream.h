@@ -0,0 +1,40 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+
+// Out-of-core batch source for float tensor files larger than memory.
+// Labels may also be a column of int32 class indices.
+// A reader thread streams fixed-size shards of rows sequentially into a
+// bounded ring of buffers, with kernel readahead requested through
+// posix_fadvise() where available. Batches are drawn from a shuffle window
+// that approximates a global shuffle. Memory use is
+// (num_shards * shard_rows + shuffle_window + batch_size) rows, whatever
+// the size of the files.
+
+typedef struct SynStream SynStream;
+
+typedef struct {
+    int batch_size;
+    long shard_rows;            // rows per read, 0 for the default
+    int num_shards;             // ring capacity, 0 for the default
+    long shuffle_window;        // samples, 0 to keep file order
+    unsigned long long seed;
+} SynStreamConfig;
+
+SynStream* syn_stream_open(const char *data_file, const char *labels_file, const SynStreamConfig *config);
+void syn_stream_close(SynStream *stream);
+
+long syn_stream_num_samples(const SynStream *stream);
+int syn_stream_input_size(const SynStream *stream);
+int syn_stream_label_size(const SynStream *stream);
+
+// Set when the labels file holds int32 class indices (label_size 1)
+int syn_stream_has_classes(const SynStream *stream);
+
+// Same contract as syn_batch_iter_next(): the batch size, 0 once at the end
+// of every pass over the files, -1 on error
+int syn_stream_next(SynStream *stream, const float **inputs, const float **labels);
+int syn_stream_next_classes(SynStream *stream, const float **inputs, const int32_t **classes);
+
+#endif
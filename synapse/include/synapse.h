@@ -2,6 +2,10 @@
 #define SYNAPSE_H
 
 #include "loader.h"
+#include "tensor_file.h"
+#include "dataset.h"
+#include "stream.h"
+#include "model.h"
 #include "braincraft.h"
 #include "utils.h"
 
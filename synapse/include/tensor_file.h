@@ -0,0 +1,57 @@
+#ifndef TENSOR_FILE_H
+#define TENSOR_FILE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Binary tensor file: a 64-byte header followed by num_rows contiguous rows
+// of num_cols elements, starting at data_offset (a multiple of alignment).
+// Only the data section is aligned; rows are packed back to back.
+//
+//   offset  size  field
+//   0       4     magic "SYNT"
+//   4       4     version
+//   8       4     dtype (SYN_DTYPE_*)
+//   12      4     alignment of the data section in bytes
+//   16      8     num_rows
+//   24      8     num_cols
+//   32      8     data_offset
+//   40      24    reserved, zero
+//
+// All fields are little-endian. Files are opened with mmap(), so rows are
+// returned without copying and concurrent readers share the page cache.
+
+#define SYN_TENSOR_VERSION 1
+#define SYN_TENSOR_ALIGNMENT 64
+
+typedef enum {
+    SYN_DTYPE_F32 = 1,
+    SYN_DTYPE_U8 = 2,
+    SYN_DTYPE_I32 = 3
+} SynDtype;
+
+typedef struct SynTensorFile SynTensorFile;
+
+size_t syn_dtype_size(SynDtype dtype);
+
+SynTensorFile* syn_tensor_open(const char *filename);
+void syn_tensor_close(SynTensorFile *file);
+
+long syn_tensor_num_rows(const SynTensorFile *file);
+long syn_tensor_num_cols(const SynTensorFile *file);
+SynDtype syn_tensor_dtype(const SynTensorFile *file);
+
+// Start of the data section and of a single row; valid until the file is closed
+const void* syn_tensor_data(const SynTensorFile *file);
+const void* syn_tensor_row(const SynTensorFile *file, long row);
+
+// Writes num_rows x num_cols elements of dtype from data
+int syn_tensor_write(const char *filename, SynDtype dtype, const void *data, long num_rows, long num_cols);
+
+// Incremental writer for data that does not fit in memory at once:
+// begin, append rows in order, then end to fill in the header
+FILE* syn_tensor_write_begin(const char *filename, SynDtype dtype, long num_cols);
+int syn_tensor_write_rows(FILE *stream, SynDtype dtype, const void *rows, long num_rows, long num_cols);
+int syn_tensor_write_end(FILE *stream, SynDtype dtype, long num_rows, long num_cols);
+
+#endif
@@ -4,6 +4,7 @@
 #include <math.h>
 
 #include "activ_funcs.h"
+#include "kernels/kernels.h"
 
 
 #define CHECK_ACTIV_ARGS(x, out, size) \
@@ -22,47 +23,32 @@ int linear(const float *restrict x, float *restrict out, int size) {
 
 int relu(const float *restrict x, float *restrict out, int size) {
     CHECK_ACTIV_ARGS(x, out, size);
-    
-    for (int i = 0; i < size; ++i) {
-        out[i] = (x[i] > 0.0f) ? x[i] : 0.0f;
-    }
-
+    kernel_activ(ACTIV_RELU, size, x, out);
     return 0;
 }
 
 
 int sigmoid(const float *restrict x, float *restrict out, int size) {
     CHECK_ACTIV_ARGS(x, out, size);
-
-    for (int i = 0; i < size; ++i) {
-        out[i] = 1.0f / (1.0f + expf(-x[i]));
-    }
-
+    kernel_activ(ACTIV_SIGMOID, size, x, out);
     return 0;
 }
 
 
 int softmax(const float *restrict x, float *restrict out, int size) {
     CHECK_ACTIV_ARGS(x, out, size);
+    kernel_activ(ACTIV_SOFTMAX, size, x, out);
+    return 0;
+}
 
-    float max = x[0];
-    for (int i = 1; i < size; ++i) {
-        if (x[i] > max) {
-            max = x[i];
-        }
-    }
 
-    float sum = 0.0f;
-    for (int i = 0; i < size; ++i) {
-        out[i] = expf(x[i] - max);
-        sum += out[i];
-    }
-    
-    for (int i = 0; i < size; ++i) {
-        out[i] /= sum;
-    }
+void syn_set_math_mode(SynMathMode mode) {
+    kernel_set_math_fast(mode == SYN_MATH_FAST);
+}
 
-    return 0;
+
+SynMathMode syn_math_mode(void) {
+    return kernel_math_fast() ? SYN_MATH_FAST : SYN_MATH_PRECISE;
 }
 
 
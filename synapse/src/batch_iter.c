@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "dataset.h"
+#include "samples_internal.h"
+
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_FILLED,
+    SLOT_IN_USE
+} SlotState;
+
+
+typedef struct {
+    float *inputs;
+    void *labels;       // float rows or int32 class indices
+    int count;      // 0 marks the end of an epoch, -1 a failed gather
+    SlotState state;
+} BatchSlot;
+
+
+struct SynBatchIter {
+    SynDataset *view;
+    int batch_size;
+    int shuffle;
+    int has_classes;
+    unsigned long long seed;
+
+    BatchSlot slots[2];
+    int next_read;
+    int held;
+
+    pthread_t producer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stop;
+};
+
+
+// Fills the slots in turn: every batch of an epoch, then an end-of-epoch
+// marker. The view is reshuffled before each epoch; once the iterator runs
+// only this thread touches it.
+static void* producer_main(void *arg) {
+    SynBatchIter *it = (SynBatchIter *)arg;
+    const long size = syn_dataset_size(it->view);
+    unsigned long long epoch = 0;
+    int in_epoch = 0;
+    long pos = 0;
+    int next_write = 0;
+
+    for (;;) {
+        BatchSlot *slot = &it->slots[next_write];
+
+        pthread_mutex_lock(&it->mutex);
+        while (!it->stop && slot->state != SLOT_FREE) {
+            pthread_cond_wait(&it->cond, &it->mutex);
+        }
+        int stop = it->stop;
+        pthread_mutex_unlock(&it->mutex);
+
+        if (stop) break;
+
+        int failed = 0;
+        if (!in_epoch) {
+            failed = it->shuffle && syn_dataset_shuffle(it->view, it->seed + epoch);
+            in_epoch = 1;
+        }
+
+        if (failed) {
+            slot->count = -1;
+        } else if (pos < size) {
+            int count = (size - pos < it->batch_size) ? (int)(size - pos) : it->batch_size;
+            int status = it->has_classes ?
+                syn_dataset_gather_classes(it->view, pos, count, slot->inputs, (int32_t *)slot->labels) :
+                syn_dataset_gather(it->view, pos, count, slot->inputs, (float *)slot->labels);
+            slot->count = status ? -1 : count;
+            pos += count;
+        } else {
+            slot->count = 0;
+            pos = 0;
+            in_epoch = 0;
+            ++epoch;
+        }
+
+        pthread_mutex_lock(&it->mutex);
+        slot->state = SLOT_FILLED;
+        pthread_cond_broadcast(&it->cond);
+        pthread_mutex_unlock(&it->mutex);
+
+        // Nothing is produced after an error
+        if (slot->count < 0) break;
+        next_write ^= 1;
+    }
+
+    return NULL;
+}
+
+
+static void free_batch_iter(SynBatchIter *it) {
+    for (int s = 0; s < 2; ++s) {
+        free(it->slots[s].inputs);
+        free(it->slots[s].labels);
+    }
+
+    syn_dataset_delete(it->view);
+    free(it);
+}
+
+
+SynBatchIter* syn_batch_iter_create(const SynDataset *ds, int batch_size, int shuffle, unsigned long long seed) {
+    if (!ds || batch_size <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    SynBatchIter *it = (SynBatchIter *)calloc(1, sizeof(SynBatchIter));
+    if (!it) {
+        fprintf(stderr, "Error: Memory allocation failed for batch iterator.\n");
+        return NULL;
+    }
+
+    it->batch_size = batch_size;
+    it->shuffle = shuffle;
+    it->has_classes = syn_dataset_has_classes(ds);
+    it->seed = seed;
+    it->held = -1;
+
+    // Private view, so shuffling leaves the caller's order alone
+    it->view = syn_dataset_subset(ds, 0, syn_dataset_size(ds));
+    if (!it->view) {
+        free(it);
+        return NULL;
+    }
+
+    size_t input_bytes = (size_t)batch_size * syn_dataset_input_size(ds) * sizeof(float);
+    // Both label kinds are 4-byte values
+    size_t label_bytes = (size_t)batch_size * syn_dataset_label_size(ds) * sizeof(float);
+
+    for (int s = 0; s < 2; ++s) {
+        it->slots[s].inputs = (float *)alloc_samples(input_bytes);
+        it->slots[s].labels = alloc_samples(label_bytes);
+
+        if (!it->slots[s].inputs || !it->slots[s].labels) {
+            fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
+            free_batch_iter(it);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&it->mutex, NULL);
+    pthread_cond_init(&it->cond, NULL);
+
+    if (pthread_create(&it->producer, NULL, producer_main, it) != 0) {
+        fprintf(stderr, "Error: Failed to start the batch producer thread.\n");
+        pthread_mutex_destroy(&it->mutex);
+        pthread_cond_destroy(&it->cond);
+        free_batch_iter(it);
+        return NULL;
+    }
+
+    return it;
+}
+
+
+void syn_batch_iter_delete(SynBatchIter *it) {
+    if (!it) return;
+
+    pthread_mutex_lock(&it->mutex);
+    it->stop = 1;
+    pthread_cond_broadcast(&it->cond);
+    pthread_mutex_unlock(&it->mutex);
+
+    pthread_join(it->producer, NULL);
+    pthread_mutex_destroy(&it->mutex);
+    pthread_cond_destroy(&it->cond);
+
+    free_batch_iter(it);
+}
+
+
+static int next_iter_batch(SynBatchIter *it, const float **inputs, const void **labels) {
+    BatchSlot *slot = &it->slots[it->next_read];
+
+    pthread_mutex_lock(&it->mutex);
+
+    // The batch handed out last time is done with; let the producer refill it
+    if (it->held >= 0) {
+        it->slots[it->held].state = SLOT_FREE;
+        it->held = -1;
+        pthread_cond_broadcast(&it->cond);
+    }
+
+    while (slot->state != SLOT_FILLED) {
+        pthread_cond_wait(&it->cond, &it->mutex);
+    }
+
+    // A failed slot stays filled so every later call fails too
+    if (slot->count < 0) {
+        pthread_mutex_unlock(&it->mutex);
+        fprintf(stderr, "Error: Failed to gather a batch.\n");
+        return -1;
+    }
+
+    slot->state = SLOT_IN_USE;
+    pthread_mutex_unlock(&it->mutex);
+
+    it->held = it->next_read;
+    it->next_read ^= 1;
+
+    *inputs = slot->inputs;
+    if (labels) *labels = slot->labels;
+
+    return slot->count;
+}
+
+
+int syn_batch_iter_next(SynBatchIter *it, const float **inputs, const float **labels) {
+    if (!it || !inputs || (labels && it->has_classes)) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return -1;
+    }
+
+    const void *batch_labels;
+    int count = next_iter_batch(it, inputs, &batch_labels);
+    if (count >= 0 && labels) *labels = (const float *)batch_labels;
+
+    return count;
+}
+
+
+int syn_batch_iter_next_classes(SynBatchIter *it, const float **inputs, const int32_t **classes) {
+    if (!it || !inputs || (classes && !it->has_classes)) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return -1;
+    }
+
+    const void *batch_classes;
+    int count = next_iter_batch(it, inputs, &batch_classes);
+    if (count >= 0 && classes) *classes = (const int32_t *)batch_classes;
+
+    return count;
+}
@@ -1,15 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <stdatomic.h>
 
 #include "braincraft.h"
 #include "utils.h"
+#include "thread_pool.h"
+#include "model_internal.h"
+#include "optimizers_internal.h"
+#include "kernels/kernels.h"
 
 
+// Parameters, gradients and single-sample buffers are views into the
+// network arena; offset locates the weights in the flat parameter vector.
 typedef struct {
     int input_size;
     int output_size;
+    size_t offset;
     float *weights;
     float *weight_grads;
     float *biases;
@@ -18,621 +29,2214 @@ typedef struct {
     float *sums;
     float *activs;
     int (*activ_func)(const float *restrict, float *restrict, int);
+    int activ_op;
 } Layer;
 
 
-static Layer *_nn = NULL;
-static int _num_layers = 0;
-static int _lidx = 0;
-static int _num_weights = 0;
-static int _num_biases = 0;
+// Per-layer buffers for a batch of samples, each (capacity x output_size).
+// The network owns one for forward_batch()/backward_batch() and every
+// parallel training worker owns its own.
+typedef struct {
+    int capacity;
+    float **sums;
+    float **activs;
+    float **deltas;
 
-static float (*_loss_func)(const float *restrict, const float *restrict, int) = NULL;
-static int (*_optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int) = NULL;
-static OptimizerCache *_cache = NULL;
-static float _learning_rate = 0.0f;
+    // Mixed precision: the hidden layers keep their activations for the
+    // backward pass in bf16 here, and their sums/activs/deltas entries
+    // point into scratch, see reserve_mixed_workspace()
+    uint16_t **half_activs;
+    float *scratch;
+} Workspace;
 
 
-int create_neural_network(int num_layers) {
-    if (_nn) {
-        fprintf(stderr, "Error: Neural network already created.\n");
-        return 1;
-    }
+typedef struct {
+    Workspace ws;
+    float *grads;
+    float loss;
+    int status;
+} Worker;
+
+
+struct SynNetwork {
+    Layer *layers;
+    int num_layers;
+    int lidx;
+    int num_weights;
+    int num_biases;
+
+    // One 64-byte aligned block laid out as parameters, optimizer moments,
+    // gradients and single-sample buffers. Every region is num_params long
+    // (the parameter count with each weight and bias block padded to 64 bytes)
+    // except the last one.
+    float *arena;
+    size_t num_params;
+    float *params;
+    float *moments;
+    int num_moments;
+    float *grads;
+
+    // Set by an inference-only load: the arena holds just the parameters
+    // and two unit buffers shared by all layers, see reserve_inference_arena().
+    // The parameters of a mapped model file are used in place instead.
+    int inference;
+    int max_width;
+    SynModel *mapped;
+
+    // Set by syn_setup_mixed_precision(); loss_scale is 0 without loss
+    // scaling and scale_steps counts the steps since it last changed
+    int mixed;
+    float loss_scale;
+    int scale_steps;
+
+    float (*loss_func)(const float *restrict, const float *restrict, int);
+    int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int);
+    OptimizerCache *cache;
+
+    // Softmax/cross-entropy output head of the last forward(): the output
+    // deltas and the loss for head_labels or head_class at head_scale, shared
+    // by compute_loss() and backward() and cleared by the next forward()
+    int head_valid;
+    const float *head_labels;
+    int32_t head_class;
+    float head_scale;
+    float head_loss;
+    float learning_rate;
+    float beta1;
+    float beta2;
+
+    Workspace ws;
+    int batch_size;
+
+    ThreadPool *pool;
+    Worker *workers;
+
+    // State of rand_normal()
+    unsigned int rng;
+    int have_spare;
+    float spare;
+};
+
+
+#define DEFAULT_BETA1 0.9f
+#define DEFAULT_BETA2 0.999f
+
+// Network behind the handle-less API
+static SynNetwork _default = { .beta1 = DEFAULT_BETA1, .beta2 = DEFAULT_BETA2 };
+
+// Gradients are summed across workers in chunks that stay in cache
+#define REDUCE_CHUNK 4096
+
+// Parameters from which update_weights() runs the optimizer on the pool
+#define PARALLEL_UPDATE_MIN (1 << 17)
+
+#define ARENA_ALIGN 64
+#define ALIGN_FLOATS(n) (((size_t)(n) + 15) & ~(size_t)15)
+
+// Clean steps after which a dynamic loss scale doubles
+#define LOSS_SCALE_WINDOW 2000
+
+#define CHECKPOINT_MAGIC "SYNC"
+#define CHECKPOINT_VERSION 1
+
+// Layers from PROFILE_LAYERS - 1 on share the last profile row
+#define PROFILE_LAYERS 64
+
+// Profiled parts of a training step; PROFILE_LOSS is the output layer's
+// loss and deltas
+enum {
+    PROFILE_FORWARD,
+    PROFILE_LOSS,
+    PROFILE_BACKWARD,
+    PROFILE_UPDATE,
+    PROFILE_PHASES
+};
 
-    if (num_layers <= 0) {
-        fprintf(stderr, "Error: Invalid number of layers specified for the neural network.\n");
-        return 1;
-    }
+typedef struct {
+    atomic_ullong ns;
+    atomic_ullong calls;
+    atomic_ullong flops;
+    atomic_ullong bytes;
+} ProfileEntry;
 
-    _nn = (Layer *)malloc((_num_layers = num_layers) * sizeof(Layer));
-    if (!_nn) {
-        fprintf(stderr, "Error: Memory allocation failed for neural network layers.\n");
-        return 1;
-    }
+static const char *_profile_phases[PROFILE_PHASES] = { "forward", "loss", "backward", "update" };
 
-    return 0;
-}
+// FLOPs per parameter of each OPTIM_* rule, with sqrt and division as one,
+// and the floats it reads or writes per parameter
+static const int _optim_flops[] = { 2, 5, 7, 9, 13 };
+static const int _optim_floats[] = { 3, 5, 5, 5, 7 };
 
+static atomic_int _profile_enabled = 0;
 
-void delete_neural_network(void) {
-    if (!_nn) return;
+// One row per layer, then the network-wide row
+static ProfileEntry _profile[PROFILE_LAYERS + 1][PROFILE_PHASES];
 
-    free_optimizer_cache(&_cache);
 
-    for (int i = 0; i < _num_layers; ++i) {
-        Layer *layer = &_nn[i];
+// Start time of a profiled span, 0 while profiling is off
+unsigned long long profile_start(void) {
+    if (!atomic_load_explicit(&_profile_enabled, memory_order_relaxed)) return 0;
 
-        if (layer->weights) {
-            free(layer->weights);
-            layer->weights = NULL;
-        }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
 
-        if (layer->weight_grads) {
-            free(layer->weight_grads);
-            layer->weight_grads = NULL;
-        }
 
-        if (layer->biases) {
-            free(layer->biases);
-            layer->biases = NULL;
-        }
+// Adds a span from profile_start() to layer (-1 for network-wide work)
+void profile_record(int phase, int layer, unsigned long long start, double flops, double bytes) {
+    if (!start) return;
 
-        if (layer->bias_grads) {
-            free(layer->bias_grads);
-            layer->bias_grads = NULL;
-        }
+    ProfileEntry *entry = &_profile[(layer < 0) ? PROFILE_LAYERS : (layer < PROFILE_LAYERS) ? layer : PROFILE_LAYERS - 1][phase];
+    atomic_fetch_add_explicit(&entry->ns, profile_start() - start, memory_order_relaxed);
+    atomic_fetch_add_explicit(&entry->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&entry->flops, (unsigned long long)flops, memory_order_relaxed);
+    atomic_fetch_add_explicit(&entry->bytes, (unsigned long long)bytes, memory_order_relaxed);
+}
 
-        if (layer->deltas) {
-            free(layer->deltas);
-            layer->deltas = NULL;
-        }
 
-        if (layer->sums) {
-            free(layer->sums);
-            layer->biases = NULL;
-        }
-        
-        if (layer->activs) {
-            free(layer->activs);
-            layer->biases = NULL;
+// Forward and backward spans of layer l over batch_size rows. The forward
+// pass reads the parameters and inputs and writes sums and activations; the
+// backward pass updates the gradients and, below the output layer, also
+// propagates the next layer's deltas through its weights.
+void profile_layer(int phase, int l, const Layer *layer, const Layer *next_layer, int batch_size,
+    unsigned long long start
+) {
+    if (!start) return;
+
+    const double batch = batch_size;
+    const double in = layer->input_size, out = layer->output_size;
+    const double params = in * out + out;
+
+    double flops = batch * (2.0 * in * out + out);
+    double bytes;
+
+    if (phase == PROFILE_FORWARD) {
+        bytes = 4.0 * params + 4.0 * batch * (in + 2.0 * out);
+    } else {
+        bytes = 8.0 * params + 4.0 * batch * (in + out);
+
+        if (next_layer) {
+            const double next_out = next_layer->output_size;
+            flops += 2.0 * batch * out * next_out;
+            bytes += 4.0 * next_out * out + 4.0 * batch * (next_out + 2.0 * out);
         }
     }
 
-    free(_nn);
-    _nn = NULL;
+    profile_record(phase, l, start, flops, bytes);
 }
 
 
-const char* get_activ_func_name(int (*activ_func)(const float *restrict, float *restrict, int)) {
-    if (activ_func == linear) return "Linear";
-    if (activ_func == relu) return "ReLU";
-    if (activ_func == sigmoid) return "Sigmoid";
-    if (activ_func == softmax) return "Softmax";
-    return "Unknown";
+void synapse_profile_enable(int enable) {
+    atomic_store_explicit(&_profile_enabled, enable ? 1 : 0, memory_order_relaxed);
 }
 
 
-int (*get_activ_func_by_name(const char *name))(const float *restrict, float *restrict, int) {
-    if (strcmp(name, "Linear") == 0) return linear;
-    if (strcmp(name, "ReLU") == 0) return relu;
-    if (strcmp(name, "Sigmoid") == 0) return sigmoid;
-    if (strcmp(name, "Softmax") == 0) return softmax;
-    return NULL;
+int synapse_profile_enabled(void) {
+    return atomic_load_explicit(&_profile_enabled, memory_order_relaxed);
 }
 
 
-void info_neural_network(void) {
-    if (!_nn || _num_layers != _lidx) return;
+void synapse_profile_reset(void) {
+    for (int l = 0; l <= PROFILE_LAYERS; ++l) {
+        for (int p = 0; p < PROFILE_PHASES; ++p) {
+            ProfileEntry *entry = &_profile[l][p];
+            atomic_store_explicit(&entry->ns, 0, memory_order_relaxed);
+            atomic_store_explicit(&entry->calls, 0, memory_order_relaxed);
+            atomic_store_explicit(&entry->flops, 0, memory_order_relaxed);
+            atomic_store_explicit(&entry->bytes, 0, memory_order_relaxed);
+        }
+    }
+}
 
-    for (int l = 0; l < ((_num_layers <= 10) ? _num_layers : 10); ++l) {
-        Layer *layer = &_nn[l];
-        const char *activ_func_name = get_activ_func_name(layer->activ_func);
 
-        printf("Layer: %d Input size: %d Output size: %d\n\n", l + 1, layer->input_size, layer->output_size);
+// Rows with at least one call, by layer and phase, as a table with each
+// row's share of the total time or as a JSON object
+int synapse_profile_report(FILE *out, SynProfileFormat format) {
+    if (!out || (format != SYN_PROFILE_TABLE && format != SYN_PROFILE_JSON)) {
+        fprintf(stderr, "Error: Invalid input parameters for the profile report.\n");
+        return 1;
+    }
 
-        for (int i = 0; i < ((layer->output_size <= 10) ? layer->output_size : 10); ++i) {
-            printf("  Neuron %d:\n", i + 1);
-            
-            int limit = (layer->input_size < 10) ? layer->input_size : 10;
+    double total = 0.0;
+    for (int l = 0; l <= PROFILE_LAYERS; ++l) {
+        for (int p = 0; p < PROFILE_PHASES; ++p) {
+            total += atomic_load_explicit(&_profile[l][p].ns, memory_order_relaxed) * 1e-9;
+        }
+    }
 
-            printf("             Weights:  [");
-            for (int j = 0; j < limit; ++j) {
-                printf(" %f", layer->weights[i * layer->input_size + j]);
+    if (format == SYN_PROFILE_TABLE) {
+        fprintf(out, "%-6s %-9s %10s %12s %12s %10s %10s %7s\n",
+            "layer", "phase", "calls", "total ms", "avg us", "GFLOP/s", "GB/s", "time");
+    } else {
+        fprintf(out, "{\n  \"total_seconds\": %.9f,\n  \"rows\": [", total);
+    }
+
+    int rows = 0;
+    for (int l = 0; l <= PROFILE_LAYERS; ++l) {
+        for (int p = 0; p < PROFILE_PHASES; ++p) {
+            const ProfileEntry *entry = &_profile[l][p];
+            unsigned long long calls = atomic_load_explicit(&entry->calls, memory_order_relaxed);
+            if (!calls) continue;
+
+            double seconds = atomic_load_explicit(&entry->ns, memory_order_relaxed) * 1e-9;
+            double flops = (double)atomic_load_explicit(&entry->flops, memory_order_relaxed);
+            double bytes = (double)atomic_load_explicit(&entry->bytes, memory_order_relaxed);
+            double gflops = (seconds > 0.0) ? flops / seconds * 1e-9 : 0.0;
+            double gbps = (seconds > 0.0) ? bytes / seconds * 1e-9 : 0.0;
+
+            char layer[16];
+            if (l == PROFILE_LAYERS) {
+                snprintf(layer, sizeof(layer), "all");
+            } else {
+                snprintf(layer, sizeof(layer), (l == PROFILE_LAYERS - 1) ? "%d+" : "%d", l);
             }
-            if (layer->input_size > 10) printf(" ...");
-            printf(" ]\n");
 
-            printf("                Bias:  %f\n", layer->biases[i]);
+            if (format == SYN_PROFILE_TABLE) {
+                char rate[16];
+                snprintf(rate, sizeof(rate), (flops > 0.0) ? "%.2f" : "-", gflops);
 
-            printf("    Weight gradients:  [");            
-            for (int j = 0; j < limit; ++j) {
-                printf(" %f", layer->weight_grads[i * layer->input_size + j]);
+                fprintf(out, "%-6s %-9s %10llu %12.3f %12.3f %10s %10.2f %6.1f%%\n", layer, _profile_phases[p],
+                    calls, seconds * 1e3, seconds / calls * 1e6, rate, gbps, (total > 0.0) ? seconds / total * 100.0 : 0.0);
+            } else {
+                fprintf(out, "%s\n    {\"layer\": \"%s\", \"phase\": \"%s\", \"calls\": %llu, \"seconds\": %.9f, "
+                    "\"flops\": %.0f, \"bytes\": %.0f, \"gflops\": %.4f, \"gbps\": %.4f}",
+                    rows ? "," : "", layer, _profile_phases[p], calls, seconds, flops, bytes, gflops, gbps);
             }
-            if (layer->input_size > 10) printf(" ...");
-            printf(" ]\n");
-
-            printf("       Bias gradient:  %f\n", layer->bias_grads[i]);
-            printf("                 Sum:  %f\n", layer->sums[i]);
-            printf("          Activation:  %f\n\n", layer->activs[i]);
+            ++rows;
         }
+    }
 
-        if (layer->output_size > 10) printf("  ...\n\n");
-
-        printf("  Activation function: %s\n", activ_func_name);
-        printf("  Number of weights:   %d\n", layer->input_size * layer->output_size);
-        printf("  Number of biases:    %d\n\n", layer->output_size);
+    if (format == SYN_PROFILE_TABLE) {
+        fprintf(out, "%-6s %-9s %10s %12.3f\n", "total", "", "", total * 1e3);
+    } else {
+        fprintf(out, "\n  ]\n}\n");
     }
+
+    return 0;
 }
 
 
-int save_neural_network(const char *filename) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
-        return 1;
+void free_workspace(SynNetwork *net, Workspace *ws) {
+    // Inference-only workspaces point every layer into scratch and mixed
+    // precision ones own only the buffers of the output layer
+    const int last = net->num_layers - 1;
+    const int first = ws->half_activs ? last : net->inference ? net->num_layers : 0;
+
+    for (int l = first; l < net->num_layers; ++l) {
+        if (ws->sums) free(ws->sums[l]);
+        if (ws->activs) free(ws->activs[l]);
+        if (ws->deltas) free(ws->deltas[l]);
     }
 
-    if (_num_layers != _lidx) {
-        fprintf(stderr, "Error: Neural network not properly initialized.\n");
-        return 1;
+    for (int l = 0; l < last; ++l) {
+        if (ws->half_activs) free(ws->half_activs[l]);
     }
 
-    if (!filename) {
-        fprintf(stderr, "Error: Invalid file name provided.\n");
-        return 1;
+    free(ws->sums);
+    free(ws->activs);
+    free(ws->deltas);
+    free(ws->half_activs);
+    free(ws->scratch);
+
+    *ws = (Workspace){ 0 };
+}
+
+
+// The hidden layers compute through fp32 scratch rows sized to the widest
+// of them: sums and activs shared by all, deltas alternating between two so
+// each layer reads the deltas of the next one. The activations, which are
+// all the backward pass needs of them, are rounded to bf16 in half_activs.
+// The output layer keeps its own fp32 buffers.
+int reserve_mixed_workspace(SynNetwork *net, Workspace *ws, int batch_size) {
+    const int last = net->num_layers - 1;
+
+    int width = 0;
+    for (int l = 0; l < last; ++l) {
+        if (net->layers[l].output_size > width) width = net->layers[l].output_size;
     }
 
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
-        return 1;
+    if (!ws->half_activs) {
+        ws->half_activs = (uint16_t **)calloc(last, sizeof(uint16_t *));
+
+        if (!ws->half_activs) {
+            fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
+            ws->capacity = 0;
+            return 1;
+        }
     }
 
-    fwrite(&_num_layers, sizeof(int), 1, file);
+    const size_t rows = (size_t)batch_size * width;
+    float *scratch = (float *)realloc(ws->scratch, 4 * rows * sizeof(float));
+    if (scratch) ws->scratch = scratch;
+    int failed = !scratch;
+
+    for (int l = 0; l < last; ++l) {
+        size_t size = (size_t)batch_size * net->layers[l].output_size * sizeof(uint16_t);
 
-    for (int l = 0; l < _num_layers; ++l) {
-        Layer *layer = &_nn[l];
+        uint16_t *half_activs = (uint16_t *)realloc(ws->half_activs[l], size);
+        if (half_activs) ws->half_activs[l] = half_activs;
 
-        fwrite(&layer->input_size, sizeof(int), 1, file);
-        fwrite(&layer->output_size, sizeof(int), 1, file);
+        failed = failed || !half_activs;
+    }
 
-        int num_weights = layer->input_size * layer->output_size;
-        fwrite(layer->weights, sizeof(float), num_weights, file);
-        fwrite(layer->biases, sizeof(float), layer->output_size, file);
+    size_t size = (size_t)batch_size * net->layers[last].output_size * sizeof(float);
 
-        const char *activ_func_name = get_activ_func_name(layer->activ_func);
-        int name_len = (int)strlen(activ_func_name) + 1;
-        fwrite(&name_len, sizeof(int), 1, file);
-        fwrite(activ_func_name, sizeof(char), name_len, file);
+    float *sums = (float *)realloc(ws->sums[last], size);
+    if (sums) ws->sums[last] = sums;
+
+    float *activs = (float *)realloc(ws->activs[last], size);
+    if (activs) ws->activs[last] = activs;
+
+    float *deltas = (float *)realloc(ws->deltas[last], size);
+    if (deltas) ws->deltas[last] = deltas;
+
+    // The scratch may have moved, so the old capacity no longer covers the
+    // hidden-layer rows and the next call has to redo the reservation
+    if (failed || !sums || !activs || !deltas) {
+        fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
+        ws->capacity = 0;
+        return 1;
+    }
+
+    for (int l = 0; l < last; ++l) {
+        ws->sums[l] = scratch;
+        ws->activs[l] = scratch + rows;
+        ws->deltas[l] = scratch + (2 + l % 2) * rows;
     }
 
-    fclose(file); 
+    ws->capacity = batch_size;
     return 0;
 }
 
 
-int load_neural_network(const char *filename) {
-    if (!filename) {
-        fprintf(stderr, "Error: Invalid file name provided.\n");
-        return 1;
+int reserve_workspace(SynNetwork *net, Workspace *ws, int batch_size) {
+    if (ws->capacity >= batch_size) return 0;
+
+    if (!ws->sums) {
+        ws->sums = (float **)calloc(net->num_layers, sizeof(float *));
+        ws->activs = (float **)calloc(net->num_layers, sizeof(float *));
+        ws->deltas = (float **)calloc(net->num_layers, sizeof(float *));
+
+        if (!ws->sums || !ws->activs || !ws->deltas) {
+            fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
+            free_workspace(net, ws);
+            return 1;
+        }
     }
 
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
-        return 1;
+    if (net->mixed && net->num_layers > 1) {
+        return reserve_mixed_workspace(net, ws, batch_size);
     }
-    
-    fread(&_num_layers, sizeof(int), 1, file);
-    _lidx = _num_layers;
 
-    create_neural_network(_num_layers);
+    if (net->inference) {
+        const size_t rows = (size_t)batch_size * net->max_width;
 
-    for (int l = 0; l < _num_layers; ++l) {
-        Layer *layer = &_nn[l];
+        float *scratch = (float *)realloc(ws->scratch, 2 * rows * sizeof(float));
+        if (!scratch) {
+            fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
+            return 1;
+        }
+        ws->scratch = scratch;
+
+        // Layers alternate between two buffers. The GEMM epilogue activates
+        // tiles while later ones still read the inputs, so each layer writes
+        // its sums to the buffer its inputs are not in and activates them in
+        // place. Softmax runs after the whole product and normalizes back over
+        // the consumed inputs instead.
+        int cur = 0;
+        for (int l = 0; l < net->num_layers; ++l) {
+            ws->sums[l] = scratch + cur * rows;
+
+            if (net->layers[l].activ_op == ACTIV_SOFTMAX) {
+                ws->activs[l] = scratch + (1 - cur) * rows;
+            } else {
+                ws->activs[l] = ws->sums[l];
+                cur = 1 - cur;
+            }
+        }
 
-        fread(&layer->input_size, sizeof(int), 1, file);
-        fread(&layer->output_size, sizeof(int), 1, file);
+        ws->capacity = batch_size;
+        return 0;
+    }
 
-        int num_weights = layer->input_size * layer->output_size;
-        layer->weights = (float *)malloc(sizeof(float) * num_weights);
-        fread(layer->weights, sizeof(float), num_weights, file);
+    for (int l = 0; l < net->num_layers; ++l) {
+        size_t size = (size_t)batch_size * net->layers[l].output_size * sizeof(float);
 
-        layer->biases = (float *)malloc(sizeof(float) * layer->output_size);
-        fread(layer->biases, sizeof(float), layer->output_size, file);
-        
-        int name_len;
-        fread(&name_len, sizeof(int), 1, file);
-        char *activ_func_name = (char *)malloc(name_len);
-        fread(activ_func_name, sizeof(char), name_len, file);
+        float *sums = (float *)realloc(ws->sums[l], size);
+        if (sums) ws->sums[l] = sums;
 
-        layer->activ_func = get_activ_func_by_name(activ_func_name);
-        free(activ_func_name);
-        
-        int output_size = layer->output_size;
-        layer->weight_grads = (float *)calloc(num_weights, sizeof(float));
-        layer->bias_grads = (float *)calloc(output_size, sizeof(float));
-        layer->deltas = (float *)malloc(output_size * sizeof(float));
-        layer->sums = (float *)calloc(output_size, sizeof(float));
-        layer->activs = (float *)calloc(output_size, sizeof(float));
-
-        _num_weights += num_weights;
-        _num_biases += output_size;
-
-        if (!layer->weights || !layer->weight_grads || !layer->biases || !layer->bias_grads ||
-            !layer->deltas || !layer->sums || !layer->activs
-        ) {
-            fprintf(stderr, "Error: Memory allocation failed.\n");
-            fclose(file);
+        float *activs = (float *)realloc(ws->activs[l], size);
+        if (activs) ws->activs[l] = activs;
+
+        float *deltas = (float *)realloc(ws->deltas[l], size);
+        if (deltas) ws->deltas[l] = deltas;
+
+        if (!sums || !activs || !deltas) {
+            fprintf(stderr, "Error: Memory allocation failed for batch buffers.\n");
             return 1;
         }
     }
 
-    fclose(file);
+    ws->capacity = batch_size;
     return 0;
 }
 
 
-float rand_normal(float mean, float stddev) {
-    static int have_spare = 0;
-    static float spare;
-    if (have_spare) {
-        have_spare = 0;
-        return mean + stddev * spare;
-    }
+// The pool may exist without workers when only update_weights() created it
+void free_workers(SynNetwork *net) {
+    if (net->workers) {
+        for (int t = 0; t < thread_pool_size(net->pool); ++t) {
+            free_workspace(net, &net->workers[t].ws);
+            free(net->workers[t].grads);
+        }
 
-    have_spare = 1;
-    float u, v, s;
-    do {
-        u = (rand() / ((float)RAND_MAX)) * 2.0f - 1.0f;
-        v = (rand() / ((float)RAND_MAX)) * 2.0f - 1.0f;
-        s = u * u + v * v;
-    } while (s >= 1.0f || s == 0.0f);
+        free(net->workers);
+        net->workers = NULL;
+    }
 
-    s = sqrtf(-2.0f * logf(s) / s);
-    spare = v * s;
-    return mean + stddev * (u * s);
+    thread_pool_destroy(net->pool);
+    net->pool = NULL;
 }
 
 
-void init_weights(float *weights, int input_size, int output_size,
-    int (*activ_func)(const float *restrict, float *restrict, int)
-) {
-    float gain = 1.0f;
+int setup_workers(SynNetwork *net, int num_threads) {
+    if (net->pool && thread_pool_size(net->pool) == num_threads) {
+        if (net->workers) return 0;
+    } else {
+        free_workers(net);
+        net->pool = thread_pool_create(num_threads);
+    }
 
-    if (activ_func == relu) {
-        gain = sqrtf(2.0f);
-    } else if (activ_func == linear || activ_func == sigmoid || activ_func == softmax) {
-        gain = 1.0f;
-    } 
-    
-    float stddev = gain / sqrtf(input_size);
+    net->workers = (Worker *)calloc(num_threads, sizeof(Worker));
+    if (!net->pool || !net->workers) {
+        fprintf(stderr, "Error: Failed to set up training workers.\n");
+        free(net->workers);
+        net->workers = NULL;
+        thread_pool_destroy(net->pool);
+        net->pool = NULL;
+        return 1;
+    }
 
-    int size = input_size * output_size;
-    for (int i = 0; i < size; ++i) {
-        weights[i] = rand_normal(0.0f, stddev);
+    for (int t = 0; t < num_threads; ++t) {
+        net->workers[t].grads = (float *)aligned_alloc(ARENA_ALIGN, net->num_params * sizeof(float));
+        if (!net->workers[t].grads) {
+            fprintf(stderr, "Error: Memory allocation failed for worker gradients.\n");
+            free_workers(net);
+            return 1;
+        }
     }
+
+    return 0;
 }
 
 
-int init_layer(int input_size, int output_size, int (*activ_func)(const float *restrict, float *restrict, int)) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
-        return 1;
+// (Re)allocates the arena for the current layer sizes with room for
+// num_moments optimizer state vectors. Parameters and gradients are kept,
+// optimizer moments start from zero.
+int reserve_arena(SynNetwork *net, int num_moments) {
+    size_t num_params = 0;
+    size_t num_units = 0;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *layer = &net->layers[l];
+        layer->offset = num_params;
+        num_params += ALIGN_FLOATS((size_t)layer->input_size * layer->output_size) + ALIGN_FLOATS(layer->output_size);
+        num_units += ALIGN_FLOATS(layer->output_size);
     }
 
-    if (_lidx >= _num_layers) {
-        fprintf(stderr, "Error: Neural network already initialized.\n");
+    size_t size = (num_params * (2 + num_moments) + 3 * num_units) * sizeof(float);
+    float *arena = (float *)aligned_alloc(ARENA_ALIGN, size);
+    if (!arena) {
+        fprintf(stderr, "Error: Memory allocation failed for the network arena.\n");
         return 1;
     }
 
-    if (input_size <= 0 || output_size <= 0 || !activ_func) {
-        fprintf(stderr, "Error: Invalid input parameters for layer %d.\n", _lidx + 1);
-        return 1;
+    memset(arena, 0, size);
+
+    float *params = arena;
+    float *moments = params + num_params;
+    float *grads = moments + num_params * num_moments;
+    float *units = grads + num_params;
+
+    if (net->arena) {
+        memcpy(params, net->params, num_params * sizeof(float));
+        memcpy(grads, net->grads, num_params * sizeof(float));
+        free(net->arena);
     }
 
-    Layer *layer = &_nn[_lidx++];
+    net->arena = arena;
+    net->num_params = num_params;
+    net->params = params;
+    net->moments = moments;
+    net->num_moments = num_moments;
+    net->grads = grads;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *layer = &net->layers[l];
+        size_t bias_offset = layer->offset + ALIGN_FLOATS((size_t)layer->input_size * layer->output_size);
+        size_t num_units_aligned = ALIGN_FLOATS(layer->output_size);
+
+        layer->weights = &params[layer->offset];
+        layer->biases = &params[bias_offset];
+        layer->weight_grads = &grads[layer->offset];
+        layer->bias_grads = &grads[bias_offset];
+
+        layer->sums = units;
+        layer->activs = units + num_units;
+        layer->deltas = units + 2 * num_units;
+        units += num_units_aligned;
+    }
 
-    layer->weights = (float *)malloc(input_size * output_size * sizeof(float));
-    layer->weight_grads = (float *)calloc(input_size * output_size, sizeof(float));
-    layer->biases = (float *)calloc(output_size, sizeof(float));
-    layer->bias_grads = (float *)calloc(output_size, sizeof(float));
-    layer->deltas = (float *)malloc(output_size * sizeof(float));
-    layer->sums = (float *)calloc(output_size, sizeof(float));
-    layer->activs = (float *)calloc(output_size, sizeof(float));
+    // The unit buffers moved, and with them the saved output head
+    net->head_valid = 0;
+    return 0;
+}
 
-    if (!layer->weights || !layer->weight_grads || !layer->biases || !layer->bias_grads ||
-        !layer->deltas || !layer->sums || !layer->activs
-    ) {
-        fprintf(stderr, "Error: Memory allocation failed.\n");
+
+// Arena of an inference-only network: the parameters, unless with_params
+// is 0, and one ping-pong pair of unit buffers sized to the widest layer.
+// As in a SynInferCtx, every layer puts its sums in the first and its
+// activations in the second, overwriting the inputs once the matrix
+// product has read them.
+int reserve_inference_arena(SynNetwork *net, int with_params) {
+    size_t num_params = 0;
+    int max_width = 0;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *layer = &net->layers[l];
+        layer->offset = num_params;
+        num_params += ALIGN_FLOATS((size_t)layer->input_size * layer->output_size) + ALIGN_FLOATS(layer->output_size);
+
+        if (layer->output_size > max_width) max_width = layer->output_size;
+    }
+
+    if (!with_params) num_params = 0;
+
+    size_t size = (num_params + 2 * ALIGN_FLOATS(max_width)) * sizeof(float);
+    float *arena = (float *)aligned_alloc(ARENA_ALIGN, size);
+    if (!arena) {
+        fprintf(stderr, "Error: Memory allocation failed for the network arena.\n");
         return 1;
     }
 
-    layer->input_size = input_size;
-    layer->output_size = output_size;
-    layer->activ_func = activ_func;
+    memset(arena, 0, size);
 
-    init_weights(layer->weights, input_size, output_size, activ_func);
-    
-    _num_weights += input_size * output_size;
-    _num_biases += output_size;
+    net->arena = arena;
+    net->num_params = num_params;
+    net->params = arena;
+    net->max_width = max_width;
+
+    float *sums = arena + num_params;
+    float *activs = sums + ALIGN_FLOATS(max_width);
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *layer = &net->layers[l];
+
+        if (with_params) {
+            layer->weights = &arena[layer->offset];
+            layer->biases = layer->weights + ALIGN_FLOATS((size_t)layer->input_size * layer->output_size);
+        }
+        layer->sums = sums;
+        layer->activs = activs;
+    }
 
     return 0;
 }
 
 
-int setup_loss_function(float (*loss_func)(const float *restrict, const float *restrict, int)) {
-    if (!loss_func) {
-        fprintf(stderr, "Error: Invalid input parameters for setting up the loss function.\n");
+int check_trainable(const SynNetwork *net) {
+    if (net->inference) {
+        fprintf(stderr, "Error: Neural network loaded for inference only.\n");
         return 1;
     }
 
-    _loss_func = loss_func;
-
     return 0;
 }
 
 
-int setup_optimizer(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
-    float learning_rate
-) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
+int network_init(SynNetwork *net, int num_layers) {
+    if (net->layers) {
+        fprintf(stderr, "Error: Neural network already created.\n");
         return 1;
     }
 
-    if (_num_layers != _lidx) {
-        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+    if (num_layers <= 0) {
+        fprintf(stderr, "Error: Invalid number of layers specified for the neural network.\n");
         return 1;
     }
 
-    if (!optimizer || learning_rate <= 0.0f || learning_rate > 0.1f) {
-        fprintf(stderr, "Error: Invalid input parameters for setting up the optimizer.\n");
+    net->layers = (Layer *)calloc((net->num_layers = num_layers), sizeof(Layer));
+    if (!net->layers) {
+        fprintf(stderr, "Error: Memory allocation failed for neural network layers.\n");
         return 1;
     }
 
-    _optimizer = optimizer;
-    _learning_rate = learning_rate;
-
-    _cache = init_optimizer_cache(optimizer, _num_weights, _num_biases);
+    // Seeded from rand() so srand() still makes weight initialization reproducible
+    net->rng = ((unsigned int)rand() << 1) | 1u;
 
     return 0;
 }
 
 
-float* forward(const float *inputs) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
-        return NULL;
-    }
-
-    if (_num_layers != _lidx) {
-        fprintf(stderr, "Error: Neural network not properly initialized.\n");
-        return NULL;
-    }
+void network_clear(SynNetwork *net) {
+    if (!net->layers) return;
 
-    if (!inputs) {
-        fprintf(stderr, "Error: Invalid input parameters for the forward pass.\n");
-        return NULL;
-    }
+    free_optimizer_cache(&net->cache);
+    free_workers(net);
+    free_workspace(net, &net->ws);
+    net->batch_size = 0;
 
-    for (int l = 0; l < _num_layers; ++l) {
-        Layer *prev_layer = (l >= 1) ? &_nn[l - 1] : NULL;
-        Layer *layer = &_nn[l];
-        
-        int input_size = layer->input_size;
-        int output_size = layer->output_size;
-        
-        float *sums = layer->sums;
-        memset(sums, 0, output_size * sizeof(float));
-        
-        for (int i = 0; i < output_size; ++i) {
-            for (int j = 0; j < input_size; ++j) {
-                float x = (l >= 1) ? prev_layer->activs[j] : inputs[j];
-                sums[i] += x * layer->weights[i * input_size + j];
-            }
-            sums[i] += layer->biases[i];
-        }
-        
-        layer->activ_func(sums, layer->activs, output_size);
-    }
+    free(net->arena);
+    free(net->layers);
+    syn_delete_model(net->mapped);
 
-    return _nn[_num_layers - 1].activs;
+    *net = (SynNetwork){ .beta1 = DEFAULT_BETA1, .beta2 = DEFAULT_BETA2 };
 }
 
 
-float compute_loss(const float *y_true) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
-        return NAN;
+SynNetwork* syn_create_network(int num_layers) {
+    SynNetwork *net = (SynNetwork *)malloc(sizeof(SynNetwork));
+    if (!net) {
+        fprintf(stderr, "Error: Memory allocation failed for neural network.\n");
+        return NULL;
     }
 
-    if (_num_layers != _lidx) {
-        fprintf(stderr, "Error: Neural network not properly initialized.\n");
-        return NAN;
-    }
-    
-    if (!_loss_func) {
-        fprintf(stderr, "Error: Loss function not initialized.\n");
-        return NAN;
-    }
+    *net = (SynNetwork){ .beta1 = DEFAULT_BETA1, .beta2 = DEFAULT_BETA2 };
 
-    if (!y_true) {
-        fprintf(stderr, "Error: Invalid input parameters for computing the loss function.\n");
-        return NAN;
+    if (network_init(net, num_layers)) {
+        free(net);
+        return NULL;
     }
 
-    return _loss_func(y_true, _nn[_num_layers - 1].activs, _nn[_num_layers - 1].output_size);
+    return net;
 }
 
 
-int compute_output_grads(Layer *layer, const float *restrict prev_activs, const float *restrict y_true) {
-    const int input_size = layer->input_size;
-    const int output_size = layer->output_size;
+void syn_delete_network(SynNetwork *net) {
+    if (!net) return;
 
-    float *deltas = layer->deltas;
-    float *weight_grads = layer->weight_grads;
-    float *bias_grads = layer->bias_grads;
+    network_clear(net);
+    free(net);
+}
 
-    const float *sums = layer->sums;
-    const float *activs = layer->activs;
 
-    if ((_loss_func == categorical_cross_entropy && layer->activ_func == softmax) || 
-        (_loss_func == binary_cross_entropy && layer->activ_func == sigmoid)
-    ) {
-        for (int i = 0; i < output_size; ++i) {
-            deltas[i] = activs[i] - y_true[i];
-        }
-    } else if (_loss_func == mean_squared_error && layer->activ_func != softmax) {
-        for (int i = 0; i < output_size; ++i) {
-            deltas[i] = (activs[i] - y_true[i]) * grad_activ_func(layer->activ_func, sums[i]);
-        }
-    } else {
-        fprintf(stderr, "Error: Failed to compute deltas in the output layer.\n");
-        return 1;
-    }
-    
-    for (int i = 0; i < output_size; ++i) {
-        float delta = deltas[i];
-        for (int j = 0; j < input_size; ++j) {
-            weight_grads[i * input_size + j] += delta * prev_activs[j];
-        }
-        bias_grads[i] += delta;
-    }
+void syn_info_network(const SynNetwork *net) {
+    if (!net || !net->layers || net->num_layers != net->lidx) return;
 
-    return 0;
-}
+    for (int l = 0; l < ((net->num_layers <= 10) ? net->num_layers : 10); ++l) {
+        Layer *layer = &net->layers[l];
+        const char *activ_func_name = get_activ_func_name(layer->activ_func);
+
+        printf("Layer: %d Input size: %d Output size: %d\n\n", l + 1, layer->input_size, layer->output_size);
+
+        for (int i = 0; i < ((layer->output_size <= 10) ? layer->output_size : 10); ++i) {
+            printf("  Neuron %d:\n", i + 1);
+            
+            int limit = (layer->input_size < 10) ? layer->input_size : 10;
+
+            printf("             Weights:  [");
+            for (int j = 0; j < limit; ++j) {
+                printf(" %f", layer->weights[i * layer->input_size + j]);
+            }
+            if (layer->input_size > 10) printf(" ...");
+            printf(" ]\n");
+
+            printf("                Bias:  %f\n", layer->biases[i]);
+
+            if (!net->inference) {
+                printf("    Weight gradients:  [");            
+                for (int j = 0; j < limit; ++j) {
+                    printf(" %f", layer->weight_grads[i * layer->input_size + j]);
+                }
+                if (layer->input_size > 10) printf(" ...");
+                printf(" ]\n");
+
+                printf("       Bias gradient:  %f\n", layer->bias_grads[i]);
+            }
+
+            printf("                 Sum:  %f\n", layer->sums[i]);
+            printf("          Activation:  %f\n\n", layer->activs[i]);
+        }
+
+        if (layer->output_size > 10) printf("  ...\n\n");
+
+        printf("  Activation function: %s\n", activ_func_name);
+        printf("  Number of weights:   %d\n", layer->input_size * layer->output_size);
+        printf("  Number of biases:    %d\n\n", layer->output_size);
+    }
+}
+
+
+int syn_save_network(const SynNetwork *net, const char *filename) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return 1;
+    }
+
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return 1;
+    }
+
+    ModelLayer *layers = (ModelLayer *)malloc(net->num_layers * sizeof(ModelLayer));
+    if (!layers) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return 1;
+    }
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        const Layer *layer = &net->layers[l];
+        layers[l] = (ModelLayer){
+            .input_size = layer->input_size,
+            .output_size = layer->output_size,
+            .weights = layer->weights,
+            .biases = layer->biases,
+            .activ_func = layer->activ_func,
+            .activ_op = layer->activ_op,
+        };
+    }
+
+    int status = write_model_file(filename, layers, net->num_layers);
+    free(layers);
+
+    return status;
+}
+
+
+// Checkpoint layout: magic, version, layer count, (input, output) per layer,
+// moment count, optimizer step, parameter count, then the parameter and
+// moment regions of the arena as written by one fwrite().
+int syn_save_checkpoint(const SynNetwork *net, const char *filename) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return 1;
+    }
+
+    if (check_trainable(net)) {
+        return 1;
+    }
+
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return 1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open file %s for writing.\n", filename);
+        return 1;
+    }
+
+    int header[2] = { CHECKPOINT_VERSION, net->num_layers };
+    int step = net->cache ? net->cache->t : 0;
+    unsigned long long num_params = net->num_params;
+    size_t count = net->num_params * (1 + net->num_moments);
+
+    int ok = fwrite(CHECKPOINT_MAGIC, 1, 4, file) == 4 && fwrite(header, sizeof(int), 2, file) == 2;
+
+    for (int l = 0; ok && l < net->num_layers; ++l) {
+        int sizes[2] = { net->layers[l].input_size, net->layers[l].output_size };
+        ok = fwrite(sizes, sizeof(int), 2, file) == 2;
+    }
+
+    ok = ok && fwrite(&net->num_moments, sizeof(int), 1, file) == 1 &&
+        fwrite(&step, sizeof(int), 1, file) == 1 &&
+        fwrite(&num_params, sizeof(num_params), 1, file) == 1 &&
+        fwrite(net->params, sizeof(float), count, file) == count;
+
+    if (fclose(file) != 0) ok = 0;
+
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write checkpoint to %s.\n", filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int syn_load_checkpoint(SynNetwork *net, const char *filename) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return 1;
+    }
+
+    if (check_trainable(net)) {
+        return 1;
+    }
+
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return 1;
+    }
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open file %s for reading.\n", filename);
+        return 1;
+    }
+
+    char magic[4];
+    int header[2];
+
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        fread(header, sizeof(int), 2, file) != 2 || header[0] != CHECKPOINT_VERSION
+    ) {
+        fprintf(stderr, "Error: %s is not a supported checkpoint.\n", filename);
+        fclose(file);
+        return 1;
+    }
+
+    int ok = header[1] == net->num_layers;
+
+    for (int l = 0; ok && l < net->num_layers; ++l) {
+        int sizes[2];
+        ok = fread(sizes, sizeof(int), 2, file) == 2 &&
+            sizes[0] == net->layers[l].input_size && sizes[1] == net->layers[l].output_size;
+    }
+
+    int num_moments = 0;
+    int step = 0;
+    unsigned long long num_params = 0;
+
+    ok = ok && fread(&num_moments, sizeof(int), 1, file) == 1 &&
+        fread(&step, sizeof(int), 1, file) == 1 &&
+        fread(&num_params, sizeof(num_params), 1, file) == 1 &&
+        num_moments == net->num_moments && num_params == net->num_params;
+
+    if (!ok) {
+        fprintf(stderr, "Error: Checkpoint %s does not match the network or optimizer.\n", filename);
+        fclose(file);
+        return 1;
+    }
+
+    size_t count = net->num_params * (1 + net->num_moments);
+    if (fread(net->params, sizeof(float), count, file) != count) {
+        fprintf(stderr, "Error: Failed to read checkpoint data from %s.\n", filename);
+        fclose(file);
+        return 1;
+    }
+
+    fclose(file);
+
+    if (net->cache) net->cache->t = step;
+
+    return 0;
+}
+
+
+SynModel* syn_export_model(const SynNetwork *net) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return NULL;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return NULL;
+    }
+
+    SynModel *model = model_alloc(net->num_layers);
+    if (!model) return NULL;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        const Layer *layer = &net->layers[l];
+        model->layers[l] = (ModelLayer){
+            .input_size = layer->input_size,
+            .output_size = layer->output_size,
+            .activ_func = layer->activ_func,
+            .activ_op = layer->activ_op,
+        };
+    }
+
+    if (model_alloc_params(model)) {
+        syn_delete_model(model);
+        return NULL;
+    }
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        const Layer *layer = &net->layers[l];
+        memcpy(model->layers[l].weights, layer->weights, (size_t)layer->input_size * layer->output_size * sizeof(float));
+        memcpy(model->layers[l].biases, layer->biases, layer->output_size * sizeof(float));
+    }
+
+    return model;
+}
+
+
+int network_load(SynNetwork *net, const char *filename, int inference) {
+    SynModel *model = syn_load_model(filename);
+    if (!model) return 1;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        if (model->layers[l].dtype != MODEL_F32) {
+            fprintf(stderr, "Error: Models with reduced-precision weights run only through syn_load_model().\n");
+            syn_delete_model(model);
+            return 1;
+        }
+    }
+
+    if (network_init(net, model->num_layers)) {
+        syn_delete_model(model);
+        return 1;
+    }
+
+    net->lidx = model->num_layers;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *src = &model->layers[l];
+        Layer *layer = &net->layers[l];
+
+        layer->input_size = src->input_size;
+        layer->output_size = src->output_size;
+        layer->activ_func = src->activ_func;
+        layer->activ_op = src->activ_op;
+
+        net->num_weights += layer->input_size * layer->output_size;
+        net->num_biases += layer->output_size;
+    }
+
+    net->inference = inference;
+
+    // Inference reads the weights of a mapped file where they are
+    if (inference && model->map) {
+        if (reserve_inference_arena(net, 0)) {
+            syn_delete_model(model);
+            return 1;
+        }
+
+        for (int l = 0; l < model->num_layers; ++l) {
+            net->layers[l].weights = model->layers[l].weights;
+            net->layers[l].biases = model->layers[l].biases;
+        }
+
+        net->mapped = model;
+        return 0;
+    }
+
+    if (inference ? reserve_inference_arena(net, 1) : reserve_arena(net, 0)) {
+        syn_delete_model(model);
+        return 1;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *src = &model->layers[l];
+        Layer *layer = &net->layers[l];
+
+        memcpy(layer->weights, src->weights, (size_t)layer->input_size * layer->output_size * sizeof(float));
+        memcpy(layer->biases, src->biases, layer->output_size * sizeof(float));
+    }
+
+    syn_delete_model(model);
+    return 0;
+}
+
+
+SynNetwork* load_network(const char *filename, int inference) {
+    SynNetwork *net = (SynNetwork *)malloc(sizeof(SynNetwork));
+    if (!net) {
+        fprintf(stderr, "Error: Memory allocation failed for neural network.\n");
+        return NULL;
+    }
+
+    *net = (SynNetwork){ .beta1 = DEFAULT_BETA1, .beta2 = DEFAULT_BETA2 };
+
+    if (network_load(net, filename, inference)) {
+        syn_delete_network(net);
+        return NULL;
+    }
+
+    return net;
+}
+
+
+SynNetwork* syn_load_network(const char *filename) {
+    return load_network(filename, 0);
+}
+
+
+SynNetwork* syn_load_network_for_inference(const char *filename) {
+    return load_network(filename, 1);
+}
+
+
+// xorshift32 kept per network, uniform in [0, 1)
+float rand_uniform(SynNetwork *net) {
+    unsigned int x = net->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    net->rng = x;
+
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+
+float rand_normal(SynNetwork *net, float mean, float stddev) {
+    if (net->have_spare) {
+        net->have_spare = 0;
+        return mean + stddev * net->spare;
+    }
+
+    net->have_spare = 1;
+    float u, v, s;
+    do {
+        u = rand_uniform(net) * 2.0f - 1.0f;
+        v = rand_uniform(net) * 2.0f - 1.0f;
+        s = u * u + v * v;
+    } while (s >= 1.0f || s == 0.0f);
+
+    s = sqrtf(-2.0f * logf(s) / s);
+    net->spare = v * s;
+    return mean + stddev * (u * s);
+}
+
+
+void init_weights(SynNetwork *net, float *weights, int input_size, int output_size,
+    int (*activ_func)(const float *restrict, float *restrict, int)
+) {
+    float gain = 1.0f;
+
+    if (activ_func == relu) {
+        gain = sqrtf(2.0f);
+    } else if (activ_func == linear || activ_func == sigmoid || activ_func == softmax) {
+        gain = 1.0f;
+    } 
+    
+    float stddev = gain / sqrtf(input_size);
+
+    int size = input_size * output_size;
+    for (int i = 0; i < size; ++i) {
+        weights[i] = rand_normal(net, 0.0f, stddev);
+    }
+}
+
+
+int syn_init_layer(SynNetwork *net, int input_size, int output_size, int (*activ_func)(const float *restrict, float *restrict, int)) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->lidx >= net->num_layers) {
+        fprintf(stderr, "Error: Neural network already initialized.\n");
+        return 1;
+    }
+
+    // Only the library's activations have kernels and derivatives
+    if (input_size <= 0 || output_size <= 0 || get_activ_op(activ_func) < 0) {
+        fprintf(stderr, "Error: Invalid input parameters for layer %d.\n", net->lidx + 1);
+        return 1;
+    }
+
+    Layer *layer = &net->layers[net->lidx++];
+
+    layer->input_size = input_size;
+    layer->output_size = output_size;
+    layer->activ_func = activ_func;
+    layer->activ_op = get_activ_op(activ_func);
+
+    net->num_weights += input_size * output_size;
+    net->num_biases += output_size;
+
+    // Storage is laid out once every layer size is known
+    if (net->lidx < net->num_layers) return 0;
+
+    if (reserve_arena(net, 0)) return 1;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *cur = &net->layers[l];
+        init_weights(net, cur->weights, cur->input_size, cur->output_size, cur->activ_func);
+    }
+
+    return 0;
+}
+
+
+int syn_setup_loss_function(SynNetwork *net, float (*loss_func)(const float *restrict, const float *restrict, int)) {
+    if (!net) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (!loss_func) {
+        fprintf(stderr, "Error: Invalid input parameters for setting up the loss function.\n");
+        return 1;
+    }
+
+    net->loss_func = loss_func;
+
+    return 0;
+}
+
+
+int syn_setup_optimizer(SynNetwork *net, int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    float learning_rate
+) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return 1;
+    }
+
+    if (check_trainable(net)) {
+        return 1;
+    }
+
+    if (!optimizer || learning_rate <= 0.0f || learning_rate > 0.1f) {
+        fprintf(stderr, "Error: Invalid input parameters for setting up the optimizer.\n");
+        return 1;
+    }
+
+    net->optimizer = optimizer;
+    net->learning_rate = learning_rate;
+
+    free_optimizer_cache(&net->cache);
+
+    if (reserve_arena(net, optimizer_num_moments(optimizer))) return 1;
+    net->cache = init_optimizer_cache(optimizer, net->moments, (int)net->num_params);
+
+    if (net->cache) {
+        net->cache->beta1 = net->beta1;
+        net->cache->beta2 = net->beta2;
+    }
+
+    return 0;
+}
+
+
+void syn_set_beta1(SynNetwork *net, float new_beta1) {
+    if (!net) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return;
+    }
+
+    if (new_beta1 < 0.0f || new_beta1 >= 1.0f) {
+        fprintf(stderr, "Error: beta1 should be in the range [0, 1).\n");
+        return;
+    }
+
+    net->beta1 = new_beta1;
+    if (net->cache) net->cache->beta1 = new_beta1;
+}
+
+
+void syn_set_beta2(SynNetwork *net, float new_beta2) {
+    if (!net) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return;
+    }
+
+    if (new_beta2 < 0.0f || new_beta2 >= 1.0f) {
+        fprintf(stderr, "Error: beta2 should be in the range [0, 1).\n");
+        return;
+    }
+
+    net->beta2 = new_beta2;
+    if (net->cache) net->cache->beta2 = new_beta2;
+}
+
+
+int syn_setup_mixed_precision(SynNetwork *net, int enable, float loss_scale) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (check_trainable(net)) {
+        return 1;
+    }
+
+    if (loss_scale != 0.0f && !(loss_scale >= 1.0f && isfinite(loss_scale))) {
+        fprintf(stderr, "Error: Loss scale should be 0 or at least 1.\n");
+        return 1;
+    }
+
+    // Batch buffers change layout, so they are rebuilt on the next batch
+    free_workspace(net, &net->ws);
+    free_workers(net);
+    net->batch_size = 0;
+
+    net->mixed = enable ? 1 : 0;
+    net->loss_scale = enable ? loss_scale : 0.0f;
+    net->scale_steps = 0;
+
+    return 0;
+}
+
+
+float syn_loss_scale(const SynNetwork *net) {
+    return net ? net->loss_scale : 0.0f;
+}
+
+
+float* syn_forward(SynNetwork *net, const float *inputs) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return NULL;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return NULL;
+    }
+
+    if (!inputs) {
+        fprintf(stderr, "Error: Invalid input parameters for the forward pass.\n");
+        return NULL;
+    }
+
+    net->head_valid = 0;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *prev_layer = (l >= 1) ? &net->layers[l - 1] : NULL;
+        Layer *layer = &net->layers[l];
+        
+        int input_size = layer->input_size;
+        int output_size = layer->output_size;
+        
+        float *sums = layer->sums;
+        const float *x = (l >= 1) ? prev_layer->activs : inputs;
+
+        const unsigned long long start = profile_start();
+        kernel_sgemv(output_size, input_size, layer->weights, input_size, x, sums, 0);
+        kernel_bias_activ(layer->activ_op, 1, output_size, layer->biases, sums, 0, layer->activs, 0);
+        profile_layer(PROFILE_FORWARD, l, layer, NULL, 1, start);
+    }
+
+    return net->layers[net->num_layers - 1].activs;
+}
+
+
+// With logits set, a softmax output layer stops at its sums, which
+// softmax_xent_workspace() turns into the probabilities
+void forward_workspace(SynNetwork *net, Workspace *ws, const float *inputs, int batch_size, int logits) {
+    const int last = net->num_layers - 1;
+
+    for (int l = 0; l < net->num_layers; ++l) {
+        Layer *layer = &net->layers[l];
+
+        // Mixed precision: hidden activations are read back from bf16
+        const int half_in = l >= 1 && ws->half_activs;
+        const void *in = half_in ? (const void *)ws->half_activs[l - 1] : (l >= 1) ? ws->activs[l - 1] : inputs;
+
+        int input_size = layer->input_size;
+        int output_size = layer->output_size;
+
+        const int op = (logits && l == last) ? ACTIV_LINEAR : layer->activ_op;
+        float *out = (op == layer->activ_op) ? ws->activs[l] : ws->sums[l];
+
+        const unsigned long long start = profile_start();
+
+        // sums = in * weights^T + biases and activs = f(sums), with the bias
+        // and activation applied to each tile in the GEMM epilogue
+        kernel_gemm_bias_activ(0, 1, batch_size, output_size, input_size,
+            in, half_in, input_size, layer->weights, 0, input_size, ws->sums[l], output_size,
+            op, layer->biases, out, output_size);
+
+        if (ws->half_activs && l < last) {
+            kernel_round_bf16((long)batch_size * output_size, ws->activs[l], ws->half_activs[l]);
+        }
+
+        profile_layer(PROFILE_FORWARD, l, layer, NULL, batch_size, start);
+    }
+}
+
+
+float* syn_forward_batch(SynNetwork *net, const float *inputs, int batch_size) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return NULL;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return NULL;
+    }
+
+    if (!inputs || batch_size <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for the batched forward pass.\n");
+        return NULL;
+    }
+
+    if (reserve_workspace(net, &net->ws, batch_size)) {
+        return NULL;
+    }
+
+    forward_workspace(net, &net->ws, inputs, batch_size, 0);
+    net->batch_size = batch_size;
+
+    return net->ws.activs[net->num_layers - 1];
+}
+
+
+int check_network_ready(const SynNetwork *net) {
+    if (!net || !net->layers) {
+        fprintf(stderr, "Error: Neural network not created.\n");
+        return 1;
+    }
+
+    if (net->num_layers != net->lidx) {
+        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+        return 1;
+    }
+    
+    if (!net->loss_func) {
+        fprintf(stderr, "Error: Loss function not initialized.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+// Class-index labels only pair with a softmax output under categorical
+// cross-entropy, as does the fused output head of softmax_xent_workspace()
+int sparse_labels_supported(const SynNetwork *net, const Layer *layer) {
+    return net->loss_func == categorical_cross_entropy && layer->activ_op == ACTIV_SOFTMAX;
+}
+
+
+// Single-sample softmax/cross-entropy head on the logits saved by forward():
+// one log-sum-exp pass gives the probabilities, the output deltas and the
+// loss together, and is skipped when compute_loss() and backward() already
+// ran it for the same labels.
+int output_head_single(SynNetwork *net, const float *restrict y_true, const int32_t *restrict y_class) {
+    Layer *layer = &net->layers[net->num_layers - 1];
+    const float scale = (net->loss_scale > 0.0f) ? net->loss_scale : 1.0f;
+
+    if (net->head_valid && net->head_labels == y_true && net->head_scale == scale &&
+        (!y_class || net->head_class == *y_class)
+    ) {
+        return 0;
+    }
+
+    if (y_class && (*y_class < 0 || *y_class >= layer->output_size)) {
+        fprintf(stderr, "Error: Class index %d out of range.\n", (int)*y_class);
+        return 1;
+    }
+
+    net->head_loss = kernel_softmax_xent(1, layer->output_size, layer->sums, y_class ? NULL : y_true, y_class, scale,
+        layer->activs, layer->deltas);
+
+    net->head_valid = 1;
+    net->head_labels = y_true;
+    net->head_class = y_class ? *y_class : -1;
+    net->head_scale = scale;
+    return 0;
+}
+
+
+// Loss of the fused head. Inference-only networks have no deltas, so they
+// take sum(y * (lse - sums)) from the logits alone.
+float output_head_loss(SynNetwork *net, const float *restrict y_true, const int32_t *restrict y_class) {
+    const Layer *layer = &net->layers[net->num_layers - 1];
+
+    if (!net->inference) {
+        return output_head_single(net, y_true, y_class) ? NAN : net->head_loss;
+    }
+
+    if (y_class && (*y_class < 0 || *y_class >= layer->output_size)) {
+        fprintf(stderr, "Error: Class index %d out of range.\n", (int)*y_class);
+        return NAN;
+    }
+
+    const float lse = kernel_logsumexp(layer->output_size, layer->sums);
+    if (y_class) {
+        return lse - layer->sums[*y_class];
+    }
+
+    float loss = 0.0f;
+    for (int i = 0; i < layer->output_size; ++i) {
+        if (y_true[i] != 0.0f) {
+            loss += y_true[i] * (lse - layer->sums[i]);
+        }
+    }
+
+    return loss;
+}
+
+
+float syn_compute_loss(SynNetwork *net, const float *y_true) {
+    if (check_network_ready(net)) {
+        return NAN;
+    }
+
+    if (!y_true) {
+        fprintf(stderr, "Error: Invalid input parameters for computing the loss function.\n");
+        return NAN;
+    }
+
+    const Layer *layer = &net->layers[net->num_layers - 1];
+    if (!sparse_labels_supported(net, layer)) {
+        return net->loss_func(y_true, layer->activs, layer->output_size);
+    }
+
+    return output_head_loss(net, y_true, NULL);
+}
+
+
+float syn_compute_loss_sparse(SynNetwork *net, int32_t y_true) {
+    if (check_network_ready(net)) {
+        return NAN;
+    }
+
+    const Layer *layer = &net->layers[net->num_layers - 1];
+    if (!sparse_labels_supported(net, layer)) {
+        fprintf(stderr, "Error: Class-index labels require softmax outputs with categorical cross-entropy.\n");
+        return NAN;
+    }
+
+    return output_head_loss(net, NULL, &y_true);
+}
+
+
+int output_deltas_supported(const SynNetwork *net, const Layer *layer) {
+    return (net->loss_func == categorical_cross_entropy && layer->activ_op == ACTIV_SOFTMAX) ||
+        (net->loss_func == binary_cross_entropy && layer->activ_op == ACTIV_SIGMOID) ||
+        (net->loss_func == mean_squared_error && layer->activ_op != ACTIV_SOFTMAX);
+}
+
+
+// Output deltas of a (batch_size x output_size) block against the y_true
+// rows. Softmax with categorical cross-entropy goes through the fused head of
+// output_head_single() or softmax_xent_workspace() instead.
+int compute_output_deltas_batch(const SynNetwork *net, const Layer *layer, const float *restrict activs,
+    const float *restrict y_true, float *restrict deltas, int batch_size
+) {
+    const size_t size = (size_t)batch_size * layer->output_size;
+
+    if (net->loss_func == binary_cross_entropy && layer->activ_op == ACTIV_SIGMOID) {
+        for (size_t i = 0; i < size; ++i) {
+            deltas[i] = activs[i] - y_true[i];
+        }
+    } else if (net->loss_func == mean_squared_error && layer->activ_op != ACTIV_SOFTMAX) {
+        for (size_t i = 0; i < size; ++i) {
+            deltas[i] = activs[i] - y_true[i];
+        }
+        kernel_activ_grad(layer->activ_op, (long)size, activs, deltas);
+    } else {
+        fprintf(stderr, "Error: Failed to compute deltas in the output layer.\n");
+        return 1;
+    }
+
+    if (net->loss_scale > 0.0f) {
+        for (size_t i = 0; i < size; ++i) {
+            deltas[i] *= net->loss_scale;
+        }
+    }
+
+    return 0;
+}
+
+
+// Output layer of softmax with categorical cross-entropy on the logits left
+// in ws->sums by forward_workspace(). One log-sum-exp per row gives the
+// probabilities, the deltas and the loss together, which replaces the
+// softmax, loss and delta passes over the outputs and needs no EPSILON
+// clamp. The summed loss is stored in loss.
+int softmax_xent_workspace(const SynNetwork *net, Workspace *ws, const float *restrict y_true,
+    const int32_t *restrict y_class, int batch_size, float *loss
+) {
+    const int last = net->num_layers - 1;
+    const int output_size = net->layers[last].output_size;
+
+    if (y_class) {
+        for (int b = 0; b < batch_size; ++b) {
+            if (y_class[b] < 0 || y_class[b] >= output_size) {
+                fprintf(stderr, "Error: Class index %d out of range.\n", (int)y_class[b]);
+                return 1;
+            }
+        }
+    }
+
+    const float scale = (net->loss_scale > 0.0f) ? net->loss_scale : 1.0f;
+    *loss = kernel_softmax_xent(batch_size, output_size, ws->sums[last], y_class ? NULL : y_true, y_class, scale,
+        ws->activs[last], ws->deltas[last]);
+
+    return 0;
+}
+
+
+int compute_output_grads(SynNetwork *net, Layer *layer, const float *restrict prev_activs,
+    const float *restrict y_true, const int32_t *restrict y_class
+) {
+    const int input_size = layer->input_size;
+    const int output_size = layer->output_size;
+
+    float *deltas = layer->deltas;
+    float *weight_grads = layer->weight_grads;
+    float *bias_grads = layer->bias_grads;
+
+    if (y_class && !sparse_labels_supported(net, layer)) {
+        fprintf(stderr, "Error: Class-index labels require softmax outputs with categorical cross-entropy.\n");
+        return 1;
+    }
+
+    if (sparse_labels_supported(net, layer) ? output_head_single(net, y_true, y_class) :
+        compute_output_deltas_batch(net, layer, layer->activs, y_true, deltas, 1)
+    ) {
+        return 1;
+    }
+
+    kernel_sger(output_size, input_size, 1.0f, deltas, prev_activs, weight_grads, input_size);
+    for (int i = 0; i < output_size; ++i) {
+        bias_grads[i] += deltas[i];
+    }
+
+    return 0;
+}
+
+
+int compute_inner_grads(Layer *restrict layer, Layer *restrict next_layer, const float *prev_activs) {
+    if (layer->activ_op == ACTIV_SOFTMAX) {
+        fprintf(stderr, "Error: Failed to compute gradients in the hidden layers.\n");
+        return 1;
+    }
+
+    const int input_size = layer->input_size;
+    const int output_size = layer->output_size;
+    
+    float *deltas = layer->deltas;
+    float *weight_grads = layer->weight_grads;
+    float *bias_grads = layer->bias_grads;
+
+    const float *next_deltas = next_layer->deltas;
+    const float *next_weights = next_layer->weights;
+    
+    kernel_sgemv_t(next_layer->output_size, output_size, next_weights, next_layer->input_size, next_deltas, deltas, 0);
+    kernel_activ_grad(layer->activ_op, output_size, layer->activs, deltas);
+    
+    kernel_sger(output_size, input_size, 1.0f, deltas, prev_activs, weight_grads, input_size);
+    for (int i = 0; i < output_size; ++i) {
+        bias_grads[i] += deltas[i];
+    }
+
+    return 0;
+}
+
+
+int backward_single(SynNetwork *net, const float *restrict inputs, const float *restrict y_true, const int32_t *restrict y_class) {
+    if (check_network_ready(net) || check_trainable(net)) {
+        return 1;
+    }
+
+    if (!inputs || (!y_true && !y_class)) {
+        fprintf(stderr, "Error: Invalid input parameters for the backward pass.\n");
+        return 1;
+    }
+    
+    const int last = net->num_layers - 1;
+    unsigned long long start = profile_start();
+
+    if (compute_output_grads(net, &net->layers[last], ((net->num_layers > 1) ? net->layers[last - 1].activs : inputs), y_true, y_class)) {
+        return 1;
+    }
+    profile_layer(PROFILE_BACKWARD, last, &net->layers[last], NULL, 1, start);
+
+    for (int l = net->num_layers - 2; l >= 0; --l) {
+        start = profile_start();
+        if (compute_inner_grads(&net->layers[l], &net->layers[l + 1], ((l > 0) ? net->layers[l - 1].activs : inputs))) {
+            return 1;
+        }
+        profile_layer(PROFILE_BACKWARD, l, &net->layers[l], &net->layers[l + 1], 1, start);
+    }
+
+    return 0;
+}
+
+
+int syn_backward(SynNetwork *net, const float *restrict inputs, const float *restrict y_true) {
+    return backward_single(net, inputs, y_true, NULL);
+}
+
+
+int syn_backward_sparse(SynNetwork *net, const float *restrict inputs, int32_t y_true) {
+    return backward_single(net, inputs, NULL, &y_true);
+}
+
+
+// weight_grads += deltas^T * prev_activs and bias_grads += column sums of deltas,
+// where deltas is (batch_size x output_size) and prev_activs is (batch_size x input_size),
+// in bf16 when prev_half is set.
+void accumulate_grads_batch(const Layer *layer, const float *restrict deltas, const void *restrict prev_activs,
+    int prev_half, float *restrict weight_grads, float *restrict bias_grads, int batch_size
+) {
+    const int input_size = layer->input_size;
+    const int output_size = layer->output_size;
+
+    kernel_gemm_mixed(1, 0, output_size, input_size, batch_size,
+        deltas, 0, output_size, prev_activs, prev_half, input_size, weight_grads, input_size, 1);
+
+    for (int b = 0; b < batch_size; ++b) {
+        const float *row = &deltas[(size_t)b * output_size];
+        for (int i = 0; i < output_size; ++i) {
+            bias_grads[i] += row[i];
+        }
+    }
+}
 
 
-int compute_inner_grads(Layer *restrict layer, Layer *restrict next_layer, const float *prev_activs) {
-    if (layer->activ_func == softmax) {
+// deltas = (next_deltas * next_weights) .* activ'(sums), the derivative taken from activs
+int propagate_deltas_batch(const Layer *restrict layer, const Layer *restrict next_layer, const float *restrict activs,
+    const float *restrict next_deltas, float *restrict deltas, int batch_size
+) {
+    if (layer->activ_op == ACTIV_SOFTMAX) {
         fprintf(stderr, "Error: Failed to compute gradients in the hidden layers.\n");
         return 1;
     }
 
-    const int input_size = layer->input_size;
     const int output_size = layer->output_size;
-    
-    float *deltas = layer->deltas;
-    float *weight_grads = layer->weight_grads;
-    float *bias_grads = layer->bias_grads;
+    const int next_output_size = next_layer->output_size;
 
-    const float *sums = layer->sums;
-    const float *next_deltas = next_layer->deltas;
-    const float *next_weights = next_layer->weights;
-    
-    for (int i = 0; i < output_size; ++i) {
-        float weighted_sum = 0.0f;
+    kernel_sgemm(0, 0, batch_size, output_size, next_output_size,
+        next_deltas, next_output_size, next_layer->weights, output_size, deltas, output_size, 0);
+
+    kernel_activ_grad(layer->activ_op, (long)batch_size * output_size, activs, deltas);
 
-        for (int j = 0; j < next_layer->output_size; ++j) {
-            weighted_sum += next_deltas[j] * next_weights[j * next_layer->input_size + i];
+    return 0;
+}
+
+
+// Accumulates the gradients of a batch already passed through forward_workspace(),
+// with its output deltas in ws->deltas, into grads, a buffer with the arena
+// parameter layout.
+int backward_workspace(SynNetwork *net, Workspace *ws, const float *restrict inputs, int batch_size, float *grads) {
+    const int last = net->num_layers - 1;
+
+    for (int l = last; l >= 0; --l) {
+        Layer *layer = &net->layers[l];
+        const unsigned long long start = profile_start();
+
+        // Mixed precision: the activs scratch is free again for the widened activations
+        if (l < last && ws->half_activs) {
+            kernel_widen_bf16((long)batch_size * layer->output_size, ws->half_activs[l], ws->activs[l]);
         }
 
-        deltas[i] = weighted_sum * grad_activ_func(layer->activ_func, sums[i]);
-    }
-    
-    for (int i = 0; i < output_size; ++i) {
-        float delta = deltas[i];
-        for (int j = 0; j < input_size; ++j) {
-            weight_grads[i * input_size + j] += delta * prev_activs[j];
+        if (l < last && propagate_deltas_batch(layer, &net->layers[l + 1], ws->activs[l], ws->deltas[l + 1], ws->deltas[l], batch_size)) {
+            return 1;
         }
-        bias_grads[i] += delta;
+
+        float *weight_grads = &grads[layer->offset];
+        float *bias_grads = weight_grads + ALIGN_FLOATS((size_t)layer->input_size * layer->output_size);
+
+        const int half_in = l > 0 && ws->half_activs;
+        const void *prev_activs = half_in ? (const void *)ws->half_activs[l - 1] : (l > 0) ? ws->activs[l - 1] : inputs;
+
+        accumulate_grads_batch(layer, ws->deltas[l], prev_activs, half_in, weight_grads, bias_grads, batch_size);
+        profile_layer(PROFILE_BACKWARD, l, layer, (l < last) ? &net->layers[l + 1] : NULL, batch_size, start);
     }
 
     return 0;
 }
 
 
-int backward(const float *restrict inputs, const float *restrict y_true) {
-    if (!_nn) {
-        fprintf(stderr, "Error: Neural network not created.\n");
+int backward_batch_labels(SynNetwork *net, const float *restrict inputs, const float *restrict y_true,
+    const int32_t *restrict y_class, int batch_size
+) {
+    if (check_network_ready(net) || check_trainable(net)) {
         return 1;
     }
 
-    if (_num_layers != _lidx) {
-        fprintf(stderr, "Error: Neural network not properly initialized.\n");
+    if (!inputs || (!y_true && !y_class) || batch_size <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for the batched backward pass.\n");
         return 1;
     }
 
-    if (!_loss_func) {
-        fprintf(stderr, "Error: Loss function not initialized.\n");
+    if (batch_size != net->batch_size) {
+        fprintf(stderr, "Error: Batched backward pass does not match the last batched forward pass.\n");
         return 1;
     }
 
-    if (!inputs || !y_true) {
-        fprintf(stderr, "Error: Invalid input parameters for the backward pass.\n");
+    Workspace *ws = &net->ws;
+    const int last = net->num_layers - 1;
+    const Layer *output_layer = &net->layers[last];
+
+    if (y_class && !sparse_labels_supported(net, output_layer)) {
+        fprintf(stderr, "Error: Class-index labels require softmax outputs with categorical cross-entropy.\n");
         return 1;
     }
-    
-    if (compute_output_grads(&_nn[_num_layers - 1], ((_num_layers > 1) ? _nn[_num_layers - 2].activs : inputs), y_true)) {
+
+    const unsigned long long start = profile_start();
+
+    // Softmax outputs kept their logits in ws->sums for the fused head
+    float loss;
+    if (sparse_labels_supported(net, output_layer) ?
+        softmax_xent_workspace(net, ws, y_true, y_class, batch_size, &loss) :
+        compute_output_deltas_batch(net, output_layer, ws->activs[last], y_true, ws->deltas[last], batch_size)
+    ) {
         return 1;
     }
+    profile_record(PROFILE_LOSS, last, start, 0.0, 12.0 * batch_size * net->layers[last].output_size);
 
-    for (int l = _num_layers - 2; l >= 0; --l) {
-        if (compute_inner_grads(&_nn[l], &_nn[l + 1], ((l > 0) ? _nn[l - 1].activs : inputs))) {
-            return 1;
+    return backward_workspace(net, ws, inputs, batch_size, net->grads);
+}
+
+
+int syn_backward_batch(SynNetwork *net, const float *restrict inputs, const float *restrict y_true, int batch_size) {
+    return backward_batch_labels(net, inputs, y_true, NULL, batch_size);
+}
+
+
+int syn_backward_batch_sparse(SynNetwork *net, const float *restrict inputs, const int32_t *restrict y_true, int batch_size) {
+    return backward_batch_labels(net, inputs, NULL, y_true, batch_size);
+}
+
+
+typedef struct {
+    SynNetwork *net;
+    const float *inputs;
+    const float *labels;
+    const int32_t *classes;     // replaces labels for class-index labels
+    int batch_size;
+    int num_active;
+} ParallelBatch;
+
+
+void train_worker_task(void *arg, int thread_id, int num_threads) {
+    ParallelBatch *job = (ParallelBatch *)arg;
+    SynNetwork *net = job->net;
+    Worker *worker = &net->workers[thread_id];
+
+    worker->loss = 0.0f;
+    worker->status = 0;
+
+    if (thread_id >= job->num_active) return;
+
+    long begin, end;
+    thread_pool_range(job->batch_size, thread_id, job->num_active, &begin, &end);
+    (void)num_threads;
+
+    const int input_size = net->layers[0].input_size;
+    const int output_size = net->layers[net->num_layers - 1].output_size;
+    const int count = (int)(end - begin);
+
+    const float *inputs = &job->inputs[begin * input_size];
+    const float *labels = job->labels ? &job->labels[begin * output_size] : NULL;
+    const int32_t *classes = job->classes ? &job->classes[begin] : NULL;
+
+    Workspace *ws = &worker->ws;
+    const Layer *output_layer = &net->layers[net->num_layers - 1];
+    const int fused = sparse_labels_supported(net, output_layer);
+
+    memset(worker->grads, 0, net->num_params * sizeof(float));
+    forward_workspace(net, ws, inputs, count, fused);
+
+    const unsigned long long start = profile_start();
+
+    if (fused) {
+        if (softmax_xent_workspace(net, ws, labels, classes, count, &worker->loss)) {
+            worker->status = 1;
+            return;
+        }
+    } else {
+        const float *activs = ws->activs[net->num_layers - 1];
+        for (int b = 0; b < count; ++b) {
+            worker->loss += net->loss_func(&labels[(size_t)b * output_size], &activs[(size_t)b * output_size], output_size);
         }
+
+        if (compute_output_deltas_batch(net, output_layer, activs, labels, ws->deltas[net->num_layers - 1], count)) {
+            worker->status = 1;
+            return;
+        }
+    }
+
+    profile_record(PROFILE_LOSS, net->num_layers - 1, start, 0.0, 12.0 * count * output_size);
+    worker->status = backward_workspace(net, ws, inputs, count, worker->grads);
+}
+
+
+// Each thread owns a slice of the parameters and sums the worker buffers
+// pairwise over it chunk by chunk, so a chunk stays in cache across all
+// levels of the tree before it is added to the network gradients.
+void reduce_worker_task(void *arg, int thread_id, int num_threads) {
+    const ParallelBatch *job = (const ParallelBatch *)arg;
+    SynNetwork *net = job->net;
+    const int num_active = job->num_active;
+
+    long begin, end;
+    thread_pool_range((long)net->num_params, thread_id, num_threads, &begin, &end);
+
+    for (long c0 = begin; c0 < end; c0 += REDUCE_CHUNK) {
+        long c1 = (c0 + REDUCE_CHUNK < end) ? c0 + REDUCE_CHUNK : end;
+
+        for (int stride = 1; stride < num_active; stride *= 2) {
+            for (int t = 0; t + stride < num_active; t += 2 * stride) {
+                float *restrict dst = net->workers[t].grads;
+                const float *restrict src = net->workers[t + stride].grads;
+
+                for (long i = c0; i < c1; ++i) {
+                    dst[i] += src[i];
+                }
+            }
+        }
+
+        float *restrict dst = net->grads;
+        const float *restrict src = net->workers[0].grads;
+
+        for (long i = c0; i < c1; ++i) {
+            dst[i] += src[i];
+        }
+    }
+}
+
+
+float train_parallel(SynNetwork *net, const float *inputs, const float *labels, const int32_t *classes,
+    int batch_size, int num_threads
+) {
+    if (check_network_ready(net) || check_trainable(net)) {
+        return NAN;
+    }
+
+    if (!inputs || (!labels && !classes) || batch_size <= 0 || num_threads <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for parallel training.\n");
+        return NAN;
+    }
+
+    const Layer *output_layer = &net->layers[net->num_layers - 1];
+    if (!(classes ? sparse_labels_supported(net, output_layer) : output_deltas_supported(net, output_layer))) {
+        fprintf(stderr, "Error: Failed to compute deltas in the output layer.\n");
+        return NAN;
+    }
+
+    if (setup_workers(net, num_threads)) {
+        return NAN;
+    }
+
+    ParallelBatch job = { net, inputs, labels, classes, batch_size, (batch_size < num_threads) ? batch_size : num_threads };
+    int chunk = (batch_size + job.num_active - 1) / job.num_active;
+
+    for (int t = 0; t < job.num_active; ++t) {
+        if (reserve_workspace(net, &net->workers[t].ws, chunk)) return NAN;
+    }
+
+    thread_pool_run(net->pool, train_worker_task, &job);
+
+    float loss = 0.0f;
+    for (int t = 0; t < job.num_active; ++t) {
+        if (net->workers[t].status) return NAN;
+        loss += net->workers[t].loss;
+    }
+
+    // Each parameter is summed once per worker buffer
+    const unsigned long long start = profile_start();
+    thread_pool_run(net->pool, reduce_worker_task, &job);
+    profile_record(PROFILE_BACKWARD, -1, start, (double)net->num_params * job.num_active,
+        12.0 * net->num_params * job.num_active);
+
+    return loss;
+}
+
+
+float syn_train_batch_parallel(SynNetwork *net, const float *inputs, const float *labels, int batch_size, int num_threads) {
+    return train_parallel(net, inputs, labels, NULL, batch_size, num_threads);
+}
+
+
+float syn_train_batch_parallel_sparse(SynNetwork *net, const float *inputs, const int32_t *labels, int batch_size, int num_threads) {
+    return train_parallel(net, inputs, NULL, labels, batch_size, num_threads);
+}
+
+
+// Parameters [begin, end) of the flat vector, both multiples of 16
+typedef struct {
+    SynNetwork *net;
+    const OptimStep *step;
+    long begin;
+    long end;
+} UpdateJob;
+
+
+// Threads update disjoint slices of whole cache lines
+void update_worker_task(void *arg, int thread_id, int num_threads) {
+    const UpdateJob *job = (const UpdateJob *)arg;
+    SynNetwork *net = job->net;
+
+    long begin, end;
+    thread_pool_range((job->end - job->begin) / 16, thread_id, num_threads, &begin, &end);
+
+    if (begin < end) {
+        optimizer_apply(job->step, net->cache, net->params, net->grads, job->begin + begin * 16, job->begin + end * 16);
+    }
+}
+
+
+void apply_update(SynNetwork *net, const OptimStep *step, long begin, long end) {
+    UpdateJob job = { net, step, begin, end };
+
+    if (net->pool) {
+        thread_pool_run(net->pool, update_worker_task, &job);
+    } else {
+        optimizer_apply(step, net->cache, net->params, net->grads, begin, end);
+    }
+}
+
+
+// Divides the gradients by the loss scale. On overflow the step is skipped
+// and the scale halved; it doubles after LOSS_SCALE_WINDOW clean steps.
+// Returns 1 when the step must be skipped.
+int unscale_grads(SynNetwork *net) {
+    const float inv_scale = 1.0f / net->loss_scale;
+    float *grads = net->grads;
+    int finite = 1;
+
+    for (size_t i = 0; i < net->num_params; ++i) {
+        finite &= isfinite(grads[i]) != 0;
+        grads[i] *= inv_scale;
+    }
+
+    if (!finite) {
+        net->loss_scale = fmaxf(net->loss_scale * 0.5f, 1.0f);
+        net->scale_steps = 0;
+        return 1;
+    }
+
+    if (++net->scale_steps >= LOSS_SCALE_WINDOW) {
+        net->loss_scale *= 2.0f;
+        net->scale_steps = 0;
     }
 
     return 0;
 }
 
 
-int update_weights(void) {
-    if (!_nn) {
+// Large steps run on the training thread pool, created here on first use
+int syn_update_weights(SynNetwork *net) {
+    if (!net || !net->layers) {
         fprintf(stderr, "Error: Neural network not created.\n");
         return 1;
     }
 
-    if (_num_layers != _lidx) {
+    if (net->num_layers != net->lidx) {
         fprintf(stderr, "Error: Neural network not properly initialized.\n");
         return 1;
     }
 
-    if (!_optimizer) {
+    if (!net->optimizer) {
         fprintf(stderr, "Error: Optimizer not initialized.\n");
         return 1;
     }
-    
-    if (_cache) {
-        _cache->w_start = 0;
-        _cache->b_start = 0;
+
+    if (!net->pool && net->num_params >= PARALLEL_UPDATE_MIN && thread_pool_default_size() > 1) {
+        net->pool = thread_pool_create(thread_pool_default_size());
     }
-    
-    for (int l = 0; l < _num_layers; ++l) {
-        Layer *layer = &_nn[l];
-        int num_weights = layer->input_size * layer->output_size;
-        int num_biases = layer->output_size;
 
-        _optimizer(layer->weights, layer->weight_grads, num_weights, _learning_rate, _cache, 1);
-        _optimizer(layer->biases, layer->bias_grads, num_biases, _learning_rate, _cache, 0);
+    const double num_params = (double)net->num_params;
+    unsigned long long start = profile_start();
 
-        if (_cache) {
-            _cache->w_start += num_weights;
-            _cache->b_start += num_biases;
-        }
+    if (net->loss_scale > 0.0f) {
+        int skip = unscale_grads(net);
+        profile_record(PROFILE_UPDATE, -1, start, num_params, 8.0 * num_params);
+        if (skip) return 0;
+    }
+
+    OptimStep step;
+
+    // Custom optimizers get the whole flat vector in one call
+    start = profile_start();
+    if (optimizer_begin_step(net->optimizer, net->cache, net->learning_rate, &step)) {
+        int status = net->optimizer(net->params, net->grads, (int)net->num_params, net->learning_rate, net->cache, 1);
+        profile_record(PROFILE_UPDATE, -1, start, 0.0, 12.0 * num_params);
+        return status;
+    }
+
+    // Padding between blocks has zero parameters and gradients, so it stays zero
+    if (!start) {
+        apply_update(net, &step, 0, (long)net->num_params);
+        return 0;
+    }
+
+    // Profiled steps go layer by layer
+    for (int l = 0; l < net->num_layers; ++l) {
+        const Layer *layer = &net->layers[l];
+        const long size = (long)(ALIGN_FLOATS((size_t)layer->input_size * layer->output_size) + ALIGN_FLOATS(layer->output_size));
+
+        start = profile_start();
+        apply_update(net, &step, (long)layer->offset, (long)layer->offset + size);
+        profile_record(PROFILE_UPDATE, l, start, (double)size * _optim_flops[step.rule], 4.0 * size * _optim_floats[step.rule]);
     }
 
     return 0;
 }
 
 
-int zero_grads(void) {
-    if (!_nn) {
+int syn_zero_grads(SynNetwork *net) {
+    if (!net || !net->layers) {
         fprintf(stderr, "Error: Neural network not created.\n");
         return 1;
     }
 
-    if (_num_layers != _lidx) {
+    if (net->num_layers != net->lidx) {
         fprintf(stderr, "Error: Neural network not properly initialized.\n");
         return 1;
     }
-    
-    for (int l = 0; l < _num_layers; ++l) {
-        Layer *layer = &_nn[l];
-        int num_weights = layer->input_size * layer->output_size;
-        memset(layer->weight_grads, 0, num_weights * sizeof(float));
-        memset(layer->bias_grads, 0, layer->output_size * sizeof(float));
+
+    if (check_trainable(net)) {
+        return 1;
     }
-    
+
+    memset(net->grads, 0, net->num_params * sizeof(float));
+
     return 0;
 }
+
+
+int create_neural_network(int num_layers) {
+    return network_init(&_default, num_layers);
+}
+
+
+void delete_neural_network(void) {
+    network_clear(&_default);
+}
+
+
+void info_neural_network(void) {
+    syn_info_network(&_default);
+}
+
+
+int save_neural_network(const char *filename) {
+    return syn_save_network(&_default, filename);
+}
+
+
+int load_neural_network(const char *filename) {
+    if (_default.layers) {
+        fprintf(stderr, "Error: Neural network already created.\n");
+        return 1;
+    }
+
+    return network_load(&_default, filename, 0);
+}
+
+
+int load_neural_network_for_inference(const char *filename) {
+    if (_default.layers) {
+        fprintf(stderr, "Error: Neural network already created.\n");
+        return 1;
+    }
+
+    return network_load(&_default, filename, 1);
+}
+
+
+int save_checkpoint(const char *filename) {
+    return syn_save_checkpoint(&_default, filename);
+}
+
+
+int load_checkpoint(const char *filename) {
+    return syn_load_checkpoint(&_default, filename);
+}
+
+
+int init_layer(int input_size, int output_size, int (*activ_func)(const float *restrict, float *restrict, int)) {
+    return syn_init_layer(&_default, input_size, output_size, activ_func);
+}
+
+
+int setup_loss_function(float (*loss_func)(const float *restrict, const float *restrict, int)) {
+    return syn_setup_loss_function(&_default, loss_func);
+}
+
+
+int setup_optimizer(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    float learning_rate
+) {
+    return syn_setup_optimizer(&_default, optimizer, learning_rate);
+}
+
+
+void set_beta1(float new_beta1) {
+    syn_set_beta1(&_default, new_beta1);
+}
+
+
+void set_beta2(float new_beta2) {
+    syn_set_beta2(&_default, new_beta2);
+}
+
+
+int setup_mixed_precision(int enable, float loss_scale) {
+    return syn_setup_mixed_precision(&_default, enable, loss_scale);
+}
+
+
+float* forward(const float *inputs) {
+    return syn_forward(&_default, inputs);
+}
+
+
+float* forward_batch(const float *inputs, int batch_size) {
+    return syn_forward_batch(&_default, inputs, batch_size);
+}
+
+
+float compute_loss(const float *y_true) {
+    return syn_compute_loss(&_default, y_true);
+}
+
+
+float compute_loss_sparse(int32_t y_true) {
+    return syn_compute_loss_sparse(&_default, y_true);
+}
+
+
+int backward(const float *restrict inputs, const float *restrict y_true) {
+    return syn_backward(&_default, inputs, y_true);
+}
+
+
+int backward_sparse(const float *restrict inputs, int32_t y_true) {
+    return syn_backward_sparse(&_default, inputs, y_true);
+}
+
+
+int backward_batch(const float *restrict inputs, const float *restrict y_true, int batch_size) {
+    return syn_backward_batch(&_default, inputs, y_true, batch_size);
+}
+
+
+int backward_batch_sparse(const float *restrict inputs, const int32_t *restrict y_true, int batch_size) {
+    return syn_backward_batch_sparse(&_default, inputs, y_true, batch_size);
+}
+
+
+float train_batch_parallel(const float *inputs, const float *labels, int batch_size, int num_threads) {
+    return syn_train_batch_parallel(&_default, inputs, labels, batch_size, num_threads);
+}
+
+
+float train_batch_parallel_sparse(const float *inputs, const int32_t *labels, int batch_size, int num_threads) {
+    return syn_train_batch_parallel_sparse(&_default, inputs, labels, batch_size, num_threads);
+}
+
+
+int update_weights(void) {
+    return syn_update_weights(&_default);
+}
+
+
+int zero_grads(void) {
+    return syn_zero_grads(&_default);
+}
@@ -0,0 +1,317 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv.h"
+#include "thread_pool.h"
+
+
+// Target amount of text per chunk; small enough to balance the threads
+#define CSV_CHUNK_BYTES (1L << 20)
+
+// Decimal digits kept in the mantissa; the rest only shift the exponent
+#define MAX_MANTISSA_DIGITS 19
+
+
+typedef struct {
+    const char *begin;
+    const char *end;
+    long num_rows;
+    long num_lines;
+    long first_row;
+    long first_line;
+    long error_line;
+    const char *error;
+} CsvChunk;
+
+
+typedef struct {
+    CsvChunk *chunks;
+    int num_chunks;
+    CsvMode mode;
+    void *out;
+    long num_rows;
+    long num_cols;
+} CsvJob;
+
+
+static const double _pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+
+static const char* skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+
+// Locale-independent decimal parser for [+-]digits[.digits][(e|E)[+-]digits].
+// The result is within one float ulp of strtof(). Returns the position after
+// the number or NULL if there is none.
+static const char* csv_parse_float(const char *p, const char *end, float *value) {
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    int any = 0;
+
+    for (; p < end && is_digit(*p); ++p, any = 1) {
+        if (digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += (mantissa != 0);
+        } else {
+            ++exponent;
+        }
+    }
+
+    if (p < end && *p == '.') {
+        for (++p; p < end && is_digit(*p); ++p, any = 1) {
+            if (digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += (mantissa != 0);
+                --exponent;
+            }
+        }
+    }
+
+    if (!any) return NULL;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int exp_negative = 0;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = (*q == '-');
+            ++q;
+        }
+
+        if (q < end && is_digit(*q)) {
+            int exp_value = 0;
+            for (; q < end && is_digit(*q); ++q) {
+                if (exp_value < 10000) exp_value = exp_value * 10 + (*q - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = q;
+        }
+    }
+
+    double result = (double)mantissa;
+
+    if (mantissa != 0) {
+        for (; exponent > 22; exponent -= 22) result *= 1e22;
+        for (; exponent < -22; exponent += 22) result /= 1e22;
+        result = (exponent >= 0) ? result * _pow10[exponent] : result / _pow10[-exponent];
+    }
+
+    *value = (float)(negative ? -result : result);
+    return p;
+}
+
+
+// Parses one non-empty line into row `row` of out; returns an error message or NULL
+static const char* parse_line(const char *p, const char *end, CsvMode mode, void *out, long row, long num_cols) {
+    if (mode != CSV_FLOATS) {
+        p = skip_blanks(p, end);
+
+        long label = 0;
+        const char *digits = p;
+        for (; p < end && is_digit(*p); ++p) {
+            if (label <= num_cols) label = label * 10 + (*p - '0');
+        }
+
+        if (p == digits || skip_blanks(p, end) != end) return "expected a class index";
+        if (label >= num_cols) return "class index out of range";
+
+        if (mode == CSV_CLASS_INDEX) {
+            ((int32_t *)out)[row] = (int32_t)label;
+        } else {
+            float *one_hot = &((float *)out)[row * num_cols];
+            memset(one_hot, 0, num_cols * sizeof(float));
+            one_hot[label] = 1.0f;
+        }
+        return NULL;
+    }
+
+    float *values = &((float *)out)[row * num_cols];
+    for (long j = 0; j < num_cols; ++j) {
+        p = csv_parse_float(skip_blanks(p, end), end, &values[j]);
+        if (!p) return "invalid number";
+
+        p = skip_blanks(p, end);
+        if (j + 1 < num_cols) {
+            if (p == end || *p != ',') return "too few fields";
+            ++p;
+        }
+    }
+
+    if (p != end) return "too many fields";
+    return NULL;
+}
+
+
+static int is_blank_line(const char *p, const char *end) {
+    return skip_blanks(p, end) == end;
+}
+
+
+static void count_task(void *arg, int thread_id, int num_threads) {
+    CsvJob *job = (CsvJob *)arg;
+
+    for (int c = thread_id; c < job->num_chunks; c += num_threads) {
+        CsvChunk *chunk = &job->chunks[c];
+
+        for (const char *p = chunk->begin; p < chunk->end; ) {
+            const char *nl = (const char *)memchr(p, '\n', chunk->end - p);
+            const char *line_end = nl ? nl : chunk->end;
+
+            chunk->num_lines += 1;
+            chunk->num_rows += !is_blank_line(p, line_end);
+            p = line_end + 1;
+        }
+    }
+}
+
+
+static void parse_task(void *arg, int thread_id, int num_threads) {
+    CsvJob *job = (CsvJob *)arg;
+
+    for (int c = thread_id; c < job->num_chunks; c += num_threads) {
+        CsvChunk *chunk = &job->chunks[c];
+        long row = chunk->first_row;
+        long line = chunk->first_line;
+
+        for (const char *p = chunk->begin; p < chunk->end && row < job->num_rows; ++line) {
+            const char *nl = (const char *)memchr(p, '\n', chunk->end - p);
+            const char *line_end = nl ? nl : chunk->end;
+
+            if (!is_blank_line(p, line_end)) {
+                const char *error = parse_line(p, line_end, job->mode, job->out, row, job->num_cols);
+                if (error) {
+                    chunk->error = error;
+                    chunk->error_line = line + 1;
+                    break;
+                }
+                ++row;
+            }
+
+            p = line_end + 1;
+        }
+    }
+}
+
+
+int csv_parse_file(const char *filename, CsvMode mode, void *out, long num_rows, long num_cols) {
+    if (!filename || !out || num_rows <= 0 || num_cols <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return 1;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: File '%s' is empty.\n", filename);
+        close(fd);
+        return 1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char *text = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (text == (const char *)MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map file '%s'.\n", filename);
+        return 1;
+    }
+
+    posix_madvise((void *)text, size, POSIX_MADV_SEQUENTIAL);
+
+    int num_chunks = (int)((size + CSV_CHUNK_BYTES - 1) / CSV_CHUNK_BYTES);
+    int num_threads = thread_pool_default_size();
+    if (num_threads > num_chunks) num_threads = num_chunks;
+
+    CsvJob job = { NULL, num_chunks, mode, out, num_rows, num_cols };
+    job.chunks = (CsvChunk *)calloc(num_chunks, sizeof(CsvChunk));
+    ThreadPool *pool = thread_pool_create(num_threads);
+
+    if (!job.chunks || !pool) {
+        fprintf(stderr, "Error: Memory allocation failed for the CSV parser.\n");
+        free(job.chunks);
+        thread_pool_destroy(pool);
+        munmap((void *)text, size);
+        return 1;
+    }
+
+    // Every chunk starts right after a newline
+    for (int c = 0; c < num_chunks; ++c) {
+        size_t raw = size * (size_t)c / num_chunks;
+        const char *begin = text + size;
+
+        if (raw == 0) {
+            begin = text;
+        } else {
+            const char *nl = (const char *)memchr(text + raw - 1, '\n', size - raw + 1);
+            if (nl) begin = nl + 1;
+        }
+
+        job.chunks[c].begin = begin;
+        if (c > 0) job.chunks[c - 1].end = begin;
+    }
+    job.chunks[num_chunks - 1].end = text + size;
+
+    thread_pool_run(pool, count_task, &job);
+
+    long total_rows = 0, total_lines = 0;
+    for (int c = 0; c < num_chunks; ++c) {
+        job.chunks[c].first_row = total_rows;
+        job.chunks[c].first_line = total_lines;
+        total_rows += job.chunks[c].num_rows;
+        total_lines += job.chunks[c].num_lines;
+    }
+
+    int status = 0;
+
+    if (total_rows < num_rows) {
+        fprintf(stderr, "Error: File '%s' has %ld rows, expected %ld.\n", filename, total_rows, num_rows);
+        status = 1;
+    } else {
+        thread_pool_run(pool, parse_task, &job);
+
+        // Chunks are in file order, so the first error is the earliest line
+        for (int c = 0; c < num_chunks; ++c) {
+            if (job.chunks[c].error) {
+                fprintf(stderr, "Error: %s:%ld: %s.\n", filename, job.chunks[c].error_line, job.chunks[c].error);
+                status = 1;
+                break;
+            }
+        }
+    }
+
+    thread_pool_destroy(pool);
+    free(job.chunks);
+    munmap((void *)text, size);
+
+    return status;
+}
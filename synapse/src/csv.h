@@ -0,0 +1,18 @@
+#ifndef CSV_H
+#define CSV_H
+
+// What a CSV row holds
+typedef enum {
+    CSV_FLOATS,         // num_cols numbers
+    CSV_ONE_HOT,        // one class index, expanded to num_cols floats
+    CSV_CLASS_INDEX     // one class index below num_cols, kept as one int32
+} CsvMode;
+
+// Parses the first num_rows non-empty rows of a CSV file into out, a
+// contiguous (num_rows x num_cols) row-major float buffer, or num_rows
+// int32 values for CSV_CLASS_INDEX. The file is mapped, split into chunks
+// at line boundaries and parsed on all CPUs.
+// Malformed rows are reported with their line number; returns 0 on success.
+int csv_parse_file(const char *filename, CsvMode mode, void *out, long num_rows, long num_cols);
+
+#endif
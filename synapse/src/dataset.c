@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dataset.h"
+#include "loader.h"
+#include "tensor_file.h"
+#include "csv.h"
+#include "samples_internal.h"
+
+
+typedef struct {
+    int refs;
+    long num_samples;
+    int input_size;
+    int label_size;
+    float *features;
+    float *labels;
+    int32_t *classes;   // replaces labels, with label_size 1, for class-index labels
+
+    // Set for mapped storage; features and labels then point into them
+    SynTensorFile *feature_file;
+    SynTensorFile *label_file;
+} DatasetStorage;
+
+
+struct SynDataset {
+    DatasetStorage *storage;
+    long size;
+
+    // Sample i of the view is storage sample indices[i], or offset + i
+    // while the view is still in storage order
+    long offset;
+    long *indices;
+};
+
+
+static void release_storage(DatasetStorage *storage) {
+    if (!storage || --storage->refs > 0) return;
+
+    if (storage->feature_file || storage->label_file) {
+        syn_tensor_close(storage->feature_file);
+        syn_tensor_close(storage->label_file);
+    } else {
+        free(storage->features);
+        free(storage->labels);
+        free(storage->classes);
+    }
+
+    free(storage);
+}
+
+
+// View of storage samples [offset, offset + size); holds a reference to storage
+static SynDataset* new_view(DatasetStorage *storage, long offset, long size) {
+    SynDataset *ds = (SynDataset *)malloc(sizeof(SynDataset));
+    if (!ds) {
+        fprintf(stderr, "Error: Memory allocation failed for dataset.\n");
+        return NULL;
+    }
+
+    *ds = (SynDataset){ storage, size, offset, NULL };
+    storage->refs += 1;
+    return ds;
+}
+
+
+// Storage around existing buffers, which it frees unless files are given.
+// Exactly one of labels and classes is set.
+static SynDataset* wrap_storage(float *features, float *labels, int32_t *classes, long num_samples, int input_size, int label_size,
+    SynTensorFile *feature_file, SynTensorFile *label_file
+) {
+    DatasetStorage *storage = (DatasetStorage *)malloc(sizeof(DatasetStorage));
+    if (storage) {
+        *storage = (DatasetStorage){ 0, num_samples, input_size, label_size, features, labels, classes,
+            feature_file, label_file };
+
+        SynDataset *ds = new_view(storage, 0, num_samples);
+        if (ds) return ds;
+    } else {
+        fprintf(stderr, "Error: Memory allocation failed for dataset.\n");
+    }
+
+    if (feature_file || label_file) {
+        syn_tensor_close(feature_file);
+        syn_tensor_close(label_file);
+    } else {
+        free(features);
+        free(labels);
+        free(classes);
+    }
+    free(storage);
+    return NULL;
+}
+
+
+SynDataset* syn_dataset_create(long num_samples, int input_size, int label_size) {
+    if (num_samples <= 0 || input_size <= 0 || label_size <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    float *features = (float *)alloc_sample_rows(num_samples, input_size);
+    float *labels = (float *)alloc_sample_rows(num_samples, label_size);
+    if (!features || !labels) {
+        fprintf(stderr, "Error: Memory allocation failed for dataset.\n");
+        free(features);
+        free(labels);
+        return NULL;
+    }
+
+    return wrap_storage(features, labels, NULL, num_samples, input_size, label_size, NULL, NULL);
+}
+
+
+SynDataset* syn_dataset_create_classes(long num_samples, int input_size) {
+    if (num_samples <= 0 || input_size <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    float *features = (float *)alloc_sample_rows(num_samples, input_size);
+    int32_t *classes = (int32_t *)alloc_sample_rows(num_samples, 1);
+    if (!features || !classes) {
+        fprintf(stderr, "Error: Memory allocation failed for dataset.\n");
+        free(features);
+        free(classes);
+        return NULL;
+    }
+
+    return wrap_storage(features, NULL, classes, num_samples, input_size, 1, NULL, NULL);
+}
+
+
+SynDataset* syn_dataset_from_tensors(const char *data_file, const char *labels_file) {
+    SynTensorFile *features = syn_tensor_open(data_file);
+    SynTensorFile *labels = features ? syn_tensor_open(labels_file) : NULL;
+
+    if (!features || !labels) {
+        syn_tensor_close(features);
+        return NULL;
+    }
+
+    // Labels are one-hot float rows or a single int32 class index column
+    const int has_classes = syn_tensor_dtype(labels) == SYN_DTYPE_I32 && syn_tensor_num_cols(labels) == 1;
+
+    if (syn_tensor_dtype(features) != SYN_DTYPE_F32 || (syn_tensor_dtype(labels) != SYN_DTYPE_F32 && !has_classes) ||
+        syn_tensor_num_rows(features) != syn_tensor_num_rows(labels) || syn_tensor_num_rows(features) == 0
+    ) {
+        fprintf(stderr, "Error: '%s' and '%s' are not matching float tensor files.\n", data_file, labels_file);
+        syn_tensor_close(features);
+        syn_tensor_close(labels);
+        return NULL;
+    }
+
+    // Mapped pages are never written through these pointers
+    void *label_data = (void *)syn_tensor_data(labels);
+    return wrap_storage((float *)syn_tensor_data(features), has_classes ? NULL : (float *)label_data,
+        has_classes ? (int32_t *)label_data : NULL,
+        syn_tensor_num_rows(features), (int)syn_tensor_num_cols(features), (int)syn_tensor_num_cols(labels),
+        features, labels);
+}
+
+
+SynDataset* syn_dataset_from_csv(const char *data_file, const char *labels_file,
+    long num_samples, int input_size, int num_classes
+) {
+    SynDataset *ds = syn_dataset_create(num_samples, input_size, num_classes);
+    if (!ds) return NULL;
+
+    if (csv_parse_file(data_file, CSV_FLOATS, ds->storage->features, num_samples, input_size) ||
+        csv_parse_file(labels_file, CSV_ONE_HOT, ds->storage->labels, num_samples, num_classes)
+    ) {
+        syn_dataset_delete(ds);
+        return NULL;
+    }
+
+    return ds;
+}
+
+
+SynDataset* syn_dataset_from_csv_classes(const char *data_file, const char *labels_file,
+    long num_samples, int input_size, int num_classes
+) {
+    if (num_classes <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    SynDataset *ds = syn_dataset_create_classes(num_samples, input_size);
+    if (!ds) return NULL;
+
+    if (csv_parse_file(data_file, CSV_FLOATS, ds->storage->features, num_samples, input_size) ||
+        csv_parse_file(labels_file, CSV_CLASS_INDEX, ds->storage->classes, num_samples, num_classes)
+    ) {
+        syn_dataset_delete(ds);
+        return NULL;
+    }
+
+    return ds;
+}
+
+
+SynDataset* syn_dataset_from_idx(const char *images_file, const char *labels_file, int num_classes) {
+    int num_samples = 0, input_size = 0, num_labels = 0;
+
+    float *features = read_idx_images(images_file, &num_samples, &input_size);
+    float *labels = features ? read_idx_labels(labels_file, &num_labels, num_classes) : NULL;
+
+    if (!features || !labels || num_samples != num_labels || num_samples == 0) {
+        if (labels) fprintf(stderr, "Error: '%s' and '%s' hold different numbers of samples.\n", images_file, labels_file);
+        free(features);
+        free(labels);
+        return NULL;
+    }
+
+    return wrap_storage(features, labels, NULL, num_samples, input_size, num_classes, NULL, NULL);
+}
+
+
+SynDataset* syn_dataset_from_idx_classes(const char *images_file, const char *labels_file, int num_classes) {
+    int num_samples = 0, input_size = 0, num_labels = 0;
+
+    float *features = read_idx_images(images_file, &num_samples, &input_size);
+    int32_t *classes = features ? read_idx_classes(labels_file, &num_labels, num_classes) : NULL;
+
+    if (!features || !classes || num_samples != num_labels || num_samples == 0) {
+        if (classes) fprintf(stderr, "Error: '%s' and '%s' hold different numbers of samples.\n", images_file, labels_file);
+        free(features);
+        free(classes);
+        return NULL;
+    }
+
+    return wrap_storage(features, NULL, classes, num_samples, input_size, 1, NULL, NULL);
+}
+
+
+void syn_dataset_delete(SynDataset *ds) {
+    if (!ds) return;
+
+    release_storage(ds->storage);
+    free(ds->indices);
+    free(ds);
+}
+
+
+long syn_dataset_size(const SynDataset *ds) {
+    return ds ? ds->size : 0;
+}
+
+
+int syn_dataset_input_size(const SynDataset *ds) {
+    return ds ? ds->storage->input_size : 0;
+}
+
+
+int syn_dataset_label_size(const SynDataset *ds) {
+    return ds ? ds->storage->label_size : 0;
+}
+
+
+float* syn_dataset_features(SynDataset *ds) {
+    if (!ds || ds->storage->feature_file) return NULL;
+    return ds->storage->features;
+}
+
+
+float* syn_dataset_labels(SynDataset *ds) {
+    if (!ds || ds->storage->label_file) return NULL;
+    return ds->storage->labels;
+}
+
+
+int syn_dataset_has_classes(const SynDataset *ds) {
+    return ds && ds->storage->classes;
+}
+
+
+int32_t* syn_dataset_classes(SynDataset *ds) {
+    if (!ds || ds->storage->label_file) return NULL;
+    return ds->storage->classes;
+}
+
+
+static long sample_index(const SynDataset *ds, long i) {
+    return ds->indices ? ds->indices[i] : ds->offset + i;
+}
+
+
+SynDataset* syn_dataset_subset(const SynDataset *ds, long begin, long end) {
+    if (!ds || begin < 0 || end <= begin || end > ds->size) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    SynDataset *view = new_view(ds->storage, ds->offset + begin, end - begin);
+    if (!view || !ds->indices) return view;
+
+    view->indices = (long *)malloc((size_t)view->size * sizeof(long));
+    if (!view->indices) {
+        fprintf(stderr, "Error: Memory allocation failed for dataset view.\n");
+        syn_dataset_delete(view);
+        return NULL;
+    }
+
+    memcpy(view->indices, &ds->indices[begin], (size_t)view->size * sizeof(long));
+    return view;
+}
+
+
+int syn_dataset_split(const SynDataset *ds, float test_size, SynDataset **train, SynDataset **test) {
+    if (!ds || !train || !test || test_size <= 0.0f || test_size >= 1.0f) {
+        fprintf(stderr, "Error: Invalid input parameters for data splitting.\n");
+        return 1;
+    }
+
+    long test_count = (long)(ds->size * test_size);
+    long train_count = ds->size - test_count;
+
+    if (test_count == 0 || train_count == 0) {
+        fprintf(stderr, "Error: Dataset too small to split.\n");
+        return 1;
+    }
+
+    *train = syn_dataset_subset(ds, 0, train_count);
+    *test = *train ? syn_dataset_subset(ds, train_count, ds->size) : NULL;
+
+    if (!*test) {
+        syn_dataset_delete(*train);
+        *train = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int syn_dataset_shuffle(SynDataset *ds, unsigned long long seed) {
+    if (!ds) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return 1;
+    }
+
+    if (!ds->indices) {
+        ds->indices = (long *)malloc((size_t)ds->size * sizeof(long));
+        if (!ds->indices) {
+            fprintf(stderr, "Error: Memory allocation failed for dataset view.\n");
+            return 1;
+        }
+
+        for (long i = 0; i < ds->size; ++i) {
+            ds->indices[i] = ds->offset + i;
+        }
+    }
+
+    // Fisher-Yates
+    for (long i = ds->size - 1; i > 0; --i) {
+        long j = (long)(next_random(&seed) % (unsigned long long)(i + 1));
+        long tmp = ds->indices[i];
+        ds->indices[i] = ds->indices[j];
+        ds->indices[j] = tmp;
+    }
+
+    return 0;
+}
+
+
+const float* syn_dataset_sample(const SynDataset *ds, long i, const float **labels) {
+    if (!ds || i < 0 || i >= ds->size) return NULL;
+
+    long index = sample_index(ds, i);
+    if (labels) *labels = ds->storage->labels ? &ds->storage->labels[(size_t)index * ds->storage->label_size] : NULL;
+
+    return &ds->storage->features[(size_t)index * ds->storage->input_size];
+}
+
+
+int32_t syn_dataset_class(const SynDataset *ds, long i) {
+    if (!ds || !ds->storage->classes || i < 0 || i >= ds->size) return -1;
+    return ds->storage->classes[sample_index(ds, i)];
+}
+
+
+// Copies label rows of label_bytes each from label_base, which holds
+// either the float rows or the class indices of the storage
+static int gather_samples(const SynDataset *ds, long begin, long count, float *inputs,
+    const void *label_base, size_t label_bytes, void *labels
+) {
+    const DatasetStorage *storage = ds->storage;
+    const size_t input_size = storage->input_size;
+    const char *src = (const char *)label_base;
+    char *dst = (char *)labels;
+
+    // A view in storage order is a single sequential copy
+    if (!ds->indices) {
+        size_t first = (size_t)(ds->offset + begin);
+        memcpy(inputs, &storage->features[first * input_size], (size_t)count * input_size * sizeof(float));
+        if (dst) memcpy(dst, &src[first * label_bytes], (size_t)count * label_bytes);
+        return 0;
+    }
+
+    for (long b = 0; b < count; ++b) {
+        size_t index = (size_t)ds->indices[begin + b];
+        memcpy(&inputs[b * input_size], &storage->features[index * input_size], input_size * sizeof(float));
+        if (dst) memcpy(&dst[b * label_bytes], &src[index * label_bytes], label_bytes);
+    }
+
+    return 0;
+}
+
+
+int syn_dataset_gather(const SynDataset *ds, long begin, long count, float *inputs, float *labels) {
+    if (!ds || !inputs || begin < 0 || count <= 0 || begin + count > ds->size || (labels && !ds->storage->labels)) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return 1;
+    }
+
+    return gather_samples(ds, begin, count, inputs, ds->storage->labels,
+        (size_t)ds->storage->label_size * sizeof(float), labels);
+}
+
+
+int syn_dataset_gather_classes(const SynDataset *ds, long begin, long count, float *inputs, int32_t *classes) {
+    if (!ds || !inputs || begin < 0 || count <= 0 || begin + count > ds->size || (classes && !ds->storage->classes)) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return 1;
+    }
+
+    return gather_samples(ds, begin, count, inputs, ds->storage->classes, sizeof(int32_t), classes);
+}
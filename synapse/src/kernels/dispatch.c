@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "kernels.h"
+
+
+static const KernelTable *_kernels = &kernels_scalar;
+static atomic_int _math_fast = 0;
+
+static void (*_qgemm)(int, int, int, const uint8_t *restrict, int, const int8_t *restrict, int,
+    int32_t *restrict, int) = NULL;
+static const char *_qgemm_name = "scalar";
+
+static void (*_hgemm)(int, int, int, int, const float *restrict, int, const uint16_t *restrict, int,
+    float *restrict, int) = NULL;
+
+
+static const KernelTable* kernels_by_name(const char *name) {
+    if (strcmp(name, "scalar") == 0) return &kernels_scalar;
+#ifdef KERNELS_X86
+    if (strcmp(name, "avx2") == 0) return &kernels_avx2;
+    if (strcmp(name, "avx512") == 0) return &kernels_avx512;
+#endif
+    return NULL;
+}
+
+
+static int kernels_supported(const KernelTable *table) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+
+    if (table == &kernels_avx512) {
+        return __builtin_cpu_supports("avx512f");
+    }
+
+    if (table == &kernels_avx2) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+#endif
+    return table == &kernels_scalar;
+}
+
+
+// The int8 and 16-bit products follow the chosen table, within what the CPU
+// supports beyond the table's own requirements
+static void select_reduced_kernels(void) {
+    _qgemm = _kernels->qgemm;
+    _qgemm_name = _kernels->name;
+
+#ifdef KERNELS_X86
+    if (_kernels == &kernels_avx512) {
+        if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+            _qgemm = qgemm_avx512_vnni;
+            _qgemm_name = "avx512-vnni";
+        } else if (!__builtin_cpu_supports("avx512bw")) {
+            _qgemm = kernels_avx2.qgemm;
+            _qgemm_name = kernels_avx2.name;
+        }
+    }
+#endif
+
+    // AVX2 CPUs without F16C are rare enough to fall back to scalar
+    _hgemm = _kernels->hgemm;
+#ifdef KERNELS_X86
+    if (_kernels == &kernels_avx2 && !__builtin_cpu_supports("f16c")) {
+        _hgemm = kernels_scalar.hgemm;
+    }
+#endif
+}
+
+
+__attribute__((constructor))
+static void select_kernels(void) {
+    const char *math = getenv("SYNAPSE_MATH");
+    if (math && *math) {
+        if (strcmp(math, "fast") == 0 || strcmp(math, "precise") == 0) {
+            atomic_store_explicit(&_math_fast, strcmp(math, "fast") == 0, memory_order_relaxed);
+        } else {
+            fprintf(stderr, "Warning: Math mode '%s' not available, using precise.\n", math);
+        }
+    }
+
+    const char *forced = getenv("SYNAPSE_KERNELS");
+    if (forced && *forced) {
+        const KernelTable *table = kernels_by_name(forced);
+
+        if (table && kernels_supported(table)) {
+            _kernels = table;
+            select_reduced_kernels();
+            return;
+        }
+
+        fprintf(stderr, "Warning: Kernels '%s' not available, using CPU detection.\n", forced);
+    }
+
+#ifdef KERNELS_X86
+    if (kernels_supported(&kernels_avx512)) {
+        _kernels = &kernels_avx512;
+    } else if (kernels_supported(&kernels_avx2)) {
+        _kernels = &kernels_avx2;
+    }
+#endif
+
+    select_reduced_kernels();
+}
+
+
+const KernelTable* kernel_table(void) {
+    return _kernels;
+}
+
+
+const KernelTable* kernel_table_named(const char *name) {
+    const KernelTable *table = kernels_by_name(name);
+    return (table && kernels_supported(table)) ? table : NULL;
+}
+
+
+const char* kernel_name(void) {
+    return _kernels->name;
+}
+
+
+int kernel_math_fast(void) {
+    return atomic_load_explicit(&_math_fast, memory_order_relaxed);
+}
+
+
+void kernel_set_math_fast(int fast) {
+    atomic_store_explicit(&_math_fast, fast ? 1 : 0, memory_order_relaxed);
+}
+
+
+void kernel_qgemm(int batch, int m, int k, const uint8_t *x, int ldx, const int8_t *w, int ldw, int32_t *c, int ldc) {
+    if (batch <= 0 || m <= 0) return;
+    _qgemm(batch, m, k, x, ldx, w, ldw, c, ldc);
+}
+
+
+const char* kernel_qgemm_name(void) {
+    return _qgemm_name;
+}
+
+
+void kernel_hgemm(int type, int batch, int m, int k, const float *x, int ldx, const uint16_t *w, int ldw,
+    float *c, int ldc
+) {
+    if (batch <= 0 || m <= 0) return;
+    _hgemm(type, batch, m, k, x, ldx, w, ldw, c, ldc);
+}
@@ -0,0 +1,409 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "kernels.h"
+
+
+// Cache blocking: a (MC x KC) block of op(a) is packed to stay in L2, a
+// (KC x NC) block of op(b) is packed to stay in L3, and the micro-kernel
+// streams MR x NR tiles of c through registers.
+#define MC 144
+#define KC 256
+#define NC 2048
+
+#define MAX_TILE (16 * 32)
+
+
+// Packing buffers are per thread so the kernels can be called concurrently.
+static _Thread_local float *_pack_a = NULL;
+static _Thread_local size_t _pack_a_size = 0;
+static _Thread_local float *_pack_b = NULL;
+static _Thread_local size_t _pack_b_size = 0;
+
+
+static float* reserve_pack(float **buffer, size_t *capacity, size_t size) {
+    if (*capacity >= size) return *buffer;
+
+    free(*buffer);
+    size_t bytes = (size * sizeof(float) + 63) & ~(size_t)63;
+    *buffer = (float *)aligned_alloc(64, bytes);
+    *capacity = *buffer ? size : 0;
+
+    return *buffer;
+}
+
+
+void kernel_release_buffers(void) {
+    free(_pack_a);
+    free(_pack_b);
+    _pack_a = NULL;
+    _pack_b = NULL;
+    _pack_a_size = 0;
+    _pack_b_size = 0;
+}
+
+
+void kernel_widen_bf16(long n, const uint16_t *restrict src, float *restrict dst) {
+    for (long i = 0; i < n; ++i) {
+        uint32_t bits = (uint32_t)src[i] << 16;
+        memcpy(&dst[i], &bits, sizeof(bits));
+    }
+}
+
+
+void kernel_round_bf16(long n, const float *restrict src, uint16_t *restrict dst) {
+    for (long i = 0; i < n; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &src[i], sizeof(bits));
+
+        uint16_t rounded = (uint16_t)((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+        dst[i] = ((bits & 0x7fffffff) > 0x7f800000) ? (uint16_t)((bits >> 16) | 0x40) : rounded;
+    }
+}
+
+
+// Element i of an operand stored as fp32 or, with half set, bfloat16
+static inline float operand_at(const void *x, int half, size_t i) {
+    if (!half) return ((const float *)x)[i];
+
+    uint32_t bits = (uint32_t)((const uint16_t *)x)[i] << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+
+// Packs rows [i0, i0 + mc) and columns [p0, p0 + kc) of op(a) into panels of
+// mr rows, each stored column by column and padded with zeros.
+static void pack_a(int trans_a, const void *a, int a_half, int lda, int i0, int mc, int p0, int kc, int mr,
+    float *restrict out
+) {
+    for (int ir = 0; ir < mc; ir += mr) {
+        int rows = (mc - ir < mr) ? mc - ir : mr;
+
+        for (int p = 0; p < kc; ++p) {
+            for (int r = 0; r < rows; ++r) {
+                int i = i0 + ir + r;
+                int q = p0 + p;
+                *out++ = operand_at(a, a_half, trans_a ? (size_t)q * lda + i : (size_t)i * lda + q);
+            }
+            for (int r = rows; r < mr; ++r) {
+                *out++ = 0.0f;
+            }
+        }
+    }
+}
+
+
+// Packs rows [p0, p0 + kc) and columns [j0, j0 + nc) of op(b) into panels of
+// nr columns, each stored row by row and padded with zeros.
+static void pack_b(int trans_b, const void *b, int b_half, int ldb, int p0, int kc, int j0, int nc, int nr,
+    float *restrict out
+) {
+    for (int jr = 0; jr < nc; jr += nr) {
+        int cols = (nc - jr < nr) ? nc - jr : nr;
+
+        for (int p = 0; p < kc; ++p) {
+            int q = p0 + p;
+            size_t row = (size_t)q * ldb + j0 + jr;
+
+            if (!trans_b && b_half) {
+                kernel_widen_bf16(cols, &((const uint16_t *)b)[row], out);
+                out += cols;
+            } else if (!trans_b) {
+                memcpy(out, &((const float *)b)[row], cols * sizeof(float));
+                out += cols;
+            } else {
+                for (int c = 0; c < cols; ++c) {
+                    *out++ = operand_at(b, b_half, (size_t)(j0 + jr + c) * ldb + q);
+                }
+            }
+            for (int c = cols; c < nr; ++c) {
+                *out++ = 0.0f;
+            }
+        }
+    }
+}
+
+
+void kernel_sgemm(int trans_a, int trans_b, int m, int n, int k,
+    const float *a, int lda,
+    const float *b, int ldb,
+    float *c, int ldc,
+    int accumulate
+) {
+    kernel_gemm_mixed(trans_a, trans_b, m, n, k, a, 0, lda, b, 0, ldb, c, ldc, accumulate);
+}
+
+
+// Bias and activation applied to the finished tiles of c, see kernel_gemm_bias_activ()
+typedef struct {
+    int op;
+    const float *bias;
+    float *out;
+    int ldo;
+} Epilogue;
+
+
+// c += op(a) * op(b) read straight from the operands, used when the packing
+// buffers cannot be allocated
+static void gemm_unpacked(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc
+) {
+    for (int i = 0; i < m; ++i) {
+        float *ci = &c[(size_t)i * ldc];
+
+        for (int p = 0; p < k; ++p) {
+            float aip = operand_at(a, a_half, trans_a ? (size_t)p * lda + i : (size_t)i * lda + p);
+
+            for (int j = 0; j < n; ++j) {
+                ci[j] += aip * operand_at(b, b_half, trans_b ? (size_t)j * ldb + p : (size_t)p * ldb + j);
+            }
+        }
+    }
+}
+
+
+static void gemm_blocked(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc,
+    int accumulate, const Epilogue *ep
+) {
+    if (m <= 0 || n <= 0) return;
+
+    if (!accumulate) {
+        for (int i = 0; i < m; ++i) {
+            memset(&c[(size_t)i * ldc], 0, n * sizeof(float));
+        }
+    }
+
+    const KernelTable *kt = kernel_table();
+
+    if (k <= 0) {
+        if (ep) kt->bias_activ(ep->op, m, n, ep->bias, c, ldc, ep->out, ep->ldo);
+        return;
+    }
+
+    const int mr = kt->mr;
+    const int nr = kt->nr;
+
+    int nc_max = (n < NC) ? n : NC;
+    int kc_max = (k < KC) ? k : KC;
+    int mc_max = (m < MC) ? m : MC;
+
+    float *packed_b = reserve_pack(&_pack_b, &_pack_b_size, (size_t)kc_max * ((nc_max + nr - 1) / nr) * nr);
+    float *packed_a = reserve_pack(&_pack_a, &_pack_a_size, (size_t)kc_max * ((mc_max + mr - 1) / mr) * mr);
+    if (!packed_a || !packed_b) {
+        gemm_unpacked(trans_a, trans_b, m, n, k, a, a_half, lda, b, b_half, ldb, c, ldc);
+        if (ep) kt->bias_activ(ep->op, m, n, ep->bias, c, ldc, ep->out, ep->ldo);
+        return;
+    }
+
+    float tile[MAX_TILE];
+
+    for (int j0 = 0; j0 < n; j0 += NC) {
+        int nc = (n - j0 < NC) ? n - j0 : NC;
+
+        for (int p0 = 0; p0 < k; p0 += KC) {
+            int kc = (k - p0 < KC) ? k - p0 : KC;
+            const Epilogue *tile_ep = (p0 + kc == k) ? ep : NULL;
+            pack_b(trans_b, b, b_half, ldb, p0, kc, j0, nc, nr, packed_b);
+
+            for (int i0 = 0; i0 < m; i0 += MC) {
+                int mc = (m - i0 < MC) ? m - i0 : MC;
+                pack_a(trans_a, a, a_half, lda, i0, mc, p0, kc, mr, packed_a);
+
+                for (int jr = 0; jr < nc; jr += nr) {
+                    int cols = (nc - jr < nr) ? nc - jr : nr;
+                    const float *bp = &packed_b[(size_t)jr * kc];
+
+                    for (int ir = 0; ir < mc; ir += mr) {
+                        int rows = (mc - ir < mr) ? mc - ir : mr;
+                        const float *ap = &packed_a[(size_t)ir * kc];
+                        float *cp = &c[(size_t)(i0 + ir) * ldc + j0 + jr];
+
+                        if (rows == mr && cols == nr) {
+                            kt->ukernel(kc, ap, bp, cp, ldc);
+                        } else {
+                            // Edge tile: compute the padded tile aside and add the valid part
+                            memset(tile, 0, (size_t)mr * nr * sizeof(float));
+                            kt->ukernel(kc, ap, bp, tile, nr);
+
+                            for (int r = 0; r < rows; ++r) {
+                                for (int s = 0; s < cols; ++s) {
+                                    cp[(size_t)r * ldc + s] += tile[r * nr + s];
+                                }
+                            }
+                        }
+
+                        // The tile is final after the last k block and still in L1
+                        if (tile_ep) {
+                            const float *bias = tile_ep->bias ? &tile_ep->bias[j0 + jr] : NULL;
+                            kt->bias_activ(tile_ep->op, rows, cols, bias, cp, ldc,
+                                &tile_ep->out[(size_t)(i0 + ir) * tile_ep->ldo + j0 + jr], tile_ep->ldo);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void kernel_gemm_mixed(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc,
+    int accumulate
+) {
+    gemm_blocked(trans_a, trans_b, m, n, k, a, a_half, lda, b, b_half, ldb, c, ldc, accumulate, NULL);
+}
+
+
+void kernel_gemm_bias_activ(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc,
+    int op, const float *bias, float *out, int ldo
+) {
+    const Epilogue ep = { op, bias, out, ldo };
+    gemm_blocked(trans_a, trans_b, m, n, k, a, a_half, lda, b, b_half, ldb, c, ldc, 0, &ep);
+
+    if (op == ACTIV_SOFTMAX && n > 0) {
+        const KernelTable *kt = kernel_table();
+        for (int i = 0; i < m; ++i) {
+            kt->softmax(n, &c[(size_t)i * ldc], &out[(size_t)i * ldo]);
+        }
+    }
+}
+
+
+void kernel_bias_activ(int op, int m, int n, const float *bias, float *c, int ldc, float *out, int ldo) {
+    if (m <= 0 || n <= 0) return;
+
+    const KernelTable *kt = kernel_table();
+    kt->bias_activ(op, m, n, bias, c, ldc, out, ldo);
+
+    if (op == ACTIV_SOFTMAX) {
+        for (int i = 0; i < m; ++i) {
+            kt->softmax(n, &c[(size_t)i * ldc], &out[(size_t)i * ldo]);
+        }
+    }
+}
+
+
+void kernel_activ_grad(int op, long n, const float *a, float *d) {
+    if (n <= 0) return;
+    kernel_table()->activ_grad(op, n, a, d);
+}
+
+
+void kernel_activ(int op, int n, const float *x, float *y) {
+    if (n <= 0) return;
+
+    // Without a bias, bias_activ only reads c
+    if (op == ACTIV_SOFTMAX) {
+        kernel_table()->softmax(n, x, y);
+    } else {
+        kernel_table()->bias_activ(op, 1, n, NULL, (float *)x, n, y, n);
+    }
+}
+
+
+void kernel_vexp(long n, const float *x, float *y) {
+    if (n <= 0) return;
+    kernel_table()->vexp(n, x, y);
+}
+
+
+void kernel_vlog(long n, const float *x, float *y) {
+    if (n <= 0) return;
+    kernel_table()->vlog(n, x, y);
+}
+
+
+float kernel_log(float x) {
+    float y;
+    kernel_table()->vlog(1, &x, &y);
+    return y;
+}
+
+
+float kernel_bce_sum(int n, const float *y, const float *p, float eps) {
+    if (n <= 0) return 0.0f;
+    return kernel_table()->bce_sum(n, y, p, eps);
+}
+
+
+float kernel_softmax_xent(int m, int n, const float *z, const float *y, const int32_t *labels, float scale,
+    float *p, float *d
+) {
+    if (m <= 0 || n <= 0) return 0.0f;
+
+    const KernelTable *kt = kernel_table();
+    float loss = 0.0f;
+
+    for (int i = 0; i < m; ++i) {
+        const size_t row = (size_t)i * n;
+        loss += kt->softmax_xent(n, &z[row], y ? &y[row] : NULL, labels ? labels[i] : 0, scale, &p[row], &d[row]);
+    }
+
+    return loss;
+}
+
+
+float kernel_logsumexp(int n, const float *x) {
+    if (n <= 0) return -INFINITY;
+    return kernel_table()->logsumexp(n, x);
+}
+
+
+void kernel_sgemv(int m, int n, const float *a, int lda, const float *x, float *y, int accumulate) {
+    if (m <= 0) return;
+    kernel_table()->sgemv(m, n, a, lda, x, y, accumulate);
+}
+
+
+void kernel_sgemv_t(int m, int n, const float *a, int lda, const float *x, float *y, int accumulate) {
+    if (n <= 0) return;
+
+    if (!accumulate) {
+        memset(y, 0, n * sizeof(float));
+    }
+
+    const KernelTable *kt = kernel_table();
+    for (int i = 0; i < m; ++i) {
+        kt->saxpy(n, x[i], &a[(size_t)i * lda], y);
+    }
+}
+
+
+void kernel_sger(int m, int n, float alpha, const float *x, const float *y, float *a, int lda) {
+    const KernelTable *kt = kernel_table();
+    for (int i = 0; i < m; ++i) {
+        kt->saxpy(n, alpha * x[i], y, &a[(size_t)i * lda]);
+    }
+}
+
+
+void kernel_saxpy(int n, float alpha, const float *x, float *y) {
+    if (n <= 0) return;
+    kernel_table()->saxpy(n, alpha, x, y);
+}
+
+
+void kernel_optim_step(const OptimStep *step, long n, float *w, const float *g, float *m, float *v) {
+    if (n <= 0) return;
+    kernel_table()->optim_step(step, n, w, g, m, v);
+}
+
+
+float kernel_sdot(int n, const float *x, const float *y) {
+    if (n <= 0) return 0.0f;
+    return kernel_table()->sdot(n, x, y);
+}
@@ -0,0 +1,247 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+
+// Dense float kernels used by the library. All matrices are row-major.
+// The implementation (scalar, AVX2+FMA or AVX-512) is chosen once at load
+// time from CPUID and can be forced with the SYNAPSE_KERNELS environment
+// variable ("scalar", "avx2" or "avx512").
+
+// Quantized rows are zero-padded to a multiple of this many bytes
+#define QUANT_BLOCK 64
+
+// 16-bit weight formats of KernelTable.hgemm
+enum {
+    HALF_F16,
+    HALF_BF16
+};
+
+// Activations applied by the GEMM epilogue. The elementwise ones are
+// differentiated from their outputs; ACTIV_SOFTMAX normalizes whole rows.
+enum {
+    ACTIV_LINEAR,
+    ACTIV_RELU,
+    ACTIV_SIGMOID,
+    ACTIV_SOFTMAX
+};
+
+// Vectorized exp and log: Cody-Waite range reduction to |r| <= ln(2)/2 and
+// m in [sqrt(1/2), sqrt(2)), then a minimax polynomial. The precise ones are
+// within 1.3 ULP (exp) and 0.9 ULP (log) over all floats; the fast ones,
+// two and four degrees shorter, within 71 and 26 ULP. exp is 0 below EXP_MIN.
+#define EXP_MIN -104.0f
+#define EXP_MAX 89.0f
+#define EXP_LOG2E 1.44269504f
+#define LN2_HI 0.693359375f
+#define LN2_LO -2.12194440e-4f
+
+// e^r = 1 + r + r^2 * P(r)
+#define EXP_P0 4.999999345e-1f
+#define EXP_P1 1.666652069e-1f
+#define EXP_P2 4.166838737e-2f
+#define EXP_P3 8.368709832e-3f
+#define EXP_P4 1.381461287e-3f
+#define EXP_FAST_P0 5.000511603e-1f
+#define EXP_FAST_P1 1.675351393e-1f
+#define EXP_FAST_P2 4.127774709e-2f
+
+// log(1 + t) = t - t^2 / 2 + t^3 * P(t)
+#define LOG_P0 3.333331260e-1f
+#define LOG_P1 -2.500000960e-1f
+#define LOG_P2 2.000211866e-1f
+#define LOG_P3 -1.666799592e-1f
+#define LOG_P4 1.421955247e-1f
+#define LOG_P5 -1.240558800e-1f
+#define LOG_P6 1.188816024e-1f
+#define LOG_P7 -1.167565536e-1f
+#define LOG_P8 6.746649048e-2f
+#define LOG_FAST_P0 3.332086087e-1f
+#define LOG_FAST_P1 -2.494383275e-1f
+#define LOG_FAST_P2 2.044218801e-1f
+#define LOG_FAST_P3 -1.840718965e-1f
+#define LOG_FAST_P4 1.178189582e-1f
+
+// Update rules of the fused optimizer kernel
+enum {
+    OPTIM_SGD,
+    OPTIM_MOMENTUM,
+    OPTIM_ADAGRAD,
+    OPTIM_RMSPROP,
+    OPTIM_ADAM
+};
+
+// Scalars of one optimizer step, computed once per step. For Adam the bias
+// corrections are folded in: learning_rate is lr / (1 - beta1^t) and
+// v_scale is 1 / sqrt(1 - beta2^t); v_scale is 1 for the other rules.
+typedef struct {
+    int rule;
+    float learning_rate;
+    float beta1;
+    float beta2;
+    float v_scale;
+    float epsilon;
+} OptimStep;
+
+
+typedef struct {
+    const char *name;
+    int mr;
+    int nr;
+
+    // c[mr x nr] += a_panel * b_panel over kc steps (packed operands)
+    void (*ukernel)(int kc, const float *restrict a, const float *restrict b, float *restrict c, int ldc);
+
+    float (*sdot)(int n, const float *restrict x, const float *restrict y);
+    void (*saxpy)(int n, float alpha, const float *restrict x, float *restrict y);
+
+    // y[i] (+)= a[i, :] . x for m rows
+    void (*sgemv)(int m, int n, const float *restrict a, int lda, const float *restrict x,
+        float *restrict y, int accumulate);
+
+    // One optimizer update of w[0..n) from g, with m and v the first and
+    // second moment buffers (NULL when the rule does not use them)
+    void (*optim_step)(const OptimStep *step, long n, float *restrict w, const float *restrict g,
+        float *restrict m, float *restrict v);
+
+    // c[b, i] = x[b, :] . w[i, :] in int32 for batch rows of unsigned x and
+    // m rows of signed w, k a multiple of QUANT_BLOCK. x must not exceed 127,
+    // which keeps the 16-bit pair sums of vpmaddubsw from saturating.
+    void (*qgemm)(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+        const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc);
+
+    // c[b, i] = x[b, :] . w[i, :] for batch fp32 rows of x and m rows of w
+    // stored as HALF_F16 or HALF_BF16, widened in registers and summed in fp32
+    void (*hgemm)(int type, int batch, int m, int k, const float *restrict x, int ldx,
+        const uint16_t *restrict w, int ldw, float *restrict c, int ldc);
+
+    // c[r, :] += bias (when not NULL), then out[r, :] = f(c[r, :]) for rows
+    // of cols elements; out may be c. ACTIV_SOFTMAX only adds the bias.
+    void (*bias_activ)(int op, int rows, int cols, const float *bias, float *c, int ldc, float *out, int ldo);
+
+    // d[i] *= f'(x) from the output a[i] = f(x) of an elementwise activation
+    void (*activ_grad)(int op, long n, const float *restrict a, float *restrict d);
+
+    // y = exp(x) and y = log(x) elementwise; y may be x
+    void (*vexp)(long n, const float *x, float *y);
+    void (*vlog)(long n, const float *x, float *y);
+
+    // Softmax of one row: the maximum and the sum of exponentials in one
+    // online pass over x, rescaling the sum whenever the maximum grows, then
+    // y = exp(x - max) / sum
+    void (*softmax)(int n, const float *restrict x, float *restrict y);
+
+    // log(sum(exp(x))) of one row, from the same online pass
+    float (*logsumexp)(int n, const float *x);
+
+    // Softmax cross-entropy of one row of logits z against the targets y, or
+    // the class index label when y is NULL. With lse = logsumexp(z), writes
+    // p = exp(z - lse) and d = scale * (p - y) in a second pass and returns
+    // the loss sum(y * (lse - z)).
+    float (*softmax_xent)(int n, const float *restrict z, const float *restrict y, int label, float scale,
+        float *restrict p, float *restrict d);
+
+    // Sum of y log(p) + (1 - y) log(1 - p) with p clamped to [eps, 1 - eps]
+    float (*bce_sum)(int n, const float *restrict y, const float *restrict p, float eps);
+} KernelTable;
+
+const KernelTable* kernel_table(void);
+const char* kernel_name(void);
+
+// The table a SYNAPSE_KERNELS name selects, or NULL when the CPU cannot run it
+const KernelTable* kernel_table_named(const char *name);
+
+// Polynomial accuracy of the vector exp and log: 0 precise, 1 fast. Set from
+// SYNAPSE_MATH ("precise" or "fast") at load time. The scalar kernels
+// always use libm.
+int kernel_math_fast(void);
+void kernel_set_math_fast(int fast);
+
+// c = op(a) * op(b) (+ c if accumulate), where op(a) is (m x k) and op(b) is (k x n)
+void kernel_sgemm(int trans_a, int trans_b, int m, int n, int k,
+    const float *a, int lda,
+    const float *b, int ldb,
+    float *c, int ldc,
+    int accumulate
+);
+
+// kernel_sgemm() with a and/or b stored as bfloat16 when a_half/b_half are
+// set; they are widened to fp32 while being packed
+void kernel_gemm_mixed(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc,
+    int accumulate
+);
+
+// kernel_gemm_mixed() into c without accumulation, then c += bias by rows
+// and out = f(c), applied to each tile of c as soon as it is complete
+void kernel_gemm_bias_activ(int trans_a, int trans_b, int m, int n, int k,
+    const void *a, int a_half, int lda,
+    const void *b, int b_half, int ldb,
+    float *c, int ldc,
+    int op, const float *bias, float *out, int ldo
+);
+
+// KernelTable.bias_activ over m rows; ACTIV_SOFTMAX normalizes each row of
+// c into out, which must not alias c
+void kernel_bias_activ(int op, int m, int n, const float *bias, float *c, int ldc, float *out, int ldo);
+void kernel_activ_grad(int op, long n, const float *a, float *d);
+
+// Elementwise ACTIV_* op or the softmax of x as one row, x left unchanged
+void kernel_activ(int op, int n, const float *x, float *y);
+
+void kernel_vexp(long n, const float *x, float *y);
+void kernel_vlog(long n, const float *x, float *y);
+float kernel_log(float x);
+float kernel_bce_sum(int n, const float *y, const float *p, float eps);
+
+// KernelTable.softmax_xent over m rows of z, with the targets in the rows
+// of y or the class indices in labels; returns the summed loss
+float kernel_softmax_xent(int m, int n, const float *z, const float *y, const int32_t *labels, float scale,
+    float *p, float *d);
+float kernel_logsumexp(int n, const float *x);
+
+// Bulk bfloat16 conversions, rounding to nearest even
+void kernel_widen_bf16(long n, const uint16_t *restrict src, float *restrict dst);
+void kernel_round_bf16(long n, const float *restrict src, uint16_t *restrict dst);
+
+// y (+)= a * x with a (m x n)
+void kernel_sgemv(int m, int n, const float *a, int lda, const float *x, float *y, int accumulate);
+
+// y (+)= a^T * x with a (m x n)
+void kernel_sgemv_t(int m, int n, const float *a, int lda, const float *x, float *y, int accumulate);
+
+// a += alpha * x * y^T with a (m x n)
+void kernel_sger(int m, int n, float alpha, const float *x, const float *y, float *a, int lda);
+
+// Frees the calling thread's packing buffers; worker threads call it on exit.
+void kernel_release_buffers(void);
+
+// Int8 product of KernelTable.qgemm, with AVX-512 VNNI where the CPU has it
+void kernel_qgemm(int batch, int m, int k, const uint8_t *x, int ldx, const int8_t *w, int ldw, int32_t *c, int ldc);
+const char* kernel_qgemm_name(void);
+
+void kernel_hgemm(int type, int batch, int m, int k, const float *x, int ldx, const uint16_t *w, int ldw,
+    float *c, int ldc);
+
+// Conversions of one value, rounding to nearest even
+float half_to_float(int type, uint16_t h);
+uint16_t float_to_half(int type, float f);
+
+void kernel_saxpy(int n, float alpha, const float *x, float *y);
+void kernel_optim_step(const OptimStep *step, long n, float *w, const float *g, float *m, float *v);
+float kernel_sdot(int n, const float *x, const float *y);
+
+extern const KernelTable kernels_scalar;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+extern const KernelTable kernels_avx2;
+extern const KernelTable kernels_avx512;
+
+void qgemm_avx512_vnni(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+    const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc);
+#endif
+
+#endif
@@ -0,0 +1,739 @@
+#include "kernels.h"
+
+#ifdef KERNELS_X86
+
+#include <immintrin.h>
+#include <float.h>
+#include <math.h>
+
+#define TARGET __attribute__((target("avx2,fma")))
+#define TARGET_F16C __attribute__((target("avx2,fma,f16c")))
+
+#define MR 6
+#define NR 16
+
+#define QGEMM_TILE 32
+#define HGEMM_TILE 8
+
+
+TARGET
+static void ukernel_avx2(int kc, const float *restrict a, const float *restrict b, float *restrict c, int ldc) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (int p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(&b[p * NR]);
+        __m256 b1 = _mm256_load_ps(&b[p * NR + 8]);
+        const float *ap = &a[p * MR];
+        __m256 x;
+
+        x = _mm256_broadcast_ss(&ap[0]);
+        c00 = _mm256_fmadd_ps(x, b0, c00); c01 = _mm256_fmadd_ps(x, b1, c01);
+        x = _mm256_broadcast_ss(&ap[1]);
+        c10 = _mm256_fmadd_ps(x, b0, c10); c11 = _mm256_fmadd_ps(x, b1, c11);
+        x = _mm256_broadcast_ss(&ap[2]);
+        c20 = _mm256_fmadd_ps(x, b0, c20); c21 = _mm256_fmadd_ps(x, b1, c21);
+        x = _mm256_broadcast_ss(&ap[3]);
+        c30 = _mm256_fmadd_ps(x, b0, c30); c31 = _mm256_fmadd_ps(x, b1, c31);
+        x = _mm256_broadcast_ss(&ap[4]);
+        c40 = _mm256_fmadd_ps(x, b0, c40); c41 = _mm256_fmadd_ps(x, b1, c41);
+        x = _mm256_broadcast_ss(&ap[5]);
+        c50 = _mm256_fmadd_ps(x, b0, c50); c51 = _mm256_fmadd_ps(x, b1, c51);
+    }
+
+#define STORE_ROW(r, lo, hi) \
+    _mm256_storeu_ps(&c[(r) * ldc], _mm256_add_ps(_mm256_loadu_ps(&c[(r) * ldc]), lo)); \
+    _mm256_storeu_ps(&c[(r) * ldc + 8], _mm256_add_ps(_mm256_loadu_ps(&c[(r) * ldc + 8]), hi));
+
+    STORE_ROW(0, c00, c01);
+    STORE_ROW(1, c10, c11);
+    STORE_ROW(2, c20, c21);
+    STORE_ROW(3, c30, c31);
+    STORE_ROW(4, c40, c41);
+    STORE_ROW(5, c50, c51);
+
+#undef STORE_ROW
+}
+
+
+TARGET
+static float hsum_avx2(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+
+TARGET
+static float sdot_avx2(int n, const float *restrict x, const float *restrict y) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&y[i]), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i + 8]), _mm256_loadu_ps(&y[i + 8]), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&y[i]), acc0);
+    }
+
+    float sum = hsum_avx2(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+
+    return sum;
+}
+
+
+TARGET
+static void saxpy_avx2(int n, float alpha, const float *restrict x, float *restrict y) {
+    __m256 a = _mm256_set1_ps(alpha);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(&y[i], _mm256_fmadd_ps(a, _mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&y[i])));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+
+// Four rows at a time so every load of x feeds four accumulators
+TARGET
+static void sgemv_avx2(int m, int n, const float *restrict a, int lda, const float *restrict x,
+    float *restrict y, int accumulate
+) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        const float *a0 = &a[(long)i * lda];
+        const float *a1 = a0 + lda;
+        const float *a2 = a1 + lda;
+        const float *a3 = a2 + lda;
+
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+
+        int j = 0;
+        for (; j + 8 <= n; j += 8) {
+            __m256 v = _mm256_loadu_ps(&x[j]);
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a0[j]), v, s0);
+            s1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a1[j]), v, s1);
+            s2 = _mm256_fmadd_ps(_mm256_loadu_ps(&a2[j]), v, s2);
+            s3 = _mm256_fmadd_ps(_mm256_loadu_ps(&a3[j]), v, s3);
+        }
+
+        float r0 = hsum_avx2(s0), r1 = hsum_avx2(s1), r2 = hsum_avx2(s2), r3 = hsum_avx2(s3);
+        for (; j < n; ++j) {
+            r0 += a0[j] * x[j];
+            r1 += a1[j] * x[j];
+            r2 += a2[j] * x[j];
+            r3 += a3[j] * x[j];
+        }
+
+        if (accumulate) {
+            y[i] += r0; y[i + 1] += r1; y[i + 2] += r2; y[i + 3] += r3;
+        } else {
+            y[i] = r0; y[i + 1] = r1; y[i + 2] = r2; y[i + 3] = r3;
+        }
+    }
+
+    for (; i < m; ++i) {
+        float sum = sdot_avx2(n, &a[(long)i * lda], x);
+        y[i] = accumulate ? y[i] + sum : sum;
+    }
+}
+
+
+// Eight lanes per iteration, the remainder goes through the scalar kernel
+TARGET
+static void optim_step_avx2(const OptimStep *step, long n, float *restrict w, const float *restrict g,
+    float *restrict m, float *restrict v
+) {
+    const __m256 lr = _mm256_set1_ps(step->learning_rate);
+    const __m256 b1 = _mm256_set1_ps(step->beta1), c1 = _mm256_set1_ps(1.0f - step->beta1);
+    const __m256 b2 = _mm256_set1_ps(step->beta2), c2 = _mm256_set1_ps(1.0f - step->beta2);
+    const __m256 v_scale = _mm256_set1_ps(step->v_scale);
+    const __m256 eps = _mm256_set1_ps(step->epsilon);
+
+    long i = 0;
+
+    switch (step->rule) {
+    case OPTIM_SGD:
+        for (; i + 8 <= n; i += 8) {
+            __m256 wi = _mm256_fnmadd_ps(lr, _mm256_loadu_ps(&g[i]), _mm256_loadu_ps(&w[i]));
+            _mm256_storeu_ps(&w[i], wi);
+        }
+        break;
+
+    case OPTIM_MOMENTUM:
+        for (; i + 8 <= n; i += 8) {
+            __m256 gi = _mm256_loadu_ps(&g[i]);
+            __m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(&m[i]), _mm256_mul_ps(c1, gi));
+            _mm256_storeu_ps(&m[i], mi);
+            _mm256_storeu_ps(&w[i], _mm256_fnmadd_ps(lr, mi, _mm256_loadu_ps(&w[i])));
+        }
+        break;
+
+    case OPTIM_ADAGRAD:
+    case OPTIM_RMSPROP:
+        for (; i + 8 <= n; i += 8) {
+            __m256 gi = _mm256_loadu_ps(&g[i]);
+            __m256 vi = _mm256_loadu_ps(&v[i]);
+            vi = (step->rule == OPTIM_ADAGRAD) ? _mm256_fmadd_ps(gi, gi, vi)
+                : _mm256_fmadd_ps(b2, vi, _mm256_mul_ps(c2, _mm256_mul_ps(gi, gi)));
+            _mm256_storeu_ps(&v[i], vi);
+
+            __m256 upd = _mm256_div_ps(_mm256_mul_ps(lr, gi), _mm256_add_ps(_mm256_sqrt_ps(vi), eps));
+            _mm256_storeu_ps(&w[i], _mm256_sub_ps(_mm256_loadu_ps(&w[i]), upd));
+        }
+        break;
+
+    case OPTIM_ADAM:
+        for (; i + 8 <= n; i += 8) {
+            __m256 gi = _mm256_loadu_ps(&g[i]);
+            __m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(&m[i]), _mm256_mul_ps(c1, gi));
+            __m256 vi = _mm256_fmadd_ps(b2, _mm256_loadu_ps(&v[i]), _mm256_mul_ps(c2, _mm256_mul_ps(gi, gi)));
+            _mm256_storeu_ps(&m[i], mi);
+            _mm256_storeu_ps(&v[i], vi);
+
+            __m256 denom = _mm256_fmadd_ps(_mm256_sqrt_ps(vi), v_scale, eps);
+            __m256 upd = _mm256_div_ps(_mm256_mul_ps(lr, mi), denom);
+            _mm256_storeu_ps(&w[i], _mm256_sub_ps(_mm256_loadu_ps(&w[i]), upd));
+        }
+        break;
+    }
+
+    if (i < n) {
+        kernels_scalar.optim_step(step, n - i, &w[i], &g[i], m ? &m[i] : NULL, v ? &v[i] : NULL);
+    }
+}
+
+
+TARGET
+static int32_t hsum_epi32_avx2(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+
+// vpmaddubsw multiplies 32 unsigned by 32 signed bytes into 16-bit pair
+// sums; vpmaddwd against ones widens them to eight 32-bit lanes
+TARGET
+static __m256i qdot_step_avx2(__m256i acc, const uint8_t *x, __m256i w) {
+    __m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)x), w);
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+}
+
+
+// Samples are taken in tiles that stay in cache while every weight row
+// passes over them, four samples per row load
+TARGET
+static void qgemm_avx2(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+    const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc
+) {
+    for (int b0 = 0; b0 < batch; b0 += QGEMM_TILE) {
+        int b1 = (batch - b0 < QGEMM_TILE) ? batch : b0 + QGEMM_TILE;
+
+        for (int i = 0; i < m; ++i) {
+            const int8_t *wi = &w[(long)i * ldw];
+
+            int b = b0;
+            for (; b + 4 <= b1; b += 4) {
+                const uint8_t *x0 = &x[(long)b * ldx];
+                __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+                __m256i s2 = _mm256_setzero_si256(), s3 = _mm256_setzero_si256();
+
+                for (int j = 0; j < k; j += 32) {
+                    __m256i wv = _mm256_loadu_si256((const __m256i *)&wi[j]);
+                    s0 = qdot_step_avx2(s0, &x0[j], wv);
+                    s1 = qdot_step_avx2(s1, &x0[ldx + j], wv);
+                    s2 = qdot_step_avx2(s2, &x0[2 * ldx + j], wv);
+                    s3 = qdot_step_avx2(s3, &x0[3 * ldx + j], wv);
+                }
+
+                c[(long)b * ldc + i] = hsum_epi32_avx2(s0);
+                c[(long)(b + 1) * ldc + i] = hsum_epi32_avx2(s1);
+                c[(long)(b + 2) * ldc + i] = hsum_epi32_avx2(s2);
+                c[(long)(b + 3) * ldc + i] = hsum_epi32_avx2(s3);
+            }
+
+            for (; b < b1; ++b) {
+                __m256i s0 = _mm256_setzero_si256();
+                for (int j = 0; j < k; j += 32) {
+                    s0 = qdot_step_avx2(s0, &x[(long)b * ldx + j], _mm256_loadu_si256((const __m256i *)&wi[j]));
+                }
+                c[(long)b * ldc + i] = hsum_epi32_avx2(s0);
+            }
+        }
+    }
+}
+
+
+// Widens 8 f16 or bf16 weights to fp32
+TARGET_F16C
+static __m256 load_half8_avx2(int type, const uint16_t *w) {
+    __m128i h = _mm_loadu_si128((const __m128i *)w);
+    if (type == HALF_BF16) return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    return _mm256_cvtph_ps(h);
+}
+
+
+// Tiled like qgemm_avx2; the k % 8 tail uses masked loads of x against a
+// zero-padded copy of the last weights
+TARGET_F16C
+static void hgemm_avx2(int type, int batch, int m, int k, const float *restrict x, int ldx,
+    const uint16_t *restrict w, int ldw, float *restrict c, int ldc
+) {
+    const int kv = k & ~7;
+    const int tail = k - kv;
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(tail), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    for (int b0 = 0; b0 < batch; b0 += HGEMM_TILE) {
+        int b1 = (batch - b0 < HGEMM_TILE) ? batch : b0 + HGEMM_TILE;
+
+        for (int i = 0; i < m; ++i) {
+            const uint16_t *wi = &w[(long)i * ldw];
+            uint16_t last[8] = { 0 };
+            for (int j = 0; j < tail; ++j) last[j] = wi[kv + j];
+            const __m256 wt = load_half8_avx2(type, last);
+
+            int b = b0;
+            for (; b + 4 <= b1; b += 4) {
+                const float *x0 = &x[(long)b * ldx];
+                __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+                __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+
+                for (int j = 0; j < kv; j += 8) {
+                    __m256 wv = load_half8_avx2(type, &wi[j]);
+                    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x0[j]), wv, s0);
+                    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(&x0[ldx + j]), wv, s1);
+                    s2 = _mm256_fmadd_ps(_mm256_loadu_ps(&x0[2 * ldx + j]), wv, s2);
+                    s3 = _mm256_fmadd_ps(_mm256_loadu_ps(&x0[3 * ldx + j]), wv, s3);
+                }
+
+                if (tail) {
+                    s0 = _mm256_fmadd_ps(_mm256_maskload_ps(&x0[kv], mask), wt, s0);
+                    s1 = _mm256_fmadd_ps(_mm256_maskload_ps(&x0[ldx + kv], mask), wt, s1);
+                    s2 = _mm256_fmadd_ps(_mm256_maskload_ps(&x0[2 * ldx + kv], mask), wt, s2);
+                    s3 = _mm256_fmadd_ps(_mm256_maskload_ps(&x0[3 * ldx + kv], mask), wt, s3);
+                }
+
+                c[(long)b * ldc + i] = hsum_avx2(s0);
+                c[(long)(b + 1) * ldc + i] = hsum_avx2(s1);
+                c[(long)(b + 2) * ldc + i] = hsum_avx2(s2);
+                c[(long)(b + 3) * ldc + i] = hsum_avx2(s3);
+            }
+
+            for (; b < b1; ++b) {
+                const float *xb = &x[(long)b * ldx];
+                __m256 s0 = _mm256_setzero_ps();
+                for (int j = 0; j < kv; j += 8) {
+                    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(&xb[j]), load_half8_avx2(type, &wi[j]), s0);
+                }
+                if (tail) s0 = _mm256_fmadd_ps(_mm256_maskload_ps(&xb[kv], mask), wt, s0);
+                c[(long)b * ldc + i] = hsum_avx2(s0);
+            }
+        }
+    }
+}
+
+
+// Lanes [0, k) of a mask for maskload/maskstore
+TARGET
+static __m256i tail_mask_avx2(int k) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(k), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+
+// The first k lanes of p, the others set to fill
+TARGET
+static __m256 load_tail_avx2(const float *p, int k, float fill) {
+    __m256i mask = tail_mask_avx2(k);
+    return _mm256_blendv_ps(_mm256_set1_ps(fill), _mm256_maskload_ps(p, mask), _mm256_castsi256_ps(mask));
+}
+
+
+// Clamping keeps NaN, since min/max return their second operand for it.
+// 2^n is applied in two halves so that n in [-150, 128] stays representable
+// and results in the subnormal range round once.
+TARGET
+static inline __m256 exp_avx2(__m256 x, int fast) {
+    x = _mm256_min_ps(_mm256_set1_ps(EXP_MAX), _mm256_max_ps(_mm256_set1_ps(EXP_MIN), x));
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO), r);
+
+    __m256 p;
+    if (fast) {
+        p = _mm256_fmadd_ps(_mm256_set1_ps(EXP_FAST_P2), r, _mm256_set1_ps(EXP_FAST_P1));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_FAST_P0));
+    } else {
+        p = _mm256_fmadd_ps(_mm256_set1_ps(EXP_P4), r, _mm256_set1_ps(EXP_P3));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P0));
+    }
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    __m256i e = _mm256_cvtps_epi32(n);
+    __m256i e1 = _mm256_srai_epi32(e, 1);
+    __m256i e2 = _mm256_sub_epi32(e, e1);
+    __m256 s1 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(e1, _mm256_set1_epi32(127)), 23));
+    __m256 s2 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(e2, _mm256_set1_epi32(127)), 23));
+
+    return _mm256_mul_ps(_mm256_mul_ps(p, s1), s2);
+}
+
+
+// Subnormal inputs are scaled into the normal range first
+TARGET
+static inline __m256 log_avx2(__m256 x, int fast) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 tiny = _mm256_cmp_ps(x, _mm256_set1_ps(0x1p-126f), _CMP_LT_OQ);
+    __m256 xs = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(0x1p23f)), tiny);
+    __m256i bits = _mm256_castps_si256(xs);
+
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    e = _mm256_sub_ps(e, _mm256_and_ps(tiny, _mm256_set1_ps(23.0f)));
+
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)),
+        _mm256_set1_epi32(0x3f800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, one));
+
+    __m256 t = _mm256_sub_ps(m, one);
+    __m256 p;
+    if (fast) {
+        p = _mm256_fmadd_ps(_mm256_set1_ps(LOG_FAST_P4), t, _mm256_set1_ps(LOG_FAST_P3));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_FAST_P2));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_FAST_P1));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_FAST_P0));
+    } else {
+        p = _mm256_fmadd_ps(_mm256_set1_ps(LOG_P8), t, _mm256_set1_ps(LOG_P7));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P6));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P5));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P4));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P3));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P2));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P1));
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P0));
+    }
+
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 y = _mm256_mul_ps(_mm256_mul_ps(t2, t), p);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(LN2_LO), y);
+    y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), t2, y);
+    y = _mm256_add_ps(y, t);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(LN2_HI), y);
+
+    y = _mm256_blendv_ps(y, x, _mm256_cmp_ps(x, _mm256_set1_ps(INFINITY), _CMP_EQ_OQ));
+    y = _mm256_blendv_ps(y, _mm256_set1_ps(-INFINITY), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ));
+    return _mm256_blendv_ps(y, _mm256_set1_ps(NAN), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NGE_UQ));
+}
+
+
+TARGET
+static inline __m256 sigmoid_avx2(__m256 x, int fast) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 d = _mm256_add_ps(one, exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x), fast));
+
+    if (!fast) return _mm256_div_ps(one, d);
+
+    // One Newton step on the 12-bit reciprocal estimate; d = inf gives 0
+    __m256 r = _mm256_rcp_ps(d);
+    r = _mm256_mul_ps(r, _mm256_fnmadd_ps(d, r, _mm256_set1_ps(2.0f)));
+    return _mm256_and_ps(r, _mm256_cmp_ps(d, _mm256_set1_ps(INFINITY), _CMP_NEQ_UQ));
+}
+
+
+TARGET
+static inline __m256 activ_avx2(int op, __m256 v, int fast) {
+    if (op == ACTIV_RELU) return _mm256_max_ps(v, _mm256_setzero_ps());
+    if (op == ACTIV_SIGMOID) return sigmoid_avx2(v, fast);
+    return v;
+}
+
+
+TARGET
+static void bias_activ_avx2(int op, int rows, int cols, const float *bias, float *c, int ldc, float *out, int ldo) {
+    const int fast = kernel_math_fast();
+    const int activ = op != ACTIV_SOFTMAX;
+    const __m256i tail = tail_mask_avx2(cols % 8);
+    const int body = cols - cols % 8;
+
+    for (int r = 0; r < rows; ++r) {
+        float *cr = &c[(long)r * ldc];
+        float *yr = &out[(long)r * ldo];
+
+        for (int j = 0; j < body; j += 8) {
+            __m256 v = _mm256_loadu_ps(&cr[j]);
+            if (bias) {
+                v = _mm256_add_ps(v, _mm256_loadu_ps(&bias[j]));
+                _mm256_storeu_ps(&cr[j], v);
+            }
+            if (activ) {
+                _mm256_storeu_ps(&yr[j], activ_avx2(op, v, fast));
+            }
+        }
+
+        if (body < cols) {
+            __m256 v = _mm256_maskload_ps(&cr[body], tail);
+            if (bias) {
+                v = _mm256_add_ps(v, _mm256_maskload_ps(&bias[body], tail));
+                _mm256_maskstore_ps(&cr[body], tail, v);
+            }
+            if (activ) {
+                _mm256_maskstore_ps(&yr[body], tail, activ_avx2(op, v, fast));
+            }
+        }
+    }
+}
+
+
+TARGET
+static void activ_grad_avx2(int op, long n, const float *restrict a, float *restrict d) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    long i = 0;
+
+    switch (op) {
+    case ACTIV_RELU:
+        for (; i + 8 <= n; i += 8) {
+            __m256 keep = _mm256_cmp_ps(_mm256_loadu_ps(&a[i]), zero, _CMP_GT_OQ);
+            _mm256_storeu_ps(&d[i], _mm256_and_ps(keep, _mm256_loadu_ps(&d[i])));
+        }
+        break;
+    case ACTIV_SIGMOID:
+        for (; i + 8 <= n; i += 8) {
+            __m256 ai = _mm256_loadu_ps(&a[i]);
+            __m256 grad = _mm256_mul_ps(ai, _mm256_sub_ps(one, ai));
+            _mm256_storeu_ps(&d[i], _mm256_mul_ps(_mm256_loadu_ps(&d[i]), grad));
+        }
+        break;
+    }
+
+    if (i < n) {
+        kernels_scalar.activ_grad(op, n - i, &a[i], &d[i]);
+    }
+}
+
+
+TARGET
+static void vexp_avx2(long n, const float *x, float *y) {
+    const int fast = kernel_math_fast();
+
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(&y[i], exp_avx2(_mm256_loadu_ps(&x[i]), fast));
+    }
+    if (i < n) {
+        __m256i mask = tail_mask_avx2((int)(n - i));
+        _mm256_maskstore_ps(&y[i], mask, exp_avx2(_mm256_maskload_ps(&x[i], mask), fast));
+    }
+}
+
+
+TARGET
+static void vlog_avx2(long n, const float *x, float *y) {
+    const int fast = kernel_math_fast();
+
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(&y[i], log_avx2(_mm256_loadu_ps(&x[i]), fast));
+    }
+    if (i < n) {
+        __m256i mask = tail_mask_avx2((int)(n - i));
+        _mm256_maskstore_ps(&y[i], mask, log_avx2(load_tail_avx2(&x[i], (int)(n - i), 1.0f), fast));
+    }
+}
+
+
+TARGET
+static float hmax_avx2(__m256 v) {
+    __m128 lo = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_max_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_max_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+
+// One step of the online softmax: lane maxima and sums absorbing v
+TARGET
+static inline void softmax_step_avx2(__m256 v, __m256 *vmax, __m256 *vsum, int fast) {
+    __m256 m = _mm256_max_ps(*vmax, v);
+    *vsum = _mm256_fmadd_ps(*vsum, exp_avx2(_mm256_sub_ps(*vmax, m), fast), exp_avx2(_mm256_sub_ps(v, m), fast));
+    *vmax = m;
+}
+
+
+// Maximum of x, with the sum of exp(x - max) in one online pass. Each lane
+// keeps its own running maximum and sum, merged at the end. The maxima
+// start at -FLT_MAX so that -inf inputs and tail padding add zero.
+TARGET
+static float max_sum_avx2(int n, const float *x, float *sum, int fast) {
+    const int body = n - n % 8;
+
+    __m256 vmax = _mm256_set1_ps(-FLT_MAX);
+    __m256 vsum = _mm256_setzero_ps();
+
+    for (int i = 0; i < body; i += 8) {
+        softmax_step_avx2(_mm256_loadu_ps(&x[i]), &vmax, &vsum, fast);
+    }
+    if (body < n) {
+        softmax_step_avx2(load_tail_avx2(&x[body], n % 8, -INFINITY), &vmax, &vsum, fast);
+    }
+
+    float max = hmax_avx2(vmax);
+    *sum = hsum_avx2(_mm256_mul_ps(vsum, exp_avx2(_mm256_sub_ps(vmax, _mm256_set1_ps(max)), fast)));
+    return max;
+}
+
+
+TARGET
+static void softmax_avx2(int n, const float *restrict x, float *restrict y) {
+    const int fast = kernel_math_fast();
+    const int body = n - n % 8;
+    const __m256i tail = tail_mask_avx2(n % 8);
+
+    float sum;
+    __m256 vm = _mm256_set1_ps(max_sum_avx2(n, x, &sum, fast));
+    __m256 vs = _mm256_set1_ps(sum);
+    __m256 inv = _mm256_set1_ps(1.0f / sum);
+
+    for (int i = 0; i < body; i += 8) {
+        __m256 e = exp_avx2(_mm256_sub_ps(_mm256_loadu_ps(&x[i]), vm), fast);
+        _mm256_storeu_ps(&y[i], fast ? _mm256_mul_ps(e, inv) : _mm256_div_ps(e, vs));
+    }
+    if (body < n) {
+        __m256 e = exp_avx2(_mm256_sub_ps(_mm256_maskload_ps(&x[body], tail), vm), fast);
+        _mm256_maskstore_ps(&y[body], tail, fast ? _mm256_mul_ps(e, inv) : _mm256_div_ps(e, vs));
+    }
+}
+
+
+TARGET
+static float logsumexp_avx2(int n, const float *x) {
+    float sum;
+    const float max = max_sum_avx2(n, x, &sum, kernel_math_fast());
+    return max + logf(sum);
+}
+
+
+// The loss terms are masked to the lanes where y is nonzero, so that -inf
+// logits with zero targets add nothing
+TARGET
+static inline __m256 xent_step_avx2(__m256 z, __m256 yi, __m256 vl, __m256 vscale, __m256 *loss,
+    __m256 *p, int fast
+) {
+    *p = exp_avx2(_mm256_sub_ps(z, vl), fast);
+    __m256 term = _mm256_mul_ps(yi, _mm256_sub_ps(vl, z));
+    *loss = _mm256_add_ps(*loss, _mm256_and_ps(term, _mm256_cmp_ps(yi, _mm256_setzero_ps(), _CMP_NEQ_UQ)));
+    return _mm256_mul_ps(vscale, _mm256_sub_ps(*p, yi));
+}
+
+
+TARGET
+static float softmax_xent_avx2(int n, const float *restrict z, const float *restrict y, int label, float scale,
+    float *restrict p, float *restrict d
+) {
+    const int fast = kernel_math_fast();
+    const int body = n - n % 8;
+    const __m256i tail = tail_mask_avx2(n % 8);
+    const __m256 zero = _mm256_setzero_ps();
+
+    float sum;
+    const float max = max_sum_avx2(n, z, &sum, fast);
+    const float lse = max + logf(sum);
+
+    __m256 vl = _mm256_set1_ps(lse);
+    __m256 vscale = _mm256_set1_ps(scale);
+    __m256 loss = zero;
+    __m256 pi;
+
+    for (int i = 0; i < body; i += 8) {
+        __m256 yi = y ? _mm256_loadu_ps(&y[i]) : zero;
+        _mm256_storeu_ps(&d[i], xent_step_avx2(_mm256_loadu_ps(&z[i]), yi, vl, vscale, &loss, &pi, fast));
+        _mm256_storeu_ps(&p[i], pi);
+    }
+    if (body < n) {
+        __m256 yi = y ? _mm256_maskload_ps(&y[body], tail) : zero;
+        __m256 di = xent_step_avx2(_mm256_maskload_ps(&z[body], tail), yi, vl, vscale, &loss, &pi, fast);
+        _mm256_maskstore_ps(&d[body], tail, di);
+        _mm256_maskstore_ps(&p[body], tail, pi);
+    }
+
+    if (!y) {
+        d[label] -= scale;
+        return lse - z[label];
+    }
+
+    return hsum_avx2(loss);
+}
+
+
+TARGET
+static inline __m256 bce_terms_avx2(__m256 y, __m256 p, float eps, int fast) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    p = _mm256_min_ps(_mm256_set1_ps(1.0f - eps), _mm256_max_ps(_mm256_set1_ps(eps), p));
+
+    return _mm256_fmadd_ps(y, log_avx2(p, fast), _mm256_mul_ps(_mm256_sub_ps(one, y), log_avx2(_mm256_sub_ps(one, p), fast)));
+}
+
+
+TARGET
+static float bce_sum_avx2(int n, const float *restrict y, const float *restrict p, float eps) {
+    const int fast = kernel_math_fast();
+    const int body = n - n % 8;
+
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int i = 0; i < body; i += 8) {
+        acc = _mm256_add_ps(acc, bce_terms_avx2(_mm256_loadu_ps(&y[i]), _mm256_loadu_ps(&p[i]), eps, fast));
+    }
+
+    // Padding lanes have y = 0 and p = 1/2 and are masked out of the sum
+    if (body < n) {
+        __m256 terms = bce_terms_avx2(load_tail_avx2(&y[body], n % 8, 0.0f), load_tail_avx2(&p[body], n % 8, 0.5f), eps, fast);
+        acc = _mm256_add_ps(acc, _mm256_and_ps(terms, _mm256_castsi256_ps(tail_mask_avx2(n % 8))));
+    }
+
+    return hsum_avx2(acc);
+}
+
+
+const KernelTable kernels_avx2 = {
+    .name = "avx2",
+    .mr = MR,
+    .nr = NR,
+    .ukernel = ukernel_avx2,
+    .sdot = sdot_avx2,
+    .saxpy = saxpy_avx2,
+    .sgemv = sgemv_avx2,
+    .optim_step = optim_step_avx2,
+    .qgemm = qgemm_avx2,
+    .hgemm = hgemm_avx2,
+    .bias_activ = bias_activ_avx2,
+    .activ_grad = activ_grad_avx2,
+    .vexp = vexp_avx2,
+    .vlog = vlog_avx2,
+    .softmax = softmax_avx2,
+    .logsumexp = logsumexp_avx2,
+    .softmax_xent = softmax_xent_avx2,
+    .bce_sum = bce_sum_avx2,
+};
+
+#endif
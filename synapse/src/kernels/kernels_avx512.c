@@ -0,0 +1,712 @@
+#include "kernels.h"
+
+#ifdef KERNELS_X86
+
+#include <immintrin.h>
+#include <float.h>
+#include <math.h>
+
+#define TARGET __attribute__((target("avx512f")))
+#define TARGET_BW __attribute__((target("avx512f,avx512bw")))
+#define TARGET_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni")))
+
+#define MR 8
+#define NR 32
+
+#define QGEMM_TILE 32
+#define HGEMM_TILE 8
+
+
+TARGET
+static void ukernel_avx512(int kc, const float *restrict a, const float *restrict b, float *restrict c, int ldc) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+
+    for (int p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_load_ps(&b[p * NR]);
+        __m512 b1 = _mm512_load_ps(&b[p * NR + 16]);
+        const float *ap = &a[p * MR];
+        __m512 x;
+
+        x = _mm512_set1_ps(ap[0]);
+        c00 = _mm512_fmadd_ps(x, b0, c00); c01 = _mm512_fmadd_ps(x, b1, c01);
+        x = _mm512_set1_ps(ap[1]);
+        c10 = _mm512_fmadd_ps(x, b0, c10); c11 = _mm512_fmadd_ps(x, b1, c11);
+        x = _mm512_set1_ps(ap[2]);
+        c20 = _mm512_fmadd_ps(x, b0, c20); c21 = _mm512_fmadd_ps(x, b1, c21);
+        x = _mm512_set1_ps(ap[3]);
+        c30 = _mm512_fmadd_ps(x, b0, c30); c31 = _mm512_fmadd_ps(x, b1, c31);
+        x = _mm512_set1_ps(ap[4]);
+        c40 = _mm512_fmadd_ps(x, b0, c40); c41 = _mm512_fmadd_ps(x, b1, c41);
+        x = _mm512_set1_ps(ap[5]);
+        c50 = _mm512_fmadd_ps(x, b0, c50); c51 = _mm512_fmadd_ps(x, b1, c51);
+        x = _mm512_set1_ps(ap[6]);
+        c60 = _mm512_fmadd_ps(x, b0, c60); c61 = _mm512_fmadd_ps(x, b1, c61);
+        x = _mm512_set1_ps(ap[7]);
+        c70 = _mm512_fmadd_ps(x, b0, c70); c71 = _mm512_fmadd_ps(x, b1, c71);
+    }
+
+#define STORE_ROW(r, lo, hi) \
+    _mm512_storeu_ps(&c[(r) * ldc], _mm512_add_ps(_mm512_loadu_ps(&c[(r) * ldc]), lo)); \
+    _mm512_storeu_ps(&c[(r) * ldc + 16], _mm512_add_ps(_mm512_loadu_ps(&c[(r) * ldc + 16]), hi));
+
+    STORE_ROW(0, c00, c01);
+    STORE_ROW(1, c10, c11);
+    STORE_ROW(2, c20, c21);
+    STORE_ROW(3, c30, c31);
+    STORE_ROW(4, c40, c41);
+    STORE_ROW(5, c50, c51);
+    STORE_ROW(6, c60, c61);
+    STORE_ROW(7, c70, c71);
+
+#undef STORE_ROW
+}
+
+
+TARGET
+static float sdot_avx512(int n, const float *restrict x, const float *restrict y) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(&x[i]), _mm512_loadu_ps(&y[i]), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(&x[i + 16]), _mm512_loadu_ps(&y[i + 16]), acc1);
+    }
+    for (; i < n; i += 16) {
+        __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &x[i]), _mm512_maskz_loadu_ps(mask, &y[i]), acc0);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+
+TARGET
+static void saxpy_avx512(int n, float alpha, const float *restrict x, float *restrict y) {
+    __m512 a = _mm512_set1_ps(alpha);
+
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 v = _mm512_fmadd_ps(a, _mm512_maskz_loadu_ps(mask, &x[i]), _mm512_maskz_loadu_ps(mask, &y[i]));
+        _mm512_mask_storeu_ps(&y[i], mask, v);
+    }
+}
+
+
+// Four rows at a time so every load of x feeds four accumulators
+TARGET
+static void sgemv_avx512(int m, int n, const float *restrict a, int lda, const float *restrict x,
+    float *restrict y, int accumulate
+) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        const float *a0 = &a[(long)i * lda];
+        const float *a1 = a0 + lda;
+        const float *a2 = a1 + lda;
+        const float *a3 = a2 + lda;
+
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+
+        for (int j = 0; j < n; j += 16) {
+            __mmask16 mask = (n - j >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - j)) - 1);
+            __m512 v = _mm512_maskz_loadu_ps(mask, &x[j]);
+            s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &a0[j]), v, s0);
+            s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &a1[j]), v, s1);
+            s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &a2[j]), v, s2);
+            s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &a3[j]), v, s3);
+        }
+
+        float r0 = _mm512_reduce_add_ps(s0), r1 = _mm512_reduce_add_ps(s1);
+        float r2 = _mm512_reduce_add_ps(s2), r3 = _mm512_reduce_add_ps(s3);
+
+        if (accumulate) {
+            y[i] += r0; y[i + 1] += r1; y[i + 2] += r2; y[i + 3] += r3;
+        } else {
+            y[i] = r0; y[i + 1] = r1; y[i + 2] = r2; y[i + 3] = r3;
+        }
+    }
+
+    for (; i < m; ++i) {
+        float sum = sdot_avx512(n, &a[(long)i * lda], x);
+        y[i] = accumulate ? y[i] + sum : sum;
+    }
+}
+
+
+// Sixteen lanes per iteration with a masked tail
+TARGET
+static void optim_step_avx512(const OptimStep *step, long n, float *restrict w, const float *restrict g,
+    float *restrict m, float *restrict v
+) {
+    const __m512 lr = _mm512_set1_ps(step->learning_rate);
+    const __m512 b1 = _mm512_set1_ps(step->beta1), c1 = _mm512_set1_ps(1.0f - step->beta1);
+    const __m512 b2 = _mm512_set1_ps(step->beta2), c2 = _mm512_set1_ps(1.0f - step->beta2);
+    const __m512 v_scale = _mm512_set1_ps(step->v_scale);
+    const __m512 eps = _mm512_set1_ps(step->epsilon);
+
+    for (long i = 0; i < n; i += 16) {
+        __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 gi = _mm512_maskz_loadu_ps(mask, &g[i]);
+        __m512 wi = _mm512_maskz_loadu_ps(mask, &w[i]);
+        __m512 mi, vi;
+
+        switch (step->rule) {
+        case OPTIM_SGD:
+            wi = _mm512_fnmadd_ps(lr, gi, wi);
+            break;
+
+        case OPTIM_MOMENTUM:
+            mi = _mm512_fmadd_ps(b1, _mm512_maskz_loadu_ps(mask, &m[i]), _mm512_mul_ps(c1, gi));
+            _mm512_mask_storeu_ps(&m[i], mask, mi);
+            wi = _mm512_fnmadd_ps(lr, mi, wi);
+            break;
+
+        case OPTIM_ADAGRAD:
+        case OPTIM_RMSPROP:
+            vi = _mm512_maskz_loadu_ps(mask, &v[i]);
+            vi = (step->rule == OPTIM_ADAGRAD) ? _mm512_fmadd_ps(gi, gi, vi)
+                : _mm512_fmadd_ps(b2, vi, _mm512_mul_ps(c2, _mm512_mul_ps(gi, gi)));
+            _mm512_mask_storeu_ps(&v[i], mask, vi);
+            wi = _mm512_sub_ps(wi, _mm512_div_ps(_mm512_mul_ps(lr, gi), _mm512_add_ps(_mm512_sqrt_ps(vi), eps)));
+            break;
+
+        case OPTIM_ADAM:
+            mi = _mm512_fmadd_ps(b1, _mm512_maskz_loadu_ps(mask, &m[i]), _mm512_mul_ps(c1, gi));
+            vi = _mm512_fmadd_ps(b2, _mm512_maskz_loadu_ps(mask, &v[i]), _mm512_mul_ps(c2, _mm512_mul_ps(gi, gi)));
+            _mm512_mask_storeu_ps(&m[i], mask, mi);
+            _mm512_mask_storeu_ps(&v[i], mask, vi);
+            wi = _mm512_sub_ps(wi, _mm512_div_ps(_mm512_mul_ps(lr, mi), _mm512_fmadd_ps(_mm512_sqrt_ps(vi), v_scale, eps)));
+            break;
+        }
+
+        _mm512_mask_storeu_ps(&w[i], mask, wi);
+    }
+}
+
+
+// Same loop structure as qgemm_avx2(), 64 bytes per step. Needs AVX-512BW
+// on top of the AVX-512F of the rest of this table; dispatch checks it.
+TARGET_BW
+static __m512i qdot_step_avx512bw(__m512i acc, const uint8_t *x, __m512i w) {
+    __m512i pairs = _mm512_maddubs_epi16(_mm512_loadu_si512(x), w);
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(pairs, _mm512_set1_epi16(1)));
+}
+
+
+TARGET_BW
+static void qgemm_avx512bw(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+    const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc
+) {
+    for (int b0 = 0; b0 < batch; b0 += QGEMM_TILE) {
+        int b1 = (batch - b0 < QGEMM_TILE) ? batch : b0 + QGEMM_TILE;
+
+        for (int i = 0; i < m; ++i) {
+            const int8_t *wi = &w[(long)i * ldw];
+
+            int b = b0;
+            for (; b + 4 <= b1; b += 4) {
+                const uint8_t *x0 = &x[(long)b * ldx];
+                __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+                __m512i s2 = _mm512_setzero_si512(), s3 = _mm512_setzero_si512();
+
+                for (int j = 0; j < k; j += 64) {
+                    __m512i wv = _mm512_loadu_si512(&wi[j]);
+                    s0 = qdot_step_avx512bw(s0, &x0[j], wv);
+                    s1 = qdot_step_avx512bw(s1, &x0[ldx + j], wv);
+                    s2 = qdot_step_avx512bw(s2, &x0[2 * ldx + j], wv);
+                    s3 = qdot_step_avx512bw(s3, &x0[3 * ldx + j], wv);
+                }
+
+                c[(long)b * ldc + i] = _mm512_reduce_add_epi32(s0);
+                c[(long)(b + 1) * ldc + i] = _mm512_reduce_add_epi32(s1);
+                c[(long)(b + 2) * ldc + i] = _mm512_reduce_add_epi32(s2);
+                c[(long)(b + 3) * ldc + i] = _mm512_reduce_add_epi32(s3);
+            }
+
+            for (; b < b1; ++b) {
+                __m512i s0 = _mm512_setzero_si512();
+                for (int j = 0; j < k; j += 64) {
+                    s0 = qdot_step_avx512bw(s0, &x[(long)b * ldx + j], _mm512_loadu_si512(&wi[j]));
+                }
+                c[(long)b * ldc + i] = _mm512_reduce_add_epi32(s0);
+            }
+        }
+    }
+}
+
+
+// VNNI fuses the multiply, pair sum and accumulation into vpdpbusd
+TARGET_VNNI
+static __m512i qdot_step_avx512_vnni(__m512i acc, const uint8_t *x, __m512i w) {
+    return _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(x), w);
+}
+
+
+TARGET_VNNI
+void qgemm_avx512_vnni(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+    const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc
+) {
+    for (int b0 = 0; b0 < batch; b0 += QGEMM_TILE) {
+        int b1 = (batch - b0 < QGEMM_TILE) ? batch : b0 + QGEMM_TILE;
+
+        for (int i = 0; i < m; ++i) {
+            const int8_t *wi = &w[(long)i * ldw];
+
+            int b = b0;
+            for (; b + 4 <= b1; b += 4) {
+                const uint8_t *x0 = &x[(long)b * ldx];
+                __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+                __m512i s2 = _mm512_setzero_si512(), s3 = _mm512_setzero_si512();
+
+                for (int j = 0; j < k; j += 64) {
+                    __m512i wv = _mm512_loadu_si512(&wi[j]);
+                    s0 = qdot_step_avx512_vnni(s0, &x0[j], wv);
+                    s1 = qdot_step_avx512_vnni(s1, &x0[ldx + j], wv);
+                    s2 = qdot_step_avx512_vnni(s2, &x0[2 * ldx + j], wv);
+                    s3 = qdot_step_avx512_vnni(s3, &x0[3 * ldx + j], wv);
+                }
+
+                c[(long)b * ldc + i] = _mm512_reduce_add_epi32(s0);
+                c[(long)(b + 1) * ldc + i] = _mm512_reduce_add_epi32(s1);
+                c[(long)(b + 2) * ldc + i] = _mm512_reduce_add_epi32(s2);
+                c[(long)(b + 3) * ldc + i] = _mm512_reduce_add_epi32(s3);
+            }
+
+            for (; b < b1; ++b) {
+                __m512i s0 = _mm512_setzero_si512();
+                for (int j = 0; j < k; j += 64) {
+                    s0 = qdot_step_avx512_vnni(s0, &x[(long)b * ldx + j], _mm512_loadu_si512(&wi[j]));
+                }
+                c[(long)b * ldc + i] = _mm512_reduce_add_epi32(s0);
+            }
+        }
+    }
+}
+
+
+// Widens 16 f16 or bf16 weights to fp32
+TARGET
+static __m512 load_half16_avx512(int type, const uint16_t *w) {
+    __m256i h = _mm256_loadu_si256((const __m256i *)w);
+    if (type == HALF_BF16) return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+    return _mm512_cvtph_ps(h);
+}
+
+
+// Dot products of one weight row with samples [b, b1), four at a time
+TARGET
+static void hgemm_row_avx512(int type, int b, int b1, int kv, __mmask16 mask, const float *restrict x, int ldx,
+    const uint16_t *restrict wi, __m512 wt, float *restrict c, int ldc
+) {
+    for (; b + 4 <= b1; b += 4) {
+        const float *x0 = &x[(long)b * ldx];
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+
+        for (int j = 0; j < kv; j += 16) {
+            __m512 wv = load_half16_avx512(type, &wi[j]);
+            s0 = _mm512_fmadd_ps(_mm512_loadu_ps(&x0[j]), wv, s0);
+            s1 = _mm512_fmadd_ps(_mm512_loadu_ps(&x0[ldx + j]), wv, s1);
+            s2 = _mm512_fmadd_ps(_mm512_loadu_ps(&x0[2 * ldx + j]), wv, s2);
+            s3 = _mm512_fmadd_ps(_mm512_loadu_ps(&x0[3 * ldx + j]), wv, s3);
+        }
+
+        s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &x0[kv]), wt, s0);
+        s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &x0[ldx + kv]), wt, s1);
+        s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &x0[2 * ldx + kv]), wt, s2);
+        s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &x0[3 * ldx + kv]), wt, s3);
+
+        c[(long)b * ldc] = _mm512_reduce_add_ps(s0);
+        c[(long)(b + 1) * ldc] = _mm512_reduce_add_ps(s1);
+        c[(long)(b + 2) * ldc] = _mm512_reduce_add_ps(s2);
+        c[(long)(b + 3) * ldc] = _mm512_reduce_add_ps(s3);
+    }
+
+    for (; b < b1; ++b) {
+        const float *xb = &x[(long)b * ldx];
+        __m512 s0 = _mm512_setzero_ps();
+        for (int j = 0; j < kv; j += 16) {
+            s0 = _mm512_fmadd_ps(_mm512_loadu_ps(&xb[j]), load_half16_avx512(type, &wi[j]), s0);
+        }
+        s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &xb[kv]), wt, s0);
+        c[(long)b * ldc] = _mm512_reduce_add_ps(s0);
+    }
+}
+
+
+// Rows are taken in pairs over tiles of samples small enough to stay in L1,
+// so each sample load feeds two rows; the k % 16 tail uses masked loads of x
+// against a zero-padded copy of the last weights
+TARGET
+static void hgemm_avx512(int type, int batch, int m, int k, const float *restrict x, int ldx,
+    const uint16_t *restrict w, int ldw, float *restrict c, int ldc
+) {
+    const int kv = k & ~15;
+    const int tail = k - kv;
+    const __mmask16 mask = (__mmask16)((1u << tail) - 1);
+
+    for (int b0 = 0; b0 < batch; b0 += HGEMM_TILE) {
+        int b1 = (batch - b0 < HGEMM_TILE) ? batch : b0 + HGEMM_TILE;
+
+        int i = 0;
+        for (; i + 2 <= m; i += 2) {
+            const uint16_t *w0 = &w[(long)i * ldw], *w1 = &w[(long)(i + 1) * ldw];
+            uint16_t last[2][16] = { { 0 } };
+            for (int j = 0; j < tail; ++j) {
+                last[0][j] = w0[kv + j];
+                last[1][j] = w1[kv + j];
+            }
+            const __m512 wt0 = load_half16_avx512(type, last[0]), wt1 = load_half16_avx512(type, last[1]);
+
+            int b = b0;
+            for (; b + 4 <= b1; b += 4) {
+                const float *x0 = &x[(long)b * ldx];
+                __m512 s00 = _mm512_setzero_ps(), s01 = _mm512_setzero_ps();
+                __m512 s10 = _mm512_setzero_ps(), s11 = _mm512_setzero_ps();
+                __m512 s20 = _mm512_setzero_ps(), s21 = _mm512_setzero_ps();
+                __m512 s30 = _mm512_setzero_ps(), s31 = _mm512_setzero_ps();
+                __m512 xv;
+
+                for (int j = 0; j < kv; j += 16) {
+                    __m512 wv0 = load_half16_avx512(type, &w0[j]), wv1 = load_half16_avx512(type, &w1[j]);
+                    xv = _mm512_loadu_ps(&x0[j]);
+                    s00 = _mm512_fmadd_ps(xv, wv0, s00); s01 = _mm512_fmadd_ps(xv, wv1, s01);
+                    xv = _mm512_loadu_ps(&x0[ldx + j]);
+                    s10 = _mm512_fmadd_ps(xv, wv0, s10); s11 = _mm512_fmadd_ps(xv, wv1, s11);
+                    xv = _mm512_loadu_ps(&x0[2 * ldx + j]);
+                    s20 = _mm512_fmadd_ps(xv, wv0, s20); s21 = _mm512_fmadd_ps(xv, wv1, s21);
+                    xv = _mm512_loadu_ps(&x0[3 * ldx + j]);
+                    s30 = _mm512_fmadd_ps(xv, wv0, s30); s31 = _mm512_fmadd_ps(xv, wv1, s31);
+                }
+
+                xv = _mm512_maskz_loadu_ps(mask, &x0[kv]);
+                s00 = _mm512_fmadd_ps(xv, wt0, s00); s01 = _mm512_fmadd_ps(xv, wt1, s01);
+                xv = _mm512_maskz_loadu_ps(mask, &x0[ldx + kv]);
+                s10 = _mm512_fmadd_ps(xv, wt0, s10); s11 = _mm512_fmadd_ps(xv, wt1, s11);
+                xv = _mm512_maskz_loadu_ps(mask, &x0[2 * ldx + kv]);
+                s20 = _mm512_fmadd_ps(xv, wt0, s20); s21 = _mm512_fmadd_ps(xv, wt1, s21);
+                xv = _mm512_maskz_loadu_ps(mask, &x0[3 * ldx + kv]);
+                s30 = _mm512_fmadd_ps(xv, wt0, s30); s31 = _mm512_fmadd_ps(xv, wt1, s31);
+
+                float *cb = &c[(long)b * ldc + i];
+                cb[0] = _mm512_reduce_add_ps(s00); cb[1] = _mm512_reduce_add_ps(s01);
+                cb[ldc] = _mm512_reduce_add_ps(s10); cb[ldc + 1] = _mm512_reduce_add_ps(s11);
+                cb[2 * ldc] = _mm512_reduce_add_ps(s20); cb[2 * ldc + 1] = _mm512_reduce_add_ps(s21);
+                cb[3 * ldc] = _mm512_reduce_add_ps(s30); cb[3 * ldc + 1] = _mm512_reduce_add_ps(s31);
+            }
+
+            hgemm_row_avx512(type, b, b1, kv, mask, x, ldx, w0, wt0, &c[i], ldc);
+            hgemm_row_avx512(type, b, b1, kv, mask, x, ldx, w1, wt1, &c[i + 1], ldc);
+        }
+
+        if (i < m) {
+            const uint16_t *wi = &w[(long)i * ldw];
+            uint16_t last[16] = { 0 };
+            for (int j = 0; j < tail; ++j) last[j] = wi[kv + j];
+            hgemm_row_avx512(type, b0, b1, kv, mask, x, ldx, wi, load_half16_avx512(type, last), &c[i], ldc);
+        }
+    }
+}
+
+
+// Lanes [0, k) of a 16-lane mask
+static inline __mmask16 tail_mask16(long k) {
+    return (k >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << k) - 1);
+}
+
+
+// Clamping keeps NaN, since min/max return their second operand for it;
+// vscalefps applies 2^n with gradual underflow.
+TARGET
+static inline __m512 exp_avx512(__m512 x, int fast) {
+    x = _mm512_min_ps(_mm512_set1_ps(EXP_MAX), _mm512_max_ps(_mm512_set1_ps(EXP_MIN), x));
+
+    __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_HI), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_LO), r);
+
+    __m512 p;
+    if (fast) {
+        p = _mm512_fmadd_ps(_mm512_set1_ps(EXP_FAST_P2), r, _mm512_set1_ps(EXP_FAST_P1));
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_FAST_P0));
+    } else {
+        p = _mm512_fmadd_ps(_mm512_set1_ps(EXP_P4), r, _mm512_set1_ps(EXP_P3));
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P0));
+    }
+    p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+
+    return _mm512_scalef_ps(p, n);
+}
+
+
+// vgetexpps and vgetmantps split subnormals as well
+TARGET
+static inline __m512 log_avx512(__m512 x, int fast) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    __m512 e = _mm512_getexp_ps(x);
+    __m512 m = _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero);
+    __mmask16 big = _mm512_cmp_ps_mask(m, _mm512_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm512_mask_mul_ps(m, big, m, _mm512_set1_ps(0.5f));
+    e = _mm512_mask_add_ps(e, big, e, one);
+
+    __m512 t = _mm512_sub_ps(m, one);
+    __m512 p;
+    if (fast) {
+        p = _mm512_fmadd_ps(_mm512_set1_ps(LOG_FAST_P4), t, _mm512_set1_ps(LOG_FAST_P3));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_FAST_P2));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_FAST_P1));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_FAST_P0));
+    } else {
+        p = _mm512_fmadd_ps(_mm512_set1_ps(LOG_P8), t, _mm512_set1_ps(LOG_P7));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P6));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P5));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P4));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P3));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P2));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P1));
+        p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(LOG_P0));
+    }
+
+    __m512 t2 = _mm512_mul_ps(t, t);
+    __m512 y = _mm512_mul_ps(_mm512_mul_ps(t2, t), p);
+    y = _mm512_fmadd_ps(e, _mm512_set1_ps(LN2_LO), y);
+    y = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), t2, y);
+    y = _mm512_add_ps(y, t);
+    y = _mm512_fmadd_ps(e, _mm512_set1_ps(LN2_HI), y);
+
+    y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, _mm512_set1_ps(INFINITY), _CMP_EQ_OQ), x);
+    y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_EQ_OQ), _mm512_set1_ps(-INFINITY));
+    return _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_NGE_UQ), _mm512_set1_ps(NAN));
+}
+
+
+TARGET
+static inline __m512 sigmoid_avx512(__m512 x, int fast) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 d = _mm512_add_ps(one, exp_avx512(_mm512_sub_ps(_mm512_setzero_ps(), x), fast));
+
+    if (!fast) return _mm512_div_ps(one, d);
+
+    // One Newton step on the 14-bit reciprocal estimate; d = inf gives 0
+    __m512 r = _mm512_rcp14_ps(d);
+    r = _mm512_mul_ps(r, _mm512_fnmadd_ps(d, r, _mm512_set1_ps(2.0f)));
+    return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(d, _mm512_set1_ps(INFINITY), _CMP_NEQ_UQ), r);
+}
+
+
+TARGET
+static void bias_activ_avx512(int op, int rows, int cols, const float *bias, float *c, int ldc, float *out, int ldo) {
+    const int fast = kernel_math_fast();
+    const __m512 zero = _mm512_setzero_ps();
+
+    for (int r = 0; r < rows; ++r) {
+        float *cr = &c[(long)r * ldc];
+        float *yr = &out[(long)r * ldo];
+
+        for (int j = 0; j < cols; j += 16) {
+            __mmask16 mask = tail_mask16(cols - j);
+            __m512 v = _mm512_maskz_loadu_ps(mask, &cr[j]);
+            if (bias) {
+                v = _mm512_add_ps(v, _mm512_maskz_loadu_ps(mask, &bias[j]));
+                _mm512_mask_storeu_ps(&cr[j], mask, v);
+            }
+            if (op == ACTIV_RELU) {
+                _mm512_mask_storeu_ps(&yr[j], mask, _mm512_max_ps(v, zero));
+            } else if (op == ACTIV_SIGMOID) {
+                _mm512_mask_storeu_ps(&yr[j], mask, sigmoid_avx512(v, fast));
+            } else if (op == ACTIV_LINEAR) {
+                _mm512_mask_storeu_ps(&yr[j], mask, v);
+            }
+        }
+    }
+}
+
+
+TARGET
+static void activ_grad_avx512(int op, long n, const float *restrict a, float *restrict d) {
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    if (op != ACTIV_RELU && op != ACTIV_SIGMOID) return;
+
+    for (long i = 0; i < n; i += 16) {
+        __mmask16 mask = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 ai = _mm512_maskz_loadu_ps(mask, &a[i]);
+        __m512 di = _mm512_maskz_loadu_ps(mask, &d[i]);
+
+        if (op == ACTIV_RELU) {
+            __mmask16 keep = _mm512_mask_cmp_ps_mask(mask, ai, zero, _CMP_GT_OQ);
+            _mm512_mask_storeu_ps(&d[i], mask, _mm512_maskz_mov_ps(keep, di));
+        } else {
+            _mm512_mask_storeu_ps(&d[i], mask, _mm512_mul_ps(di, _mm512_mul_ps(ai, _mm512_sub_ps(one, ai))));
+        }
+    }
+}
+
+
+TARGET
+static void vexp_avx512(long n, const float *x, float *y) {
+    const int fast = kernel_math_fast();
+
+    for (long i = 0; i < n; i += 16) {
+        __mmask16 mask = tail_mask16(n - i);
+        _mm512_mask_storeu_ps(&y[i], mask, exp_avx512(_mm512_maskz_loadu_ps(mask, &x[i]), fast));
+    }
+}
+
+
+TARGET
+static void vlog_avx512(long n, const float *x, float *y) {
+    const int fast = kernel_math_fast();
+
+    for (long i = 0; i < n; i += 16) {
+        __mmask16 mask = tail_mask16(n - i);
+        _mm512_mask_storeu_ps(&y[i], mask, log_avx512(_mm512_maskz_loadu_ps(mask, &x[i]), fast));
+    }
+}
+
+
+// Maximum of x, with the sum of exp(x - max) in one online pass. Each lane
+// keeps its own running maximum and sum, merged at the end. The maxima
+// start at -FLT_MAX so that -inf inputs and tail padding add zero.
+TARGET
+static float max_sum_avx512(int n, const float *x, float *sum, int fast) {
+    const __m512 pad = _mm512_set1_ps(-INFINITY);
+
+    __m512 vmax = _mm512_set1_ps(-FLT_MAX);
+    __m512 vsum = _mm512_setzero_ps();
+
+    for (int i = 0; i < n; i += 16) {
+        __m512 v = _mm512_mask_loadu_ps(pad, tail_mask16(n - i), &x[i]);
+        __m512 m = _mm512_max_ps(vmax, v);
+        vsum = _mm512_fmadd_ps(vsum, exp_avx512(_mm512_sub_ps(vmax, m), fast), exp_avx512(_mm512_sub_ps(v, m), fast));
+        vmax = m;
+    }
+
+    float max = _mm512_reduce_max_ps(vmax);
+    *sum = _mm512_reduce_add_ps(_mm512_mul_ps(vsum, exp_avx512(_mm512_sub_ps(vmax, _mm512_set1_ps(max)), fast)));
+    return max;
+}
+
+
+TARGET
+static void softmax_avx512(int n, const float *restrict x, float *restrict y) {
+    const int fast = kernel_math_fast();
+
+    float sum;
+    __m512 vm = _mm512_set1_ps(max_sum_avx512(n, x, &sum, fast));
+    __m512 vs = _mm512_set1_ps(sum);
+    __m512 inv = _mm512_set1_ps(1.0f / sum);
+
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 mask = tail_mask16(n - i);
+        __m512 e = exp_avx512(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &x[i]), vm), fast);
+        _mm512_mask_storeu_ps(&y[i], mask, fast ? _mm512_mul_ps(e, inv) : _mm512_div_ps(e, vs));
+    }
+}
+
+
+TARGET
+static float logsumexp_avx512(int n, const float *x) {
+    float sum;
+    const float max = max_sum_avx512(n, x, &sum, kernel_math_fast());
+    return max + logf(sum);
+}
+
+
+// The loss terms are masked to the lanes where y is nonzero, so that -inf
+// logits with zero targets add nothing
+TARGET
+static float softmax_xent_avx512(int n, const float *restrict z, const float *restrict y, int label, float scale,
+    float *restrict p, float *restrict d
+) {
+    const int fast = kernel_math_fast();
+    const __m512 zero = _mm512_setzero_ps();
+
+    float sum;
+    const float max = max_sum_avx512(n, z, &sum, fast);
+    const float lse = max + logf(sum);
+
+    __m512 vl = _mm512_set1_ps(lse);
+    __m512 vscale = _mm512_set1_ps(scale);
+    __m512 loss = zero;
+
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 mask = tail_mask16(n - i);
+        __m512 zi = _mm512_maskz_loadu_ps(mask, &z[i]);
+        __m512 yi = y ? _mm512_maskz_loadu_ps(mask, &y[i]) : zero;
+
+        __m512 pi = exp_avx512(_mm512_sub_ps(zi, vl), fast);
+        _mm512_mask_storeu_ps(&p[i], mask, pi);
+        _mm512_mask_storeu_ps(&d[i], mask, _mm512_mul_ps(vscale, _mm512_sub_ps(pi, yi)));
+
+        __mmask16 hot = _mm512_mask_cmp_ps_mask(mask, yi, zero, _CMP_NEQ_UQ);
+        loss = _mm512_mask_add_ps(loss, hot, loss, _mm512_mul_ps(yi, _mm512_sub_ps(vl, zi)));
+    }
+
+    if (!y) {
+        d[label] -= scale;
+        return lse - z[label];
+    }
+
+    return _mm512_reduce_add_ps(loss);
+}
+
+
+TARGET
+static float bce_sum_avx512(int n, const float *restrict y, const float *restrict p, float eps) {
+    const int fast = kernel_math_fast();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 lo = _mm512_set1_ps(eps), hi = _mm512_set1_ps(1.0f - eps);
+
+    __m512 acc = _mm512_setzero_ps();
+
+    // Padding lanes are left out of the sum
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 mask = tail_mask16(n - i);
+        __m512 yi = _mm512_maskz_loadu_ps(mask, &y[i]);
+        __m512 pi = _mm512_mask_loadu_ps(_mm512_set1_ps(0.5f), mask, &p[i]);
+        pi = _mm512_min_ps(hi, _mm512_max_ps(lo, pi));
+
+        __m512 terms = _mm512_fmadd_ps(yi, log_avx512(pi, fast),
+            _mm512_mul_ps(_mm512_sub_ps(one, yi), log_avx512(_mm512_sub_ps(one, pi), fast)));
+        acc = _mm512_mask_add_ps(acc, mask, acc, terms);
+    }
+
+    return _mm512_reduce_add_ps(acc);
+}
+
+
+const KernelTable kernels_avx512 = {
+    .name = "avx512",
+    .mr = MR,
+    .nr = NR,
+    .ukernel = ukernel_avx512,
+    .sdot = sdot_avx512,
+    .saxpy = saxpy_avx512,
+    .sgemv = sgemv_avx512,
+    .optim_step = optim_step_avx512,
+    .qgemm = qgemm_avx512bw,
+    .hgemm = hgemm_avx512,
+    .bias_activ = bias_activ_avx512,
+    .activ_grad = activ_grad_avx512,
+    .vexp = vexp_avx512,
+    .vlog = vlog_avx512,
+    .softmax = softmax_avx512,
+    .logsumexp = logsumexp_avx512,
+    .softmax_xent = softmax_xent_avx512,
+    .bce_sum = bce_sum_avx512,
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include <math.h>
+#include <string.h>
+
+#include "kernels.h"
+
+
+#define MR 4
+#define NR 4
+
+
+static void ukernel_scalar(int kc, const float *restrict a, const float *restrict b, float *restrict c, int ldc) {
+    float acc[MR][NR] = {{0.0f}};
+
+    for (int p = 0; p < kc; ++p) {
+        for (int r = 0; r < MR; ++r) {
+            float x = a[p * MR + r];
+            for (int s = 0; s < NR; ++s) {
+                acc[r][s] += x * b[p * NR + s];
+            }
+        }
+    }
+
+    for (int r = 0; r < MR; ++r) {
+        for (int s = 0; s < NR; ++s) {
+            c[r * ldc + s] += acc[r][s];
+        }
+    }
+}
+
+
+static float sdot_scalar(int n, const float *restrict x, const float *restrict y) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+
+static void saxpy_scalar(int n, float alpha, const float *restrict x, float *restrict y) {
+    for (int i = 0; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+
+static void sgemv_scalar(int m, int n, const float *restrict a, int lda, const float *restrict x,
+    float *restrict y, int accumulate
+) {
+    for (int i = 0; i < m; ++i) {
+        float sum = sdot_scalar(n, &a[(long)i * lda], x);
+        y[i] = accumulate ? y[i] + sum : sum;
+    }
+}
+
+
+static void optim_step_scalar(const OptimStep *step, long n, float *restrict w, const float *restrict g,
+    float *restrict m, float *restrict v
+) {
+    const float lr = step->learning_rate;
+    const float b1 = step->beta1, b2 = step->beta2;
+    const float eps = step->epsilon;
+
+    switch (step->rule) {
+    case OPTIM_SGD:
+        for (long i = 0; i < n; ++i) {
+            w[i] -= lr * g[i];
+        }
+        break;
+
+    case OPTIM_MOMENTUM:
+        for (long i = 0; i < n; ++i) {
+            m[i] = b1 * m[i] + (1.0f - b1) * g[i];
+            w[i] -= lr * m[i];
+        }
+        break;
+
+    case OPTIM_ADAGRAD:
+        for (long i = 0; i < n; ++i) {
+            v[i] += g[i] * g[i];
+            w[i] -= lr * g[i] / (sqrtf(v[i]) + eps);
+        }
+        break;
+
+    case OPTIM_RMSPROP:
+        for (long i = 0; i < n; ++i) {
+            v[i] = b2 * v[i] + (1.0f - b2) * g[i] * g[i];
+            w[i] -= lr * g[i] / (sqrtf(v[i]) + eps);
+        }
+        break;
+
+    case OPTIM_ADAM:
+        for (long i = 0; i < n; ++i) {
+            m[i] = b1 * m[i] + (1.0f - b1) * g[i];
+            v[i] = b2 * v[i] + (1.0f - b2) * g[i] * g[i];
+            w[i] -= lr * m[i] / (sqrtf(v[i]) * step->v_scale + eps);
+        }
+        break;
+    }
+}
+
+
+static void qgemm_scalar(int batch, int m, int k, const uint8_t *restrict x, int ldx,
+    const int8_t *restrict w, int ldw, int32_t *restrict c, int ldc
+) {
+    for (int b = 0; b < batch; ++b) {
+        const uint8_t *xb = &x[(long)b * ldx];
+
+        for (int i = 0; i < m; ++i) {
+            const int8_t *wi = &w[(long)i * ldw];
+            int32_t sum = 0;
+            for (int j = 0; j < k; ++j) {
+                sum += (int32_t)xb[j] * wi[j];
+            }
+            c[(long)b * ldc + i] = sum;
+        }
+    }
+}
+
+
+float half_to_float(int type, uint16_t h) {
+    uint32_t bits;
+
+    if (type == HALF_BF16) {
+        bits = (uint32_t)h << 16;
+    } else {
+        uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+
+        if (exp == 0) {
+            // Zero or subnormal: mant * 2^-24
+            float v = ldexpf((float)mant, -24);
+            return sign ? -v : v;
+        }
+
+        bits = sign | ((exp == 0x1f) ? 0x7f800000 | (mant << 13) : ((exp + 112) << 23) | (mant << 13));
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+
+uint16_t float_to_half(int type, float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+
+    if (type == HALF_BF16) {
+        if ((bits & 0x7fffffff) > 0x7f800000) return (uint16_t)((bits >> 16) | 0x40);
+        return (uint16_t)((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+    }
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    float a = fabsf(f);
+
+    if (isnan(f)) return sign | 0x7e00;
+    if (a >= 65520.0f) return sign | 0x7c00;
+
+    // Below the smallest normal, halves are multiples of 2^-24
+    if (a < 0x1p-14f) return sign | (uint16_t)lrintf(a * 0x1p24f);
+
+    uint32_t abs_bits = bits & 0x7fffffff;
+    abs_bits += 0xfff + ((abs_bits >> 13) & 1);
+    return sign | (uint16_t)((abs_bits >> 13) - (112 << 10));
+}
+
+
+static void hgemm_scalar(int type, int batch, int m, int k, const float *restrict x, int ldx,
+    const uint16_t *restrict w, int ldw, float *restrict c, int ldc
+) {
+    for (int b = 0; b < batch; ++b) {
+        const float *xb = &x[(long)b * ldx];
+
+        for (int i = 0; i < m; ++i) {
+            const uint16_t *wi = &w[(long)i * ldw];
+            float sum = 0.0f;
+            for (int j = 0; j < k; ++j) {
+                sum += xb[j] * half_to_float(type, wi[j]);
+            }
+            c[(long)b * ldc + i] = sum;
+        }
+    }
+}
+
+
+static void bias_activ_scalar(int op, int rows, int cols, const float *bias, float *c, int ldc, float *out, int ldo) {
+    for (int r = 0; r < rows; ++r) {
+        float *cr = &c[(long)r * ldc];
+        float *yr = &out[(long)r * ldo];
+
+        if (bias) {
+            for (int j = 0; j < cols; ++j) {
+                cr[j] += bias[j];
+            }
+        }
+
+        switch (op) {
+        case ACTIV_LINEAR:
+            if (yr != cr) memcpy(yr, cr, cols * sizeof(float));
+            break;
+        case ACTIV_RELU:
+            for (int j = 0; j < cols; ++j) {
+                yr[j] = (cr[j] > 0.0f) ? cr[j] : 0.0f;
+            }
+            break;
+        case ACTIV_SIGMOID:
+            for (int j = 0; j < cols; ++j) {
+                yr[j] = 1.0f / (1.0f + expf(-cr[j]));
+            }
+            break;
+        }
+    }
+}
+
+
+static void activ_grad_scalar(int op, long n, const float *restrict a, float *restrict d) {
+    switch (op) {
+    case ACTIV_RELU:
+        for (long i = 0; i < n; ++i) {
+            d[i] = (a[i] > 0.0f) ? d[i] : 0.0f;
+        }
+        break;
+    case ACTIV_SIGMOID:
+        for (long i = 0; i < n; ++i) {
+            d[i] *= a[i] * (1.0f - a[i]);
+        }
+        break;
+    }
+}
+
+
+static void vexp_scalar(long n, const float *x, float *y) {
+    for (long i = 0; i < n; ++i) {
+        y[i] = expf(x[i]);
+    }
+}
+
+
+static void vlog_scalar(long n, const float *x, float *y) {
+    for (long i = 0; i < n; ++i) {
+        y[i] = logf(x[i]);
+    }
+}
+
+
+// Maximum of x, with the sum of exp(x - max) in one online pass. As in the
+// vector paths, a NaN or +inf logit (inf - inf) makes the sum NaN.
+static float max_sum_scalar(int n, const float *x, float *sum) {
+    float max = -INFINITY;
+    float s = 0.0f;
+
+    for (int i = 0; i < n; ++i) {
+        if (x[i] > max) {
+            s = (x[i] == INFINITY) ? NAN : s * expf(max - x[i]) + 1.0f;
+            max = x[i];
+        } else if (x[i] != -INFINITY) {
+            s += expf(x[i] - max);
+        }
+    }
+
+    *sum = s;
+    return max;
+}
+
+
+static void softmax_scalar(int n, const float *restrict x, float *restrict y) {
+    float sum;
+    const float max = max_sum_scalar(n, x, &sum);
+
+    for (int i = 0; i < n; ++i) {
+        y[i] = expf(x[i] - max) / sum;
+    }
+}
+
+
+static float logsumexp_scalar(int n, const float *x) {
+    float sum;
+    const float max = max_sum_scalar(n, x, &sum);
+    return max + logf(sum);
+}
+
+
+static float softmax_xent_scalar(int n, const float *restrict z, const float *restrict y, int label, float scale,
+    float *restrict p, float *restrict d
+) {
+    const float lse = logsumexp_scalar(n, z);
+    float loss = 0.0f;
+
+    for (int i = 0; i < n; ++i) {
+        p[i] = expf(z[i] - lse);
+        d[i] = scale * (y ? p[i] - y[i] : p[i]);
+
+        if (y && y[i] != 0.0f) {
+            loss += y[i] * (lse - z[i]);
+        }
+    }
+
+    if (!y) {
+        d[label] -= scale;
+        loss = lse - z[label];
+    }
+
+    return loss;
+}
+
+
+static float bce_sum_scalar(int n, const float *restrict y, const float *restrict p, float eps) {
+    float sum = 0.0f;
+
+    for (int i = 0; i < n; ++i) {
+        float clipped = fmaxf(eps, fminf(1.0f - eps, p[i]));
+        sum += y[i] * logf(clipped) + (1.0f - y[i]) * logf(1.0f - clipped);
+    }
+
+    return sum;
+}
+
+
+const KernelTable kernels_scalar = {
+    .name = "scalar",
+    .mr = MR,
+    .nr = NR,
+    .ukernel = ukernel_scalar,
+    .sdot = sdot_scalar,
+    .saxpy = saxpy_scalar,
+    .sgemv = sgemv_scalar,
+    .optim_step = optim_step_scalar,
+    .qgemm = qgemm_scalar,
+    .hgemm = hgemm_scalar,
+    .bias_activ = bias_activ_scalar,
+    .activ_grad = activ_grad_scalar,
+    .vexp = vexp_scalar,
+    .vlog = vlog_scalar,
+    .softmax = softmax_scalar,
+    .logsumexp = logsumexp_scalar,
+    .softmax_xent = softmax_xent_scalar,
+    .bce_sum = bce_sum_scalar,
+};
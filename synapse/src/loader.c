@@ -1,7 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <zlib.h>
 
 #include "loader.h"
+#include "csv.h"
+#include "samples_internal.h"
 
 
 #define CHECK_LOAD_ARGS(filename, num_samples, input_size) \
@@ -10,88 +16,322 @@
         return NULL; \
     }
 
-#define DELETE_DATA_LABELS(data, num_samples) \
+// Row pointers into one contiguous block; data[0] owns the block
+#define DELETE_DATA_LABELS(data) \
     do { \
         if ((data)) { \
-            for (int i = 0; i < (num_samples); ++i) { \
-                if ((data)[i]) free((data)[i]); \
-            } \
+            free((data)[0]); \
             free((data)); \
         } \
     } while (0);
 
 
-float** read_csv_data(const char *filename, int num_samples, int input_size) {
-    CHECK_LOAD_ARGS(filename, num_samples, input_size);
+float* read_csv_matrix(const char *filename, int num_rows, int num_cols) {
+    CHECK_LOAD_ARGS(filename, num_rows, num_cols);
 
-    float **data = (float **)malloc(num_samples * sizeof(float *));
-    for (int i = 0; i < num_samples; ++i) {
-        data[i] = (float *)malloc(input_size * sizeof(float));
+    float *matrix = (float *)alloc_samples((size_t)num_rows * num_cols * sizeof(float));
+    if (!matrix) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return NULL;
     }
 
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
-        DELETE_DATA_LABELS(data, num_samples);
+    if (csv_parse_file(filename, CSV_FLOATS, matrix, num_rows, num_cols)) {
+        free(matrix);
         return NULL;
     }
 
-    for (int i = 0; i < num_samples; ++i) {
-        for (int j = 0; j < input_size; ++j) {
-            if (fscanf(file, "%f,", &data[i][j]) != 1) {
-                fclose(file);
-                DELETE_DATA_LABELS(data, num_samples);
-                return NULL;
-            }
-        }
-        fgetc(file);
+    return matrix;
+}
+
+
+static float** rows_of(float *block, int num_rows, int row_size) {
+    if (!block) return NULL;
+
+    float **rows = (float **)malloc(num_rows * sizeof(float *));
+    if (!rows) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        free(block);
+        return NULL;
     }
 
-    fclose(file);
-    return data;
+    for (int i = 0; i < num_rows; ++i) {
+        rows[i] = &block[(size_t)i * row_size];
+    }
+
+    return rows;
+}
+
+
+float** read_csv_data(const char *filename, int num_samples, int input_size) {
+    CHECK_LOAD_ARGS(filename, num_samples, input_size);
+
+    return rows_of(read_csv_matrix(filename, num_samples, input_size), num_samples, input_size);
 }
 
 
 float** read_csv_labels(const char *filename, int num_samples, int num_classes) {
     CHECK_LOAD_ARGS(filename, num_samples, num_classes);
 
-    float **labels = (float **)malloc(num_samples * sizeof(float *));
-    for (int i = 0; i < num_samples; ++i) {
-        labels[i] = (float *)malloc(num_classes * sizeof(float));
+    float *labels = (float *)alloc_samples((size_t)num_samples * num_classes * sizeof(float));
+    if (!labels) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return NULL;
+    }
+
+    if (csv_parse_file(filename, CSV_ONE_HOT, labels, num_samples, num_classes)) {
+        free(labels);
+        return NULL;
+    }
+
+    return rows_of(labels, num_samples, num_classes);
+}
+
+
+int32_t* read_csv_classes(const char *filename, int num_samples, int num_classes) {
+    CHECK_LOAD_ARGS(filename, num_samples, num_classes);
+
+    int32_t *classes = (int32_t *)alloc_samples((size_t)num_samples * sizeof(int32_t));
+    if (!classes) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return NULL;
+    }
+
+    if (csv_parse_file(filename, CSV_CLASS_INDEX, classes, num_samples, num_classes)) {
+        free(classes);
+        return NULL;
     }
 
-    FILE *file = fopen(filename, "r");
+    return classes;
+}
+
+
+void delete_data(float **data, int num_samples) {
+    (void)num_samples;
+    DELETE_DATA_LABELS(data);
+}
+
+
+void delete_labels(float **labels, int num_samples) {
+    (void)num_samples;
+    DELETE_DATA_LABELS(labels);
+}
+
+
+// Decompressed bytes converted per step when reading IDX images as floats
+#define IDX_CHUNK (1 << 16)
+
+#define IDX_TYPE_U8 0x08
+
+
+// Opens an IDX file (raw or gzip) and reads its num_dims sizes into dims.
+// Only unsigned byte data with exactly num_dims dimensions is accepted.
+static gzFile open_idx(const char *filename, int num_dims, uint32_t *dims) {
+    gzFile file = gzopen(filename, "rb");
     if (!file) {
         fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
-        DELETE_DATA_LABELS(labels, num_samples);
         return NULL;
     }
 
-    for (int i = 0; i < num_samples; ++i) {
-        int label;
-        if (fscanf(file, "%d,", &label) != 1) {
-            fclose(file);
-            DELETE_DATA_LABELS(labels, num_samples);
+    gzbuffer(file, 1 << 17);
+
+    unsigned char magic[4];
+    if (gzread(file, magic, 4) != 4 || magic[0] != 0 || magic[1] != 0 || magic[2] != IDX_TYPE_U8 || magic[3] != num_dims) {
+        fprintf(stderr, "Error: '%s' is not an unsigned byte IDX file with %d dimensions.\n", filename, num_dims);
+        gzclose(file);
+        return NULL;
+    }
+
+    for (int d = 0; d < num_dims; ++d) {
+        unsigned char b[4];
+        if (gzread(file, b, 4) != 4) {
+            fprintf(stderr, "Error: Truncated IDX header in '%s'.\n", filename);
+            gzclose(file);
             return NULL;
         }
+        dims[d] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    }
+
+    // Sample counts and per-sample sizes are used as int, and the float copy must fit in size_t
+    uint64_t sample_size = 1;
+    for (int d = 1; d < num_dims && sample_size <= INT_MAX; ++d) {
+        sample_size *= dims[d];
+    }
+
+    if (dims[0] > INT_MAX || sample_size > INT_MAX ||
+        (sample_size && dims[0] > SIZE_MAX / sizeof(float) / sample_size)
+    ) {
+        fprintf(stderr, "Error: IDX dimensions in '%s' are too large.\n", filename);
+        gzclose(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+
+// Reads exactly size bytes, looping because gzread() takes an unsigned count
+static int read_idx_bytes(gzFile file, const char *filename, unsigned char *dst, size_t size) {
+    while (size > 0) {
+        unsigned step = (size > (1u << 30)) ? (1u << 30) : (unsigned)size;
+        int got = gzread(file, dst, step);
+        if (got <= 0) {
+            fprintf(stderr, "Error: Failed to read data from '%s' (truncated or corrupt).\n", filename);
+            return 1;
+        }
+        dst += got;
+        size -= (size_t)got;
+    }
+    return 0;
+}
+
+
+unsigned char* read_idx_images_u8(const char *filename, int *num_samples, int *input_size) {
+    if (!filename || !num_samples || !input_size) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    uint32_t dims[3];
+    gzFile file = open_idx(filename, 3, dims);
+    if (!file) return NULL;
+
+    size_t size = (size_t)dims[0] * dims[1] * dims[2];
+    unsigned char *images = (unsigned char *)alloc_samples(size);
+    if (!images) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        gzclose(file);
+        return NULL;
+    }
+
+    if (read_idx_bytes(file, filename, images, size)) {
+        free(images);
+        gzclose(file);
+        return NULL;
+    }
+
+    gzclose(file);
+
+    *num_samples = (int)dims[0];
+    *input_size = (int)(dims[1] * dims[2]);
+    return images;
+}
+
+
+float* read_idx_images(const char *filename, int *num_samples, int *input_size) {
+    if (!filename || !num_samples || !input_size) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    uint32_t dims[3];
+    gzFile file = open_idx(filename, 3, dims);
+    if (!file) return NULL;
+
+    size_t size = (size_t)dims[0] * dims[1] * dims[2];
+    float *images = (float *)alloc_samples(size * sizeof(float));
+    unsigned char *chunk = (unsigned char *)malloc(IDX_CHUNK);
+    if (!images || !chunk) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        free(images);
+        free(chunk);
+        gzclose(file);
+        return NULL;
+    }
+
+    // Same [-1, 1] scaling as mnist2csv.py, applied while decompressing
+    float lut[256];
+    for (int v = 0; v < 256; ++v) {
+        lut[v] = (v / 255.0f) * 2.0f - 1.0f;
+    }
+
+    for (size_t done = 0; done < size; ) {
+        size_t step = (size - done < IDX_CHUNK) ? size - done : IDX_CHUNK;
+
+        if (read_idx_bytes(file, filename, chunk, step)) {
+            free(images);
+            images = NULL;
+            break;
+        }
 
-        for (int j = 0; j < num_classes; ++j) {
-            labels[i][j] = (j == label) ? 1.0f : 0.0f;
+        for (size_t i = 0; i < step; ++i) {
+            images[done + i] = lut[chunk[i]];
         }
+        done += step;
     }
 
-    fclose(file);
-    return labels;
+    free(chunk);
+    gzclose(file);
+
+    if (images) {
+        *num_samples = (int)dims[0];
+        *input_size = (int)(dims[1] * dims[2]);
+    }
+    return images;
 }
 
 
-void delete_data(float **data, int num_samples) {
-    DELETE_DATA_LABELS(data, num_samples);
+int32_t* read_idx_classes(const char *filename, int *num_samples, int num_classes) {
+    if (!filename || !num_samples || num_classes <= 0) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    uint32_t count;
+    gzFile file = open_idx(filename, 1, &count);
+    if (!file) return NULL;
+
+    unsigned char *bytes = (unsigned char *)malloc(count ? count : 1);
+    int32_t *classes = (int32_t *)alloc_samples((size_t)count * sizeof(int32_t));
+    if (!bytes || !classes) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        goto fail;
+    }
+
+    if (read_idx_bytes(file, filename, bytes, count)) goto fail;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (bytes[i] >= num_classes) {
+            fprintf(stderr, "Error: Label %d of sample %u in '%s' is out of range.\n", bytes[i], i, filename);
+            goto fail;
+        }
+        classes[i] = bytes[i];
+    }
+
+    free(bytes);
+    gzclose(file);
+
+    *num_samples = (int)count;
+    return classes;
+
+fail:
+    free(bytes);
+    free(classes);
+    gzclose(file);
+    return NULL;
 }
 
 
-void delete_labels(float **labels, int num_samples) {
-    DELETE_DATA_LABELS(labels, num_samples);
+float* read_idx_labels(const char *filename, int *num_samples, int num_classes) {
+    int count = 0;
+    int32_t *classes = read_idx_classes(filename, &count, num_classes);
+    if (!classes) return NULL;
+
+    float *labels = (float *)alloc_samples((size_t)count * num_classes * sizeof(float));
+    if (!labels) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        free(classes);
+        return NULL;
+    }
+
+    memset(labels, 0, (size_t)count * num_classes * sizeof(float));
+    for (int i = 0; i < count; ++i) {
+        labels[(size_t)i * num_classes + classes[i]] = 1.0f;
+    }
+
+    free(classes);
+
+    *num_samples = count;
+    return labels;
 }
 
 
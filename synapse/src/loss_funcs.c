@@ -4,6 +4,7 @@
 
 #include "loss_funcs.h"
 #include "utils.h"
+#include "kernels/kernels.h"
 
 
 #define CHECK_LOSS_ARGS(y_true, y_pred, size) \
@@ -29,14 +30,7 @@ float mean_squared_error(const float *restrict y_true, const float *restrict y_p
 float binary_cross_entropy(const float *restrict y_true, const float *restrict y_pred, int size) {
     CHECK_LOSS_ARGS(y_true, y_pred, size);
 
-    float sum = 0.0f;
-
-    for (int i = 0; i < size; ++i) {
-        float clipped_pred = fmaxf(EPSILON, fminf(1.0f - EPSILON, y_pred[i]));
-        sum += y_true[i] * logf(clipped_pred) + (1.0f - y_true[i]) * logf(1.0f - clipped_pred);
-    }
-
-    return -sum / size;
+    return -kernel_bce_sum(size, y_true, y_pred, EPSILON) / size;
 }
 
 
@@ -56,5 +50,15 @@ float categorical_cross_entropy(const float *restrict y_true, const float *restr
         return NAN;
     }
     
-    return -logf(fmaxf(y_pred[class_index], EPSILON));
+    return -kernel_log(fmaxf(y_pred[class_index], EPSILON));
+}
+
+
+float sparse_categorical_cross_entropy(int y_true, const float *restrict y_pred, int size) {
+    if (!y_pred || size <= 0 || y_true < 0 || y_true >= size) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NAN;
+    }
+
+    return -kernel_log(fmaxf(y_pred[y_true], EPSILON));
 }
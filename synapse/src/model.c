@@ -0,0 +1,807 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "activ_funcs.h"
+#include "model_internal.h"
+#include "kernels/kernels.h"
+
+
+// Model file v2, little-endian like tensor files:
+//
+//   header (64 bytes)   magic "SYNM", u32 version, u32 num_layers,
+//                       u32 alignment, u32 meta_crc, u32 data_crc,
+//                       u64 data_offset, u64 file_size
+//   layer table         one 64-byte entry per layer: u32 input_size,
+//                       u32 output_size, u64 weights_offset,
+//                       u64 biases_offset, char activ_name[16],
+//                       u32 dtype, f32 input_scale, i32 input_zero,
+//                       u32 ldw, u64 scales_offset
+//   data                weight, bias and scale blocks, each on a 64-byte
+//                       boundary
+//
+// dtype 0 (MODEL_F32) leaves the other fields zero; MODEL_INT8 weights are
+// output_size rows of ldw signed bytes, MODEL_F16 and MODEL_BF16 ones rows
+// of ldw 16-bit values.
+//
+// meta_crc is the CRC-32 of the header with both CRC fields zeroed followed
+// by the layer table; data_crc covers everything from data_offset to the end.
+// Version 1 files (no magic, see read_model_layer()) are still loaded.
+#define MODEL_MAGIC "SYNM"
+#define MODEL_VERSION 2
+#define MODEL_ALIGN 64
+#define MODEL_HEADER_SIZE 64
+#define MODEL_ENTRY_SIZE 64
+#define ACTIV_NAME_SIZE 16
+
+#define ALIGN_UP(n) (((uint64_t)(n) + MODEL_ALIGN - 1) & ~(uint64_t)(MODEL_ALIGN - 1))
+
+
+// Holds only activation buffers. Layers ping-pong between them: the sums
+// of a layer go to sums, and its activations overwrite the previous
+// activations in activs, which the matrix product has already consumed.
+struct SynInferCtx {
+    const SynModel *model;
+    int capacity;
+    float *sums;
+    float *activs;
+
+    // Quantized inputs and int32 products of MODEL_INT8 layers
+    uint8_t *qinputs;
+    int32_t *qsums;
+};
+
+
+const char* get_activ_func_name(int (*activ_func)(const float *restrict, float *restrict, int)) {
+    if (activ_func == linear) return "Linear";
+    if (activ_func == relu) return "ReLU";
+    if (activ_func == sigmoid) return "Sigmoid";
+    if (activ_func == softmax) return "Softmax";
+    return "Unknown";
+}
+
+
+int (*get_activ_func_by_name(const char *name))(const float *restrict, float *restrict, int) {
+    if (strcmp(name, "Linear") == 0) return linear;
+    if (strcmp(name, "ReLU") == 0) return relu;
+    if (strcmp(name, "Sigmoid") == 0) return sigmoid;
+    if (strcmp(name, "Softmax") == 0) return softmax;
+    return NULL;
+}
+
+
+int get_activ_op(int (*activ_func)(const float *restrict, float *restrict, int)) {
+    if (activ_func == linear) return ACTIV_LINEAR;
+    if (activ_func == relu) return ACTIV_RELU;
+    if (activ_func == sigmoid) return ACTIV_SIGMOID;
+    if (activ_func == softmax) return ACTIV_SOFTMAX;
+    return -1;
+}
+
+
+SynModel* model_alloc(int num_layers) {
+    if (num_layers <= 0) {
+        fprintf(stderr, "Error: Invalid number of layers specified for the model.\n");
+        return NULL;
+    }
+
+    SynModel *model = (SynModel *)calloc(1, sizeof(SynModel));
+    if (!model) {
+        fprintf(stderr, "Error: Memory allocation failed for the model.\n");
+        return NULL;
+    }
+
+    model->layers = (ModelLayer *)calloc(num_layers, sizeof(ModelLayer));
+    if (!model->layers) {
+        fprintf(stderr, "Error: Memory allocation failed for the model.\n");
+        free(model);
+        return NULL;
+    }
+
+    model->num_layers = num_layers;
+    return model;
+}
+
+
+// Byte sizes of the weight, bias and scale arrays of a layer
+void layer_array_sizes(const ModelLayer *layer, uint64_t sizes[3]) {
+    uint64_t rows = (uint64_t)layer->output_size;
+
+    switch (layer->dtype) {
+    case MODEL_INT8: sizes[0] = rows * layer->ldw; break;
+    case MODEL_F16:
+    case MODEL_BF16: sizes[0] = rows * layer->ldw * sizeof(uint16_t); break;
+    default: sizes[0] = rows * layer->input_size * sizeof(float); break;
+    }
+
+    sizes[1] = rows * sizeof(float);
+    sizes[2] = (layer->dtype == MODEL_INT8) ? rows * sizeof(float) : 0;
+}
+
+
+// Points the arrays of a layer at base + offsets
+void place_layer_arrays(ModelLayer *layer, unsigned char *base, const uint64_t offsets[3]) {
+    if (layer->dtype == MODEL_F32) {
+        layer->weights = (float *)(base + offsets[0]);
+    } else {
+        layer->weights = NULL;
+        layer->packed = base + offsets[0];
+        layer->scales = (layer->dtype == MODEL_INT8) ? (float *)(base + offsets[2]) : NULL;
+    }
+    layer->biases = (float *)(base + offsets[1]);
+}
+
+
+int model_alloc_params(SynModel *model) {
+    uint64_t size = 0;
+    model->max_width = 0;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *layer = &model->layers[l];
+        uint64_t sizes[3];
+        layer_array_sizes(layer, sizes);
+        size += ALIGN_UP(sizes[0]) + ALIGN_UP(sizes[1]) + ALIGN_UP(sizes[2]);
+
+        if (layer->output_size > model->max_width) {
+            model->max_width = layer->output_size;
+        }
+    }
+
+    model->params = aligned_alloc(MODEL_ALIGN, (size_t)size);
+    if (!model->params) {
+        fprintf(stderr, "Error: Memory allocation failed for model parameters.\n");
+        return 1;
+    }
+
+    uint64_t offset = 0;
+    for (int l = 0; l < model->num_layers; ++l) {
+        ModelLayer *layer = &model->layers[l];
+        uint64_t sizes[3], offsets[3];
+        layer_array_sizes(layer, sizes);
+
+        for (int a = 0; a < 3; ++a) {
+            offsets[a] = offset;
+            offset += ALIGN_UP(sizes[a]);
+        }
+
+        place_layer_arrays(layer, (unsigned char *)model->params, offsets);
+    }
+
+    return 0;
+}
+
+
+void syn_delete_model(SynModel *model) {
+    if (!model) return;
+
+    if (model->map) munmap(model->map, model->map_size);
+    free(model->params);
+    free(model->layers);
+    free(model);
+}
+
+
+// Data offsets of the weight, bias and scale blocks of every layer; returns
+// the file size
+uint64_t layout_model_file(const ModelLayer *layers, int num_layers, uint64_t *offsets) {
+    uint64_t offset = ALIGN_UP(MODEL_HEADER_SIZE + (uint64_t)num_layers * MODEL_ENTRY_SIZE);
+
+    for (int l = 0; l < num_layers; ++l) {
+        uint64_t sizes[3];
+        layer_array_sizes(&layers[l], sizes);
+
+        for (int a = 0; a < 3; ++a) {
+            offsets[3 * l + a] = offset;
+            offset = ALIGN_UP(offset + sizes[a]);
+        }
+    }
+
+    return offset;
+}
+
+
+void encode_model_header(unsigned char *header, int num_layers, uint32_t meta_crc, uint32_t data_crc,
+    uint64_t data_offset, uint64_t file_size
+) {
+    uint32_t fields[5] = { MODEL_VERSION, (uint32_t)num_layers, MODEL_ALIGN, meta_crc, data_crc };
+    uint64_t sizes[2] = { data_offset, file_size };
+
+    memset(header, 0, MODEL_HEADER_SIZE);
+    memcpy(header, MODEL_MAGIC, 4);
+    memcpy(header + 4, fields, sizeof(fields));
+    memcpy(header + 24, sizes, sizeof(sizes));
+}
+
+
+// Writes a block followed by zeros up to end, folding both into the data CRC
+int write_block(FILE *file, const void *data, size_t size, uint64_t end, uint64_t *pos, uLong *crc) {
+    static const unsigned char zeros[MODEL_ALIGN];
+
+    // crc32() restarts on a NULL buffer, which empty blocks may pass
+    if (size > 0) {
+        if (fwrite(data, 1, size, file) != size) return 1;
+        *crc = crc32(*crc, (const Bytef *)data, (uInt)size);
+        *pos += size;
+    }
+
+    size_t padding = (size_t)(end - *pos);
+    if (padding > 0 && fwrite(zeros, 1, padding, file) != padding) return 1;
+    *crc = crc32(*crc, zeros, (uInt)padding);
+    *pos = end;
+
+    return 0;
+}
+
+
+int write_model_file(const char *filename, const ModelLayer *layers, int num_layers) {
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return 1;
+    }
+
+    size_t table_size = (size_t)num_layers * MODEL_ENTRY_SIZE;
+    unsigned char *table = (unsigned char *)calloc(1, table_size);
+    uint64_t *offsets = (uint64_t *)malloc(3 * num_layers * sizeof(uint64_t));
+    if (!table || !offsets) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        free(table);
+        free(offsets);
+        return 1;
+    }
+
+    uint64_t file_size = layout_model_file(layers, num_layers, offsets);
+    uint64_t data_offset = ALIGN_UP(MODEL_HEADER_SIZE + table_size);
+
+    for (int l = 0; l < num_layers; ++l) {
+        const ModelLayer *layer = &layers[l];
+        unsigned char *entry = &table[(size_t)l * MODEL_ENTRY_SIZE];
+        uint32_t sizes[2] = { (uint32_t)layer->input_size, (uint32_t)layer->output_size };
+
+        memcpy(entry, sizes, sizeof(sizes));
+        memcpy(entry + 8, &offsets[3 * l], 2 * sizeof(uint64_t));
+        strncpy((char *)entry + 24, get_activ_func_name(layer->activ_func), ACTIV_NAME_SIZE - 1);
+
+        if (layer->dtype != MODEL_F32) {
+            uint32_t dtype = layer->dtype;
+            uint32_t ldw = (uint32_t)layer->ldw;
+            memcpy(entry + 40, &dtype, sizeof(dtype));
+            memcpy(entry + 52, &ldw, sizeof(ldw));
+        }
+
+        if (layer->dtype == MODEL_INT8) {
+            int32_t zero = layer->input_zero;
+            memcpy(entry + 44, &layer->input_scale, sizeof(float));
+            memcpy(entry + 48, &zero, sizeof(zero));
+            memcpy(entry + 56, &offsets[3 * l + 2], sizeof(uint64_t));
+        }
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        free(table);
+        free(offsets);
+        return 1;
+    }
+
+    // The header is rewritten with the checksums once the data is out
+    unsigned char header[MODEL_HEADER_SIZE];
+    encode_model_header(header, num_layers, 0, 0, data_offset, file_size);
+
+    uLong meta_crc = crc32(crc32(0L, Z_NULL, 0), header, MODEL_HEADER_SIZE);
+    meta_crc = crc32(meta_crc, table, (uInt)table_size);
+
+    uLong data_crc = crc32(0L, Z_NULL, 0);
+    uint64_t pos = MODEL_HEADER_SIZE;
+
+    int ok = fwrite(header, 1, MODEL_HEADER_SIZE, file) == MODEL_HEADER_SIZE &&
+        fwrite(table, 1, table_size, file) == table_size;
+    pos += table_size;
+
+    // Padding before the first block is not part of the data
+    static const unsigned char zeros[MODEL_ALIGN];
+    ok = ok && fwrite(zeros, 1, (size_t)(data_offset - pos), file) == (size_t)(data_offset - pos);
+    pos = data_offset;
+
+    for (int l = 0; ok && l < num_layers; ++l) {
+        const ModelLayer *layer = &layers[l];
+        const void *blocks[3] = {
+            (layer->dtype == MODEL_F32) ? (const void *)layer->weights : layer->packed, layer->biases, layer->scales
+        };
+        uint64_t sizes[3];
+        layer_array_sizes(layer, sizes);
+
+        for (int a = 0; ok && a < 3; ++a) {
+            size_t next = 3 * (size_t)l + a + 1;
+            uint64_t end = (next < 3 * (size_t)num_layers) ? offsets[next] : file_size;
+            ok = !write_block(file, blocks[a], (size_t)sizes[a], end, &pos, &data_crc);
+        }
+    }
+
+    encode_model_header(header, num_layers, (uint32_t)meta_crc, (uint32_t)data_crc, data_offset, file_size);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, MODEL_HEADER_SIZE, file) == MODEL_HEADER_SIZE;
+
+    if (fclose(file) != 0) ok = 0;
+    free(table);
+    free(offsets);
+
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write file '%s'.\n", filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+// Version 1 layer record: int sizes, unaligned parameters and the activation name
+static int read_model_layer(FILE *file, ModelLayer *layer, int with_params) {
+    if (!with_params) {
+        if (fread(&layer->input_size, sizeof(int), 1, file) != 1 ||
+            fread(&layer->output_size, sizeof(int), 1, file) != 1 ||
+            layer->input_size <= 0 || layer->output_size <= 0
+        ) {
+            return 1;
+        }
+
+        long params_size = ((long)layer->input_size * layer->output_size + layer->output_size) * (long)sizeof(float);
+        if (fseek(file, params_size, SEEK_CUR) != 0) return 1;
+    } else {
+        size_t num_weights = (size_t)layer->input_size * layer->output_size;
+
+        if (fseek(file, 2 * sizeof(int), SEEK_CUR) != 0 ||
+            fread(layer->weights, sizeof(float), num_weights, file) != num_weights ||
+            fread(layer->biases, sizeof(float), layer->output_size, file) != (size_t)layer->output_size
+        ) {
+            return 1;
+        }
+    }
+
+    char name[32];
+    int name_len = 0;
+    if (fread(&name_len, sizeof(int), 1, file) != 1 || name_len <= 0 || name_len > (int)sizeof(name) ||
+        fread(name, sizeof(char), name_len, file) != (size_t)name_len
+    ) {
+        return 1;
+    }
+
+    name[name_len - 1] = '\0';
+    layer->activ_func = get_activ_func_by_name(name);
+    layer->activ_op = get_activ_op(layer->activ_func);
+
+    return layer->activ_func ? 0 : 1;
+}
+
+
+SynModel* load_model_v1(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        return NULL;
+    }
+
+    int num_layers = 0;
+    if (fread(&num_layers, sizeof(int), 1, file) != 1) {
+        fprintf(stderr, "Error: Failed to read model file '%s'.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+
+    SynModel *model = model_alloc(num_layers);
+    if (!model) {
+        fclose(file);
+        return NULL;
+    }
+
+    // First pass reads the layer sizes so the parameters fit in one block
+    long start = ftell(file);
+    for (int l = 0; l < num_layers; ++l) {
+        if (read_model_layer(file, &model->layers[l], 0)) goto error;
+    }
+
+    if (model_alloc_params(model) || fseek(file, start, SEEK_SET) != 0) goto error;
+
+    for (int l = 0; l < num_layers; ++l) {
+        if (read_model_layer(file, &model->layers[l], 1)) goto error;
+    }
+
+    fclose(file);
+    return model;
+
+error:
+    fprintf(stderr, "Error: Failed to read model file '%s'.\n", filename);
+    fclose(file);
+    syn_delete_model(model);
+    return NULL;
+}
+
+
+// Validates the header and layer table of a mapped v2 file and points the
+// layers into the mapping
+int map_model_layers(SynModel *model, const unsigned char *map, uint64_t map_size) {
+    uint32_t fields[5];
+    uint64_t sizes[2];
+    unsigned char header[MODEL_HEADER_SIZE];
+
+    memcpy(fields, map + 4, sizeof(fields));
+    memcpy(sizes, map + 24, sizeof(sizes));
+
+    const uint64_t table_size = (uint64_t)model->num_layers * MODEL_ENTRY_SIZE;
+    const uint64_t data_offset = sizes[0];
+
+    if (fields[2] != MODEL_ALIGN || sizes[1] != map_size || data_offset != ALIGN_UP(MODEL_HEADER_SIZE + table_size) ||
+        data_offset > map_size
+    ) {
+        return 1;
+    }
+
+    memcpy(header, map, MODEL_HEADER_SIZE);
+    memset(header + 16, 0, 2 * sizeof(uint32_t));
+
+    uLong meta_crc = crc32(crc32(0L, Z_NULL, 0), header, MODEL_HEADER_SIZE);
+    meta_crc = crc32(meta_crc, map + MODEL_HEADER_SIZE, (uInt)table_size);
+    if ((uint32_t)meta_crc != fields[3]) return 1;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const unsigned char *entry = map + MODEL_HEADER_SIZE + (size_t)l * MODEL_ENTRY_SIZE;
+        ModelLayer *layer = &model->layers[l];
+        uint32_t layer_sizes[2], dtype, ldw;
+        uint64_t offsets[3];
+        char name[ACTIV_NAME_SIZE];
+
+        memcpy(layer_sizes, entry, sizeof(layer_sizes));
+        memcpy(offsets, entry + 8, 2 * sizeof(uint64_t));
+        memcpy(name, entry + 24, ACTIV_NAME_SIZE);
+        memcpy(&dtype, entry + 40, sizeof(dtype));
+        memcpy(&layer->input_scale, entry + 44, sizeof(float));
+        memcpy(&layer->input_zero, entry + 48, sizeof(int32_t));
+        memcpy(&ldw, entry + 52, sizeof(ldw));
+        memcpy(&offsets[2], entry + 56, sizeof(uint64_t));
+        name[ACTIV_NAME_SIZE - 1] = '\0';
+
+        if (layer_sizes[0] == 0 || layer_sizes[1] == 0 || layer_sizes[0] > INT32_MAX || layer_sizes[1] > INT32_MAX) return 1;
+        if (dtype > MODEL_BF16) return 1;
+
+        layer->input_size = (int)layer_sizes[0];
+        layer->output_size = (int)layer_sizes[1];
+        layer->dtype = (ModelDtype)dtype;
+
+        if (layer->dtype == MODEL_INT8) {
+            if (ldw < layer_sizes[0] || ldw % QUANT_BLOCK || ldw > INT32_MAX ||
+                !(layer->input_scale > 0.0f) || layer->input_zero < 0 || layer->input_zero > 127
+            ) {
+                return 1;
+            }
+            layer->ldw = (int)ldw;
+        } else if (layer->dtype != MODEL_F32) {
+            if (ldw < layer_sizes[0] || ldw > INT32_MAX) return 1;
+            layer->ldw = (int)ldw;
+        }
+
+        uint64_t sizes[3];
+        layer_array_sizes(layer, sizes);
+
+        for (int a = 0; a < 3; ++a) {
+            if (offsets[a] % MODEL_ALIGN || (sizes[a] > 0 &&
+                (offsets[a] < data_offset || offsets[a] > map_size || sizes[a] > map_size - offsets[a]))
+            ) {
+                return 1;
+            }
+        }
+
+        layer->activ_func = get_activ_func_by_name(name);
+        layer->activ_op = get_activ_op(layer->activ_func);
+
+        // Mapped read-only; nothing writes through a loaded model
+        place_layer_arrays(layer, (unsigned char *)map, offsets);
+
+        if (!layer->activ_func || (l > 0 && layer->input_size != model->layers[l - 1].output_size)) return 1;
+        if (layer->output_size > model->max_width) model->max_width = layer->output_size;
+    }
+
+    return 0;
+}
+
+
+// v2 files are mapped read-only and shared: the layers point straight into
+// the page cache, so loading reads only the header and the layer table
+SynModel* load_model_v2(const char *filename, int fd, uint64_t file_size) {
+    void *map = mmap(NULL, (size_t)file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map file '%s'.\n", filename);
+        return NULL;
+    }
+
+    uint32_t fields[2];
+    memcpy(fields, (const unsigned char *)map + 4, sizeof(fields));
+
+    if (fields[0] != MODEL_VERSION) {
+        fprintf(stderr, "Error: Model file '%s' has unsupported version %u.\n", filename, fields[0]);
+        munmap(map, (size_t)file_size);
+        return NULL;
+    }
+
+    SynModel *model = (fields[1] > 0 && fields[1] <= (file_size - MODEL_HEADER_SIZE) / MODEL_ENTRY_SIZE) ?
+        model_alloc((int)fields[1]) : NULL;
+    if (!model) {
+        fprintf(stderr, "Error: Model file '%s' is truncated or corrupt.\n", filename);
+        munmap(map, (size_t)file_size);
+        return NULL;
+    }
+
+    model->map = map;
+    model->map_size = (size_t)file_size;
+
+    if (map_model_layers(model, (const unsigned char *)map, file_size)) {
+        fprintf(stderr, "Error: Model file '%s' is truncated or corrupt.\n", filename);
+        syn_delete_model(model);
+        return NULL;
+    }
+
+    return model;
+}
+
+
+SynModel* syn_load_model(const char *filename) {
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return NULL;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    char magic[4] = { 0 };
+    int is_v2 = fstat(fd, &st) == 0 && st.st_size >= MODEL_HEADER_SIZE &&
+        pread(fd, magic, 4, 0) == 4 && memcmp(magic, MODEL_MAGIC, 4) == 0;
+
+    SynModel *model = is_v2 ? load_model_v2(filename, fd, (uint64_t)st.st_size) : NULL;
+    close(fd);
+
+    return is_v2 ? model : load_model_v1(filename);
+}
+
+
+int syn_save_model(const SynModel *model, const char *filename) {
+    if (!model) {
+        fprintf(stderr, "Error: Invalid model provided.\n");
+        return 1;
+    }
+
+    return write_model_file(filename, model->layers, model->num_layers);
+}
+
+
+int syn_model_verify(const SynModel *model) {
+    if (!model) {
+        fprintf(stderr, "Error: Invalid input parameters for model verification.\n");
+        return 1;
+    }
+
+    if (!model->map) return 0;
+
+    const unsigned char *map = (const unsigned char *)model->map;
+    uint32_t data_crc;
+    uint64_t data_offset;
+
+    memcpy(&data_crc, map + 20, sizeof(data_crc));
+    memcpy(&data_offset, map + 24, sizeof(data_offset));
+
+    // crc32() takes at most 4 GiB per call
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (uint64_t pos = data_offset; pos < model->map_size; ) {
+        uint64_t len = model->map_size - pos;
+        if (len > (1u << 30)) len = 1u << 30;
+        crc = crc32(crc, map + pos, (uInt)len);
+        pos += len;
+    }
+
+    if ((uint32_t)crc != data_crc) {
+        fprintf(stderr, "Error: Model parameters do not match their checksum.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int syn_model_input_size(const SynModel *model) {
+    return model ? model->layers[0].input_size : 0;
+}
+
+
+int syn_model_output_size(const SynModel *model) {
+    return model ? model->layers[model->num_layers - 1].output_size : 0;
+}
+
+
+SynInferCtx* syn_create_infer_ctx(const SynModel *model, int max_batch_size) {
+    if (!model || max_batch_size <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for the inference context.\n");
+        return NULL;
+    }
+
+    SynInferCtx *ctx = (SynInferCtx *)malloc(sizeof(SynInferCtx));
+    if (!ctx) {
+        fprintf(stderr, "Error: Memory allocation failed for the inference context.\n");
+        return NULL;
+    }
+
+    int max_ldw = 0;
+    for (int l = 0; l < model->num_layers; ++l) {
+        if (model->layers[l].dtype == MODEL_INT8 && model->layers[l].ldw > max_ldw) {
+            max_ldw = model->layers[l].ldw;
+        }
+    }
+
+    size_t size = (size_t)max_batch_size * model->max_width * sizeof(float);
+    *ctx = (SynInferCtx){ .model = model, .capacity = max_batch_size };
+    ctx->sums = (float *)malloc(size);
+    ctx->activs = (float *)malloc(size);
+
+    if (max_ldw > 0) {
+        ctx->qinputs = (uint8_t *)malloc((size_t)max_batch_size * max_ldw);
+        ctx->qsums = (int32_t *)malloc((size_t)max_batch_size * model->max_width * sizeof(int32_t));
+    }
+
+    if (!ctx->sums || !ctx->activs || (max_ldw > 0 && (!ctx->qinputs || !ctx->qsums))) {
+        fprintf(stderr, "Error: Memory allocation failed for the inference context.\n");
+        syn_delete_infer_ctx(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+
+void syn_delete_infer_ctx(SynInferCtx *ctx) {
+    if (!ctx) return;
+
+    free(ctx->sums);
+    free(ctx->activs);
+    free(ctx->qinputs);
+    free(ctx->qsums);
+    free(ctx);
+}
+
+
+// Sums of a MODEL_INT8 layer for a batch: the inputs are quantized, multiplied
+// in int32 and the products dequantized into ctx->sums
+void quantized_layer_sums(SynInferCtx *ctx, const ModelLayer *layer, const float *in, int batch_size) {
+    const int input_size = layer->input_size;
+    const int output_size = layer->output_size;
+    const int ldw = layer->ldw;
+    const float inv_scale = 1.0f / layer->input_scale;
+    const float zero = (float)layer->input_zero;
+
+    for (int b = 0; b < batch_size; ++b) {
+        const float *x = &in[(size_t)b * input_size];
+        uint8_t *q = &ctx->qinputs[(size_t)b * ldw];
+
+        for (int j = 0; j < input_size; ++j) {
+            float v = x[j] * inv_scale + zero;
+            v = (v < 0.0f) ? 0.0f : (v > 127.0f) ? 127.0f : v;
+            q[j] = (uint8_t)lrintf(v);
+        }
+        memset(&q[input_size], 0, ldw - input_size);
+    }
+
+    kernel_qgemm(batch_size, output_size, ldw, ctx->qinputs, ldw, (const int8_t *)layer->packed, ldw,
+        ctx->qsums, output_size);
+
+    for (int b = 0; b < batch_size; ++b) {
+        size_t offset = (size_t)b * output_size;
+        for (int i = 0; i < output_size; ++i) {
+            ctx->sums[offset + i] = (float)ctx->qsums[offset + i] * layer->scales[i] + layer->biases[i];
+        }
+    }
+}
+
+
+// Sums of a MODEL_F16 or MODEL_BF16 layer, widened and summed in fp32
+void half_layer_sums(SynInferCtx *ctx, const ModelLayer *layer, const float *in, int batch_size) {
+    const int output_size = layer->output_size;
+    const int type = (layer->dtype == MODEL_BF16) ? HALF_BF16 : HALF_F16;
+
+    kernel_hgemm(type, batch_size, output_size, layer->input_size, in, layer->input_size,
+        (const uint16_t *)layer->packed, layer->ldw, ctx->sums, output_size);
+
+    for (int b = 0; b < batch_size; ++b) {
+        float *sums = &ctx->sums[(size_t)b * output_size];
+        for (int i = 0; i < output_size; ++i) {
+            sums[i] += layer->biases[i];
+        }
+    }
+}
+
+
+// Sums of a layer with reduced-precision weights
+void reduced_layer_sums(SynInferCtx *ctx, const ModelLayer *layer, const float *in, int batch_size) {
+    if (layer->dtype == MODEL_INT8) {
+        quantized_layer_sums(ctx, layer, in, batch_size);
+    } else {
+        half_layer_sums(ctx, layer, in, batch_size);
+    }
+}
+
+
+const float* syn_infer(SynInferCtx *ctx, const float *inputs) {
+    if (!ctx || !inputs) {
+        fprintf(stderr, "Error: Invalid input parameters for inference.\n");
+        return NULL;
+    }
+
+    const SynModel *model = ctx->model;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *layer = &model->layers[l];
+        const float *x = (l >= 1) ? ctx->activs : inputs;
+
+        if (layer->dtype != MODEL_F32) {
+            reduced_layer_sums(ctx, layer, x, 1);
+            kernel_bias_activ(layer->activ_op, 1, layer->output_size, NULL, ctx->sums, 0, ctx->activs, 0);
+            continue;
+        }
+
+        kernel_sgemv(layer->output_size, layer->input_size, layer->weights, layer->input_size, x, ctx->sums, 0);
+        kernel_bias_activ(layer->activ_op, 1, layer->output_size, layer->biases, ctx->sums, 0, ctx->activs, 0);
+    }
+
+    return ctx->activs;
+}
+
+
+const float* syn_infer_batch(SynInferCtx *ctx, const float *inputs, int batch_size) {
+    if (!ctx || !inputs || batch_size <= 0 || batch_size > ctx->capacity) {
+        fprintf(stderr, "Error: Invalid input parameters for batched inference.\n");
+        return NULL;
+    }
+
+    const SynModel *model = ctx->model;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *layer = &model->layers[l];
+        const float *in = (l >= 1) ? ctx->activs : inputs;
+
+        int input_size = layer->input_size;
+        int output_size = layer->output_size;
+
+        if (layer->dtype != MODEL_F32) {
+            reduced_layer_sums(ctx, layer, in, batch_size);
+            kernel_bias_activ(layer->activ_op, batch_size, output_size, NULL, ctx->sums, output_size,
+                ctx->activs, output_size);
+            continue;
+        }
+
+        // sums = in * weights^T + biases, activated in the GEMM epilogue. The
+        // epilogue would overwrite in while later tiles still read it, so
+        // elementwise activations go in place and the buffers are swapped.
+        // Softmax reads the sums only after the whole product.
+        const int in_place = layer->activ_op != ACTIV_SOFTMAX;
+        kernel_gemm_bias_activ(0, 1, batch_size, output_size, input_size,
+            in, 0, input_size, layer->weights, 0, input_size, ctx->sums, output_size,
+            layer->activ_op, layer->biases, in_place ? ctx->sums : ctx->activs, output_size);
+
+        if (in_place) {
+            float *activs = ctx->sums;
+            ctx->sums = ctx->activs;
+            ctx->activs = activs;
+        }
+    }
+
+    return ctx->activs;
+}
@@ -0,0 +1,65 @@
+#ifndef MODEL_INTERNAL_H
+#define MODEL_INTERNAL_H
+
+#include "model.h"
+
+
+// How a layer stores its weights
+typedef enum {
+    MODEL_F32,
+    MODEL_INT8,
+    MODEL_F16,
+    MODEL_BF16
+} ModelDtype;
+
+
+// MODEL_F32 layers use weights. MODEL_INT8 layers quantize their inputs to
+// q = clamp(round(x / input_scale) + input_zero, 0, 127) and hold the
+// weights in packed as output_size rows of ldw signed bytes; the int32
+// product of row i is dequantized by scales[i], and biases include the
+// input_zero correction. MODEL_F16 and MODEL_BF16 layers hold output_size
+// rows of ldw 16-bit weights in packed and keep fp32 biases.
+typedef struct {
+    int input_size;
+    int output_size;
+    float *weights;
+    float *biases;
+    int (*activ_func)(const float *restrict, float *restrict, int);
+    int activ_op;
+
+    ModelDtype dtype;
+    void *packed;
+    int ldw;
+    float *scales;
+    float input_scale;
+    int input_zero;
+} ModelLayer;
+
+
+// Parameters live in params, or in the read-only mapping of a v2 file
+struct SynModel {
+    int num_layers;
+    int max_width;
+    ModelLayer *layers;
+    void *params;
+    void *map;
+    size_t map_size;
+};
+
+
+const char* get_activ_func_name(int (*activ_func)(const float *restrict, float *restrict, int));
+int (*get_activ_func_by_name(const char *name))(const float *restrict, float *restrict, int);
+
+// The kernel ACTIV_* tag of a library activation function, -1 for others
+int get_activ_op(int (*activ_func)(const float *restrict, float *restrict, int));
+
+// Allocates a model with num_layers zeroed layers; model_alloc_params() then
+// places all weights and biases in one block of 64-byte aligned arrays once
+// the layer sizes and dtypes are set.
+SynModel* model_alloc(int num_layers);
+int model_alloc_params(SynModel *model);
+
+// Writes the current (v2) model file format
+int write_model_file(const char *filename, const ModelLayer *layers, int num_layers);
+
+#endif
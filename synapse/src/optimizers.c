@@ -2,8 +2,8 @@
 #include <stdlib.h>
 #include <math.h>
 
-#include "optimizers.h"
 #include "utils.h"
+#include "optimizers_internal.h"
 
 
 #define CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate) \
@@ -12,66 +12,39 @@
         return 1; \
     }
 
-static float _beta1 = 0.9f;
-static float _beta2 = 0.999f;
-
-
-void set_beta1(float new_beta1) {
-    if (new_beta1 < 0.0f || new_beta1 >= 1.0f) {
-        fprintf(stderr, "Error: beta1 should be in the range [0, 1).\n");
-        return;
-    }
-    _beta1 = new_beta1;
-}
-
-
-void set_beta2(float new_beta2) {
-    if (new_beta2 < 0.0f || new_beta2 >= 1.0f) {
-        fprintf(stderr, "Error: beta2 should be in the range [0, 1).\n");
-        return;
-    }
-    _beta2 = new_beta2;
-}
-
 
 void free_optimizer_cache(OptimizerCache **cache) {
     if (!cache || !*cache) return;
 
-    if ((*cache)->w_momentum) {
-        free((*cache)->w_momentum);
-        (*cache)->w_momentum = NULL;
-    }
-
-    if ((*cache)->b_momentum) {
-        free((*cache)->b_momentum);
-        (*cache)->b_momentum = NULL;
-    }
+    free(*cache);
+    *cache = NULL;
+}
 
-    if ((*cache)->w_squared_grads) {
-        free((*cache)->w_squared_grads);
-        (*cache)->w_squared_grads = NULL;
-    }
 
-    if ((*cache)->b_squared_grads) {
-        free((*cache)->b_squared_grads);
-        (*cache)->b_squared_grads = NULL;
-    }
+int optimizer_num_moments(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int)) {
+    if (optimizer == momentum || optimizer == adagrad || optimizer == rmsprop) return 1;
+    if (optimizer == adam) return 2;
 
-    free(*cache);
-    *cache = NULL;
+    return 0;
 }
 
 
 OptimizerCache* init_optimizer_cache(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
-    int num_weights,
-    int num_biases
+    float *moments,
+    int size
 ) {
-    if (!optimizer || num_weights <= 0 || num_biases <= 0) {
+    if (!optimizer || size <= 0) {
         fprintf(stderr, "Error: Invalid input parameters for optimizer cache.\n");
         return NULL;
     }
 
-    if (optimizer == sgd) return NULL;
+    int num_moments = optimizer_num_moments(optimizer);
+    if (num_moments == 0) return NULL;
+
+    if (!moments) {
+        fprintf(stderr, "Error: Invalid input parameters for optimizer cache.\n");
+        return NULL;
+    }
 
     OptimizerCache *cache = (OptimizerCache *)malloc(sizeof(OptimizerCache));
     if (!cache) {
@@ -79,48 +52,80 @@ OptimizerCache* init_optimizer_cache(int (*optimizer)(float *restrict, const flo
         return NULL;
     }
 
-    cache->w_momentum = NULL;
-    cache->b_momentum = NULL;
-
-    cache->w_squared_grads = NULL;
-    cache->b_squared_grads = NULL;
+    cache->momentum = NULL;
+    cache->squared_grads = NULL;
 
-    cache->w_start = 0;
-    cache->b_start = 0;
+    cache->t = 0;
+    cache->beta1 = 0.9f;
+    cache->beta2 = 0.999f;
 
     if (optimizer == momentum) {
-        cache->w_momentum = (float *)calloc(num_weights, sizeof(float));
-        cache->b_momentum = (float *)calloc(num_biases, sizeof(float));
+        cache->momentum = moments;
+    } else if (optimizer == adagrad || optimizer == rmsprop) {
+        cache->squared_grads = moments;
+    } else {
+        cache->momentum = moments;
+        cache->squared_grads = moments + size;
+    }
+
+    return cache;
+}
 
-        if (!cache->w_momentum || !cache->b_momentum) goto cleanup;
 
-    } else if (optimizer == adagrad || optimizer == rmsprop) {
-        cache->w_squared_grads = (float *)calloc(num_weights, sizeof(float));
-        cache->b_squared_grads = (float *)calloc(num_biases, sizeof(float));
+int optimizer_begin_step(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    OptimizerCache *cache,
+    float learning_rate,
+    OptimStep *step
+) {
+    int rule = -1;
 
-        if (!cache->w_squared_grads || !cache->b_squared_grads) goto cleanup;
+    if (optimizer == sgd) rule = OPTIM_SGD;
+    else if (optimizer == momentum) rule = OPTIM_MOMENTUM;
+    else if (optimizer == adagrad) rule = OPTIM_ADAGRAD;
+    else if (optimizer == rmsprop) rule = OPTIM_RMSPROP;
+    else if (optimizer == adam) rule = OPTIM_ADAM;
 
-    } else if (optimizer == adam) {
-        cache->w_momentum = (float *)calloc(num_weights, sizeof(float));
-        cache->b_momentum = (float *)calloc(num_biases, sizeof(float));
+    if (rule < 0 || (rule != OPTIM_SGD && !cache)) return 1;
 
-        cache->w_squared_grads = (float *)calloc(num_weights, sizeof(float));
-        cache->b_squared_grads = (float *)calloc(num_biases, sizeof(float));
+    *step = (OptimStep){ rule, learning_rate, 0.0f, 0.0f, 1.0f, EPSILON };
+    if (rule == OPTIM_SGD) return 0;
 
-        if (!cache->w_momentum || !cache->b_momentum || !cache->w_squared_grads || !cache->b_squared_grads) {
-            goto cleanup;
-        }
+    cache->t += 1;
+    step->beta1 = cache->beta1;
+    step->beta2 = cache->beta2;
 
-    } else {
-        free(cache);
-        cache = NULL;
+    if (rule == OPTIM_ADAM) {
+        step->learning_rate = learning_rate / (1.0f - powf(cache->beta1, cache->t));
+        step->v_scale = 1.0f / sqrtf(1.0f - powf(cache->beta2, cache->t));
     }
 
-    return cache;
+    return 0;
+}
+
 
-cleanup:
-    free_optimizer_cache(&cache);
-    return NULL;
+void optimizer_apply(const OptimStep *step, OptimizerCache *cache, float *weights, const float *weight_grads,
+    long begin, long end
+) {
+    float *m = (cache && cache->momentum) ? &cache->momentum[begin] : NULL;
+    float *v = (cache && cache->squared_grads) ? &cache->squared_grads[begin] : NULL;
+
+    kernel_optim_step(step, end - begin, &weights[begin], &weight_grads[begin], m, v);
+}
+
+
+// Shared body of the public optimizers: one step over the whole vector
+int optimizer_update(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    float *weights, const float *weight_grads, int size, float learning_rate, OptimizerCache *cache
+) {
+    OptimStep step;
+
+    if (optimizer_begin_step(optimizer, cache, learning_rate, &step)) {
+        fprintf(stderr, "Error: Optimizer cache not initialized.\n");
+        return 1;
+    }
+
+    optimizer_apply(&step, cache, weights, weight_grads, 0, size);
+    return 0;
 }
 
 
@@ -133,14 +138,9 @@ int sgd(float *restrict weights,
 ) {
     CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate);
 
-    (void)cache;
     (void)flag;
-    
-    for (int i = 0; i < size; ++i) {
-        weights[i] -= learning_rate * weight_grads[i];
-    }
 
-    return 0;
+    return optimizer_update(sgd, weights, weight_grads, size, learning_rate, cache);
 }
 
 
@@ -153,23 +153,9 @@ int momentum(float *restrict weights,
 ) {
     CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate);
 
-    int start = 0;
-    float *momentum = NULL;
-
-    if (flag) {
-        start = cache->w_start;
-        momentum = cache->w_momentum;
-    } else {
-        start = cache->b_start;
-        momentum = cache->b_momentum;
-    }
-    
-    for (int i = 0; i < size; ++i) {
-        momentum[start + i] = momentum[start + i] * _beta1 + (1 - _beta1) * weight_grads[i];
-        weights[i] -= learning_rate * momentum[start + i];
-    }
+    (void)flag;
 
-    return 0;
+    return optimizer_update(momentum, weights, weight_grads, size, learning_rate, cache);
 }
 
 
@@ -182,23 +168,9 @@ int adagrad(float *restrict weights,
 ) {
     CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate);
 
-    int start = 0;
-    float *squared_grads = NULL;
-
-    if (flag) {
-        start = cache->w_start;
-        squared_grads = cache->w_squared_grads;
-    } else {
-        start = cache->b_start;
-        squared_grads = cache->b_squared_grads;
-    }
-    
-    for (int i = 0; i < size; ++i) {
-        squared_grads[start + i] += weight_grads[i] * weight_grads[i];
-        weights[i] -= learning_rate * weight_grads[i] / (sqrtf(squared_grads[start + i]) + EPSILON);
-    }
+    (void)flag;
 
-    return 0;
+    return optimizer_update(adagrad, weights, weight_grads, size, learning_rate, cache);
 }
 
 
@@ -211,23 +183,9 @@ int rmsprop(float *restrict weights,
 ) {
     CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate);
 
-    int start = 0;
-    float *squared_grads = NULL;
-
-    if (flag) {
-        start = cache->w_start;
-        squared_grads = cache->w_squared_grads;
-    } else {
-        start = cache->b_start;
-        squared_grads = cache->b_squared_grads;
-    }
-    
-    for (int i = 0; i < size; ++i) {
-        squared_grads[start + i] = squared_grads[start + i] * _beta2 + (1 - _beta2) * weight_grads[i] * weight_grads[i];
-        weights[i] -= learning_rate * weight_grads[i] / (sqrtf(squared_grads[start + i]) + EPSILON);
-    }
+    (void)flag;
 
-    return 0;
+    return optimizer_update(rmsprop, weights, weight_grads, size, learning_rate, cache);
 }
 
 
@@ -240,32 +198,7 @@ int adam(float *restrict weights,
 ) {
     CHECK_OPTIM_ARGS(weights, weight_grads, size, learning_rate);
 
-    static int t = 0;
-    t += 1;
-
-    int start = 0;
-    float *momentum = NULL;
-    float *squared_grads = NULL;
-
-    if (flag) {
-        start = cache->w_start;
-        momentum = cache->w_momentum;
-        squared_grads = cache->w_squared_grads;
-    } else {
-        start = cache->b_start;
-        momentum = cache->b_momentum;
-        squared_grads = cache->b_squared_grads;
-    }
-
-    for (int i = 0; i < size; ++i) {
-        momentum[start + i] = momentum[start + i] * _beta1 + (1 - _beta1) * weight_grads[i];
-        squared_grads[start + i] = squared_grads[start + i] * _beta2 + (1 - _beta2) * weight_grads[i] * weight_grads[i];
-
-        float m_hat = momentum[start + i] / (1 - powf(_beta1, t));
-        float v_hat = squared_grads[start + i] / (1 - powf(_beta2, t));
-
-        weights[i] -= learning_rate * m_hat / (sqrtf(v_hat) + EPSILON);
-    }
+    (void)flag;
 
-    return 0;
+    return optimizer_update(adam, weights, weight_grads, size, learning_rate, cache);
 }
@@ -0,0 +1,21 @@
+#ifndef OPTIMIZERS_INTERNAL_H
+#define OPTIMIZERS_INTERNAL_H
+
+#include "optimizers.h"
+#include "kernels/kernels.h"
+
+
+// Advances the step counter in cache and fills in the per-step scalars.
+// Returns 1 for an optimizer that is not one of the built-in rules.
+int optimizer_begin_step(int (*optimizer)(float *restrict, const float *restrict, int, float, OptimizerCache *, int),
+    OptimizerCache *cache,
+    float learning_rate,
+    OptimStep *step
+);
+
+// Applies a prepared step to parameters [begin, end) of the flat vectors
+void optimizer_apply(const OptimStep *step, OptimizerCache *cache, float *weights, const float *weight_grads,
+    long begin, long end
+);
+
+#endif
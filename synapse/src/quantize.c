@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "model_internal.h"
+#include "kernels/kernels.h"
+
+
+// Samples per calibration forward pass
+#define CALIB_BATCH 256
+
+
+typedef struct {
+    float min;
+    float max;
+} Range;
+
+
+// fp32 forward over the calibration samples recording the range of the
+// inputs of every layer
+int calibrate_ranges(const SynModel *model, const float *inputs, int num_samples, Range *ranges) {
+    size_t size = (size_t)CALIB_BATCH * model->max_width * sizeof(float);
+    float *sums = (float *)malloc(size);
+    float *activs = (float *)malloc(size);
+    if (!sums || !activs) {
+        fprintf(stderr, "Error: Memory allocation failed for calibration.\n");
+        free(sums);
+        free(activs);
+        return 1;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        ranges[l] = (Range){ INFINITY, -INFINITY };
+    }
+
+    const int input_size = model->layers[0].input_size;
+
+    for (int start = 0; start < num_samples; start += CALIB_BATCH) {
+        int batch_size = (num_samples - start < CALIB_BATCH) ? num_samples - start : CALIB_BATCH;
+
+        for (int l = 0; l < model->num_layers; ++l) {
+            const ModelLayer *layer = &model->layers[l];
+            const float *in = (l >= 1) ? activs : &inputs[(size_t)start * input_size];
+            const int output_size = layer->output_size;
+
+            for (size_t j = 0; j < (size_t)batch_size * layer->input_size; ++j) {
+                if (in[j] < ranges[l].min) ranges[l].min = in[j];
+                if (in[j] > ranges[l].max) ranges[l].max = in[j];
+            }
+
+            // Elementwise activations go in place and swap buffers, as in syn_infer_batch()
+            const int in_place = layer->activ_op != ACTIV_SOFTMAX;
+            kernel_gemm_bias_activ(0, 1, batch_size, output_size, layer->input_size,
+                in, 0, layer->input_size, layer->weights, 0, layer->input_size, sums, output_size,
+                layer->activ_op, layer->biases, in_place ? sums : activs, output_size);
+
+            if (in_place) {
+                float *out = sums;
+                sums = activs;
+                activs = out;
+            }
+        }
+    }
+
+    free(sums);
+    free(activs);
+    return 0;
+}
+
+
+// Non-negative inputs use all of [0, 127]; signed ones are centred on 64.
+// Seven bits keep the products of vpmaddubsw exact on every kernel.
+void choose_input_quant(Range range, float *scale, int *zero) {
+    if (range.min >= 0.0f) {
+        *zero = 0;
+        *scale = range.max / 127.0f;
+    } else {
+        *zero = 64;
+        *scale = fmaxf(-range.min / 64.0f, range.max / 63.0f);
+    }
+
+    if (!(*scale > 0.0f) || !isfinite(*scale)) *scale = 1.0f;
+}
+
+
+// Symmetric per-row weight quantization; the zero-point correction of the
+// inputs is folded into the biases
+void quantize_layer(const ModelLayer *src, ModelLayer *dst) {
+    int8_t *packed = (int8_t *)dst->packed;
+    memset(packed, 0, (size_t)dst->output_size * dst->ldw);
+
+    for (int i = 0; i < src->output_size; ++i) {
+        const float *w = &src->weights[(size_t)i * src->input_size];
+        int8_t *q = &packed[(size_t)i * dst->ldw];
+
+        float amax = 0.0f;
+        for (int j = 0; j < src->input_size; ++j) {
+            amax = fmaxf(amax, fabsf(w[j]));
+        }
+
+        float w_scale = (amax > 0.0f) ? amax / 127.0f : 1.0f;
+        long row_sum = 0;
+
+        for (int j = 0; j < src->input_size; ++j) {
+            float v = w[j] / w_scale;
+            v = (v < -127.0f) ? -127.0f : (v > 127.0f) ? 127.0f : v;
+            q[j] = (int8_t)lrintf(v);
+            row_sum += q[j];
+        }
+
+        dst->scales[i] = dst->input_scale * w_scale;
+        dst->biases[i] = src->biases[i] - dst->scales[i] * (float)dst->input_zero * (float)row_sum;
+    }
+}
+
+
+SynModel* syn_quantize_model(const SynModel *model, const float *calib_inputs, int num_samples) {
+    if (!model || !calib_inputs || num_samples <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for model quantization.\n");
+        return NULL;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        if (model->layers[l].dtype != MODEL_F32) {
+            fprintf(stderr, "Error: Model is already quantized.\n");
+            return NULL;
+        }
+    }
+
+    Range *ranges = (Range *)malloc(model->num_layers * sizeof(Range));
+    if (!ranges) {
+        fprintf(stderr, "Error: Memory allocation failed for calibration.\n");
+        return NULL;
+    }
+
+    if (calibrate_ranges(model, calib_inputs, num_samples, ranges)) {
+        free(ranges);
+        return NULL;
+    }
+
+    SynModel *quantized = model_alloc(model->num_layers);
+    if (!quantized) {
+        free(ranges);
+        return NULL;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *src = &model->layers[l];
+        ModelLayer *dst = &quantized->layers[l];
+
+        *dst = (ModelLayer){
+            .input_size = src->input_size,
+            .output_size = src->output_size,
+            .activ_func = src->activ_func,
+            .activ_op = src->activ_op,
+            .dtype = MODEL_INT8,
+            .ldw = (src->input_size + QUANT_BLOCK - 1) / QUANT_BLOCK * QUANT_BLOCK,
+        };
+        choose_input_quant(ranges[l], &dst->input_scale, &dst->input_zero);
+    }
+
+    free(ranges);
+
+    if (model_alloc_params(quantized)) {
+        syn_delete_model(quantized);
+        return NULL;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        quantize_layer(&model->layers[l], &quantized->layers[l]);
+    }
+
+    return quantized;
+}
+
+
+SynModel* syn_model_to_half(const SynModel *model, SynHalfType type) {
+    if (!model || (type != SYN_HALF_F16 && type != SYN_HALF_BF16)) {
+        fprintf(stderr, "Error: Invalid input parameters for model conversion.\n");
+        return NULL;
+    }
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        if (model->layers[l].dtype != MODEL_F32) {
+            fprintf(stderr, "Error: Model is already quantized.\n");
+            return NULL;
+        }
+    }
+
+    SynModel *converted = model_alloc(model->num_layers);
+    if (!converted) return NULL;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *src = &model->layers[l];
+
+        converted->layers[l] = (ModelLayer){
+            .input_size = src->input_size,
+            .output_size = src->output_size,
+            .activ_func = src->activ_func,
+            .activ_op = src->activ_op,
+            .dtype = (type == SYN_HALF_BF16) ? MODEL_BF16 : MODEL_F16,
+            .ldw = src->input_size,
+        };
+    }
+
+    if (model_alloc_params(converted)) {
+        syn_delete_model(converted);
+        return NULL;
+    }
+
+    const int half_type = (type == SYN_HALF_BF16) ? HALF_BF16 : HALF_F16;
+
+    for (int l = 0; l < model->num_layers; ++l) {
+        const ModelLayer *src = &model->layers[l];
+        ModelLayer *dst = &converted->layers[l];
+        uint16_t *packed = (uint16_t *)dst->packed;
+
+        for (size_t j = 0; j < (size_t)src->input_size * src->output_size; ++j) {
+            packed[j] = float_to_half(half_type, src->weights[j]);
+        }
+        memcpy(dst->biases, src->biases, src->output_size * sizeof(float));
+    }
+
+    return converted;
+}
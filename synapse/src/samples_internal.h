@@ -0,0 +1,30 @@
+#ifndef SAMPLES_INTERNAL_H
+#define SAMPLES_INTERNAL_H
+
+#include <stdlib.h>
+
+#define SAMPLE_ALIGN 64
+
+
+// Sample buffers start on a cache line and always allocate, even for size 0;
+// free() releases them
+static inline void* alloc_samples(size_t size) {
+    return aligned_alloc(SAMPLE_ALIGN, (size / SAMPLE_ALIGN + 1) * SAMPLE_ALIGN);
+}
+
+
+// num_rows rows of row_floats 4-byte values
+static inline void* alloc_sample_rows(long num_rows, int row_floats) {
+    return alloc_samples((size_t)num_rows * row_floats * sizeof(float));
+}
+
+
+// splitmix64, so a shuffle is reproducible from its seed
+static inline unsigned long long next_random(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#endif
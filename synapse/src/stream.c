@@ -0,0 +1,486 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "stream.h"
+#include "tensor_file_internal.h"
+#include "samples_internal.h"
+
+
+#define DEFAULT_SHARD_ROWS 4096
+#define DEFAULT_NUM_SHARDS 4
+
+
+typedef enum {
+    SHARD_FREE,
+    SHARD_FILLED
+} ShardState;
+
+
+typedef struct {
+    float *inputs;
+    float *labels;
+    long count;     // 0 marks the end of a pass, -1 a failed read
+    ShardState state;
+} Shard;
+
+
+typedef struct {
+    int fd;
+    int dtype;
+    uint64_t data_offset;
+    size_t row_size;
+    int row_floats;     // 4-byte values per row
+} StreamFile;
+
+
+struct SynStream {
+    StreamFile files[2];
+    long num_samples;
+    int batch_size;
+    long shard_rows;
+    int num_shards;
+
+    // Ring filled by the reader thread and drained in order by the caller
+    Shard *ring;
+    int next_read;
+    Shard *current;
+    long current_pos;
+
+    // Shuffle window of up to window_capacity samples
+    long window_capacity;
+    long window_count;
+    float *window_inputs;
+    float *window_labels;
+    unsigned long long rng;
+
+    float *batch_inputs;
+    float *batch_labels;
+
+    int pass_over;
+    int failed;
+
+    pthread_t reader;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stop;
+};
+
+
+// Float rows, or with allow_classes also a single int32 class index column
+static int open_stream_file(StreamFile *file, const char *filename, int allow_classes, long *num_rows) {
+    file->fd = open(filename, O_RDONLY);
+    if (file->fd < 0) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        return 1;
+    }
+
+    struct stat st;
+    unsigned char bytes[TENSOR_HEADER_SIZE];
+    TensorHeader header;
+
+    if (fstat(file->fd, &st) != 0 || pread(file->fd, bytes, TENSOR_HEADER_SIZE, 0) != TENSOR_HEADER_SIZE) {
+        fprintf(stderr, "Error: '%s' is not a tensor file.\n", filename);
+        return 1;
+    }
+
+    if (decode_tensor_header(bytes, (uint64_t)st.st_size, filename, &header)) return 1;
+
+    const int is_classes = allow_classes && header.dtype == SYN_DTYPE_I32 && header.num_cols == 1;
+    if (header.dtype != SYN_DTYPE_F32 && !is_classes) {
+        fprintf(stderr, "Error: Streaming requires float tensor file, '%s' is not.\n", filename);
+        return 1;
+    }
+
+    file->dtype = (int)header.dtype;
+    file->data_offset = header.data_offset;
+    file->row_floats = (int)header.num_cols;
+    file->row_size = (size_t)header.num_cols * sizeof(float);
+    *num_rows = (long)header.num_rows;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Larger kernel readahead for the front-to-back reads
+    posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return 0;
+}
+
+
+static int read_stream_rows(const StreamFile *file, long first_row, long count, float *dst) {
+    char *out = (char *)dst;
+    size_t remaining = (size_t)count * file->row_size;
+    off_t offset = (off_t)(file->data_offset + (uint64_t)first_row * file->row_size);
+
+    while (remaining > 0) {
+        ssize_t got = pread(file->fd, out, remaining, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 1;
+
+        out += got;
+        offset += got;
+        remaining -= (size_t)got;
+    }
+
+#ifdef POSIX_FADV_WILLNEED
+    // Start reading the following shard while the caller works through this one
+    posix_fadvise(file->fd, offset, (off_t)((size_t)count * file->row_size), POSIX_FADV_WILLNEED);
+#endif
+
+    return 0;
+}
+
+
+// Fills the ring shard by shard, with an end-of-pass marker after the last
+// row, then starts over from the first row.
+static void* reader_main(void *arg) {
+    SynStream *stream = (SynStream *)arg;
+    long row = 0;
+    int next_write = 0;
+
+    for (;;) {
+        Shard *shard = &stream->ring[next_write];
+
+        pthread_mutex_lock(&stream->mutex);
+        while (!stream->stop && shard->state != SHARD_FREE) {
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        }
+        int stop = stream->stop;
+        pthread_mutex_unlock(&stream->mutex);
+
+        if (stop) break;
+
+        if (row == stream->num_samples) {
+            shard->count = 0;
+            row = 0;
+        } else {
+            long count = (stream->num_samples - row < stream->shard_rows) ? stream->num_samples - row : stream->shard_rows;
+
+            if (read_stream_rows(&stream->files[0], row, count, shard->inputs) ||
+                read_stream_rows(&stream->files[1], row, count, shard->labels)
+            ) {
+                shard->count = -1;
+            } else {
+                shard->count = count;
+            }
+            row += count;
+        }
+
+        pthread_mutex_lock(&stream->mutex);
+        shard->state = SHARD_FILLED;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+
+        // Nothing is read after an error
+        if (shard->count < 0) break;
+        next_write = (next_write + 1) % stream->num_shards;
+    }
+
+    return NULL;
+}
+
+
+static void free_stream(SynStream *stream) {
+    for (int f = 0; f < 2; ++f) {
+        if (stream->files[f].fd >= 0) close(stream->files[f].fd);
+    }
+
+    if (stream->ring) {
+        for (int s = 0; s < stream->num_shards; ++s) {
+            free(stream->ring[s].inputs);
+            free(stream->ring[s].labels);
+        }
+    }
+
+    free(stream->ring);
+    free(stream->window_inputs);
+    free(stream->window_labels);
+    free(stream->batch_inputs);
+    free(stream->batch_labels);
+    free(stream);
+}
+
+
+SynStream* syn_stream_open(const char *data_file, const char *labels_file, const SynStreamConfig *config) {
+    if (!data_file || !labels_file || !config || config->batch_size <= 0 ||
+        config->shard_rows < 0 || config->num_shards < 0 || config->shuffle_window < 0
+    ) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return NULL;
+    }
+
+    SynStream *stream = (SynStream *)calloc(1, sizeof(SynStream));
+    if (!stream) {
+        fprintf(stderr, "Error: Memory allocation failed for stream.\n");
+        return NULL;
+    }
+
+    stream->files[0].fd = -1;
+    stream->files[1].fd = -1;
+
+    long num_labels = 0;
+    if (open_stream_file(&stream->files[0], data_file, 0, &stream->num_samples) ||
+        open_stream_file(&stream->files[1], labels_file, 1, &num_labels)
+    ) {
+        free_stream(stream);
+        return NULL;
+    }
+
+    if (stream->num_samples != num_labels) {
+        fprintf(stderr, "Error: '%s' and '%s' hold different numbers of samples.\n", data_file, labels_file);
+        free_stream(stream);
+        return NULL;
+    }
+
+    if (stream->num_samples == 0) {
+        fprintf(stderr, "Error: '%s' holds no samples.\n", data_file);
+        free_stream(stream);
+        return NULL;
+    }
+
+    const int input_size = stream->files[0].row_floats;
+    const int label_size = stream->files[1].row_floats;
+
+    stream->batch_size = config->batch_size;
+    stream->shard_rows = config->shard_rows ? config->shard_rows : DEFAULT_SHARD_ROWS;
+    stream->num_shards = config->num_shards ? config->num_shards : DEFAULT_NUM_SHARDS;
+    stream->window_capacity = config->shuffle_window;
+    stream->rng = config->seed;
+
+    stream->ring = (Shard *)calloc(stream->num_shards, sizeof(Shard));
+    stream->batch_inputs = (float *)alloc_sample_rows(stream->batch_size, input_size);
+    stream->batch_labels = (float *)alloc_sample_rows(stream->batch_size, label_size);
+
+    int ok = stream->ring && stream->batch_inputs && stream->batch_labels;
+
+    for (int s = 0; ok && s < stream->num_shards; ++s) {
+        stream->ring[s].inputs = (float *)alloc_sample_rows(stream->shard_rows, input_size);
+        stream->ring[s].labels = (float *)alloc_sample_rows(stream->shard_rows, label_size);
+        ok = stream->ring[s].inputs && stream->ring[s].labels;
+    }
+
+    if (ok && stream->window_capacity > 0) {
+        stream->window_inputs = (float *)alloc_sample_rows(stream->window_capacity, input_size);
+        stream->window_labels = (float *)alloc_sample_rows(stream->window_capacity, label_size);
+        ok = stream->window_inputs && stream->window_labels;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Error: Memory allocation failed for stream buffers.\n");
+        free_stream(stream);
+        return NULL;
+    }
+
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+
+    if (pthread_create(&stream->reader, NULL, reader_main, stream) != 0) {
+        fprintf(stderr, "Error: Failed to start the stream reader thread.\n");
+        pthread_mutex_destroy(&stream->mutex);
+        pthread_cond_destroy(&stream->cond);
+        free_stream(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+void syn_stream_close(SynStream *stream) {
+    if (!stream) return;
+
+    pthread_mutex_lock(&stream->mutex);
+    stream->stop = 1;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->mutex);
+
+    pthread_join(stream->reader, NULL);
+    pthread_mutex_destroy(&stream->mutex);
+    pthread_cond_destroy(&stream->cond);
+
+    free_stream(stream);
+}
+
+
+long syn_stream_num_samples(const SynStream *stream) {
+    return stream ? stream->num_samples : 0;
+}
+
+
+int syn_stream_input_size(const SynStream *stream) {
+    return stream ? stream->files[0].row_floats : 0;
+}
+
+
+int syn_stream_label_size(const SynStream *stream) {
+    return stream ? stream->files[1].row_floats : 0;
+}
+
+
+// Points at the next sample of the current pass. Returns 1, 0 at the end
+// of the pass or -1 on a read error.
+static int next_sample(SynStream *stream, const float **inputs, const float **labels) {
+    if (stream->current && stream->current_pos == stream->current->count) {
+        pthread_mutex_lock(&stream->mutex);
+        stream->current->state = SHARD_FREE;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+        stream->current = NULL;
+    }
+
+    if (!stream->current) {
+        Shard *shard = &stream->ring[stream->next_read];
+
+        pthread_mutex_lock(&stream->mutex);
+        while (shard->state != SHARD_FILLED) {
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        }
+
+        // The marker shard is handed back at once; a failed one stays filled
+        long count = shard->count;
+        if (count <= 0) {
+            if (count == 0) {
+                shard->state = SHARD_FREE;
+                pthread_cond_broadcast(&stream->cond);
+                stream->next_read = (stream->next_read + 1) % stream->num_shards;
+            }
+            pthread_mutex_unlock(&stream->mutex);
+            return (int)count;
+        }
+
+        pthread_mutex_unlock(&stream->mutex);
+
+        stream->current = shard;
+        stream->current_pos = 0;
+        stream->next_read = (stream->next_read + 1) % stream->num_shards;
+    }
+
+    long pos = stream->current_pos++;
+    *inputs = &stream->current->inputs[(size_t)pos * stream->files[0].row_floats];
+    *labels = &stream->current->labels[(size_t)pos * stream->files[1].row_floats];
+    return 1;
+}
+
+
+static void copy_sample(const SynStream *stream, float *dst_inputs, float *dst_labels, long dst,
+    const float *inputs, const float *labels
+) {
+    memcpy(&dst_inputs[(size_t)dst * stream->files[0].row_floats], inputs, stream->files[0].row_size);
+    memcpy(&dst_labels[(size_t)dst * stream->files[1].row_floats], labels, stream->files[1].row_size);
+}
+
+
+// Pulls the next sample of the pass into window slot dst; returns 0 once the pass is over
+static int refill_window(SynStream *stream, long dst) {
+    const float *inputs, *labels;
+    int status = next_sample(stream, &inputs, &labels);
+
+    if (status < 0) {
+        stream->failed = 1;
+        return 0;
+    }
+
+    if (status == 0) {
+        stream->pass_over = 1;
+        return 0;
+    }
+
+    copy_sample(stream, stream->window_inputs, stream->window_labels, dst, inputs, labels);
+    return 1;
+}
+
+
+// Label rows are moved as raw 4-byte values, whichever their type
+static int next_stream_batch(SynStream *stream, const float **inputs, const float **labels) {
+    int count = 0;
+
+    if (stream->window_capacity == 0) {
+        // File order: samples go straight from the ring into the batch
+        while (count < stream->batch_size && !stream->pass_over && !stream->failed) {
+            const float *x, *y;
+            int status = next_sample(stream, &x, &y);
+
+            if (status > 0) {
+                copy_sample(stream, stream->batch_inputs, stream->batch_labels, count++, x, y);
+            } else if (status == 0) {
+                stream->pass_over = 1;
+            } else {
+                stream->failed = 1;
+            }
+        }
+    } else {
+        while (!stream->pass_over && !stream->failed && stream->window_count < stream->window_capacity) {
+            stream->window_count += refill_window(stream, stream->window_count);
+        }
+
+        // Emit a random window sample and put the next incoming one in its place
+        while (count < stream->batch_size && stream->window_count > 0 && !stream->failed) {
+            long j = (long)(next_random(&stream->rng) % (unsigned long long)stream->window_count);
+            const int input_size = stream->files[0].row_floats;
+            const int label_size = stream->files[1].row_floats;
+
+            copy_sample(stream, stream->batch_inputs, stream->batch_labels, count++,
+                &stream->window_inputs[(size_t)j * input_size], &stream->window_labels[(size_t)j * label_size]);
+
+            if (stream->pass_over || !refill_window(stream, j)) {
+                long last = --stream->window_count;
+                if (j != last) {
+                    copy_sample(stream, stream->window_inputs, stream->window_labels, j,
+                        &stream->window_inputs[(size_t)last * input_size], &stream->window_labels[(size_t)last * label_size]);
+                }
+            }
+        }
+    }
+
+    if (stream->failed) {
+        fprintf(stderr, "Error: Failed to read from the stream files.\n");
+        return -1;
+    }
+
+    if (count == 0) {
+        // End of the pass; the next call starts over
+        stream->pass_over = 0;
+        return 0;
+    }
+
+    *inputs = stream->batch_inputs;
+    if (labels) *labels = stream->batch_labels;
+
+    return count;
+}
+
+
+int syn_stream_has_classes(const SynStream *stream) {
+    return stream && stream->files[1].dtype == SYN_DTYPE_I32;
+}
+
+
+int syn_stream_next(SynStream *stream, const float **inputs, const float **labels) {
+    if (!stream || !inputs || (labels && syn_stream_has_classes(stream))) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return -1;
+    }
+
+    return next_stream_batch(stream, inputs, labels);
+}
+
+
+int syn_stream_next_classes(SynStream *stream, const float **inputs, const int32_t **classes) {
+    if (!stream || !inputs || (classes && !syn_stream_has_classes(stream))) {
+        fprintf(stderr, "Error in %s(): Invalid input parameters.\n", __func__);
+        return -1;
+    }
+
+    const float *labels;
+    int count = next_stream_batch(stream, inputs, &labels);
+    if (count > 0 && classes) *classes = (const int32_t *)labels;
+
+    return count;
+}
@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tensor_file_internal.h"
+
+
+#define TENSOR_MAGIC "SYNT"
+
+
+struct SynTensorFile {
+    void *map;
+    size_t map_size;
+    const unsigned char *data;
+    long num_rows;
+    long num_cols;
+    SynDtype dtype;
+    size_t row_size;
+};
+
+
+size_t syn_dtype_size(SynDtype dtype) {
+    switch (dtype) {
+        case SYN_DTYPE_F32: return sizeof(float);
+        case SYN_DTYPE_U8: return sizeof(uint8_t);
+        case SYN_DTYPE_I32: return sizeof(int32_t);
+    }
+    return 0;
+}
+
+
+// Header fields are stored little-endian, which is the layout of every
+// supported host, so they are copied as-is.
+void encode_header(unsigned char *header, SynDtype dtype, long num_rows, long num_cols) {
+    uint32_t fields[3] = { SYN_TENSOR_VERSION, (uint32_t)dtype, SYN_TENSOR_ALIGNMENT };
+    uint64_t sizes[3] = { (uint64_t)num_rows, (uint64_t)num_cols, TENSOR_HEADER_SIZE };
+
+    memset(header, 0, TENSOR_HEADER_SIZE);
+    memcpy(header, TENSOR_MAGIC, 4);
+    memcpy(header + 4, fields, sizeof(fields));
+    memcpy(header + 16, sizes, sizeof(sizes));
+}
+
+
+int decode_tensor_header(const unsigned char *bytes, uint64_t file_size, const char *filename, TensorHeader *header) {
+    uint32_t fields[3];
+    uint64_t sizes[3];
+
+    memcpy(fields, bytes + 4, sizeof(fields));
+    memcpy(sizes, bytes + 16, sizeof(sizes));
+
+    SynDtype dtype = (SynDtype)fields[1];
+    size_t elem_size = syn_dtype_size(dtype);
+    uint64_t num_rows = sizes[0], num_cols = sizes[1], data_offset = sizes[2];
+
+    if (memcmp(bytes, TENSOR_MAGIC, 4) != 0 || fields[0] != SYN_TENSOR_VERSION || elem_size == 0 ||
+        fields[2] != SYN_TENSOR_ALIGNMENT
+    ) {
+        fprintf(stderr, "Error: '%s' is not a supported tensor file.\n", filename);
+        return 1;
+    }
+
+    // Column counts are used as int, and the row size must not wrap
+    if (num_cols == 0 || num_cols > INT_MAX || num_cols > UINT64_MAX / elem_size ||
+        data_offset < TENSOR_HEADER_SIZE || data_offset % SYN_TENSOR_ALIGNMENT != 0 || data_offset > file_size ||
+        num_rows > (file_size - data_offset) / (num_cols * elem_size)
+    ) {
+        fprintf(stderr, "Error: Tensor file '%s' is truncated or corrupt.\n", filename);
+        return 1;
+    }
+
+    *header = (TensorHeader){ dtype, num_rows, num_cols, data_offset };
+    return 0;
+}
+
+
+SynTensorFile* syn_tensor_open(const char *filename) {
+    if (!filename) {
+        fprintf(stderr, "Error: Invalid file name provided.\n");
+        return NULL;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < TENSOR_HEADER_SIZE) {
+        fprintf(stderr, "Error: '%s' is not a tensor file.\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map file '%s'.\n", filename);
+        return NULL;
+    }
+
+    TensorHeader header;
+    if (decode_tensor_header((const unsigned char *)map, (uint64_t)st.st_size, filename, &header)) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    SynTensorFile *file = (SynTensorFile *)malloc(sizeof(SynTensorFile));
+    if (!file) {
+        fprintf(stderr, "Error: Memory allocation failed for tensor file.\n");
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    file->map = map;
+    file->map_size = (size_t)st.st_size;
+    file->data = (const unsigned char *)map + header.data_offset;
+    file->num_rows = (long)header.num_rows;
+    file->num_cols = (long)header.num_cols;
+    file->dtype = header.dtype;
+    file->row_size = (size_t)header.num_cols * syn_dtype_size(header.dtype);
+
+    // Rows are read front to back during an epoch
+    posix_madvise(map, file->map_size, POSIX_MADV_SEQUENTIAL);
+
+    return file;
+}
+
+
+void syn_tensor_close(SynTensorFile *file) {
+    if (!file) return;
+
+    munmap(file->map, file->map_size);
+    free(file);
+}
+
+
+long syn_tensor_num_rows(const SynTensorFile *file) {
+    return file ? file->num_rows : 0;
+}
+
+
+long syn_tensor_num_cols(const SynTensorFile *file) {
+    return file ? file->num_cols : 0;
+}
+
+
+SynDtype syn_tensor_dtype(const SynTensorFile *file) {
+    return file ? file->dtype : (SynDtype)0;
+}
+
+
+const void* syn_tensor_data(const SynTensorFile *file) {
+    return file ? file->data : NULL;
+}
+
+
+const void* syn_tensor_row(const SynTensorFile *file, long row) {
+    if (!file || row < 0 || row >= file->num_rows) return NULL;
+    return file->data + (size_t)row * file->row_size;
+}
+
+
+FILE* syn_tensor_write_begin(const char *filename, SynDtype dtype, long num_cols) {
+    if (!filename || syn_dtype_size(dtype) == 0 || num_cols <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for writing a tensor file.\n");
+        return NULL;
+    }
+
+    FILE *stream = fopen(filename, "wb");
+    if (!stream) {
+        fprintf(stderr, "Error: Failed to open file '%s' for writing.\n", filename);
+        return NULL;
+    }
+
+    // Placeholder until the row count is known
+    unsigned char header[TENSOR_HEADER_SIZE];
+    encode_header(header, dtype, 0, num_cols);
+
+    if (fwrite(header, 1, TENSOR_HEADER_SIZE, stream) != TENSOR_HEADER_SIZE) {
+        fprintf(stderr, "Error: Failed to write to '%s'.\n", filename);
+        fclose(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+int syn_tensor_write_rows(FILE *stream, SynDtype dtype, const void *rows, long num_rows, long num_cols) {
+    if (!stream || !rows || num_rows < 0 || num_cols <= 0) {
+        fprintf(stderr, "Error: Invalid input parameters for writing tensor rows.\n");
+        return 1;
+    }
+
+    size_t count = (size_t)num_rows * num_cols;
+    if (fwrite(rows, syn_dtype_size(dtype), count, stream) != count) {
+        fprintf(stderr, "Error: Failed to write tensor rows.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int syn_tensor_write_end(FILE *stream, SynDtype dtype, long num_rows, long num_cols) {
+    if (!stream) return 1;
+
+    unsigned char header[TENSOR_HEADER_SIZE];
+    encode_header(header, dtype, num_rows, num_cols);
+
+    int ok = fseek(stream, 0, SEEK_SET) == 0 && fwrite(header, 1, TENSOR_HEADER_SIZE, stream) == TENSOR_HEADER_SIZE;
+    if (fclose(stream) != 0) ok = 0;
+
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to finish the tensor file.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int syn_tensor_write(const char *filename, SynDtype dtype, const void *data, long num_rows, long num_cols) {
+    FILE *stream = syn_tensor_write_begin(filename, dtype, num_cols);
+    if (!stream) return 1;
+
+    if (syn_tensor_write_rows(stream, dtype, data, num_rows, num_cols)) {
+        fclose(stream);
+        return 1;
+    }
+
+    return syn_tensor_write_end(stream, dtype, num_rows, num_cols);
+}
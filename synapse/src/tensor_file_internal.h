@@ -0,0 +1,22 @@
+#ifndef TENSOR_FILE_INTERNAL_H
+#define TENSOR_FILE_INTERNAL_H
+
+#include <stdint.h>
+
+#include "tensor_file.h"
+
+#define TENSOR_HEADER_SIZE 64
+
+
+typedef struct {
+    SynDtype dtype;
+    uint64_t num_rows;
+    uint64_t num_cols;
+    uint64_t data_offset;
+} TensorHeader;
+
+// Decodes and validates the first TENSOR_HEADER_SIZE bytes of a file of
+// file_size bytes; errors are reported against filename
+int decode_tensor_header(const unsigned char *bytes, uint64_t file_size, const char *filename, TensorHeader *header);
+
+#endif
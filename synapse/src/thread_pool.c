@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+#include "kernels/kernels.h"
+
+
+typedef struct {
+    ThreadPool *pool;
+    int thread_id;
+} WorkerArgs;
+
+
+struct ThreadPool {
+    int num_threads;
+    pthread_t *threads;
+    WorkerArgs *args;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    void (*task)(void *, int, int);
+    void *arg;
+    unsigned long generation;
+    int pending;
+    int stop;
+};
+
+
+static void* worker_main(void *data) {
+    WorkerArgs *args = (WorkerArgs *)data;
+    ThreadPool *pool = args->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+
+        if (pool->stop) break;
+
+        seen = pool->generation;
+        void (*task)(void *, int, int) = pool->task;
+        void *arg = pool->arg;
+
+        pthread_mutex_unlock(&pool->mutex);
+        task(arg, args->thread_id, pool->num_threads);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    kernel_release_buffers();
+    return NULL;
+}
+
+
+ThreadPool* thread_pool_create(int num_threads) {
+    if (num_threads <= 0) {
+        fprintf(stderr, "Error: Invalid number of threads for the thread pool.\n");
+        return NULL;
+    }
+
+    ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        fprintf(stderr, "Error: Memory allocation failed for the thread pool.\n");
+        return NULL;
+    }
+
+    pool->num_threads = num_threads;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (num_threads == 1) return pool;
+
+    pool->threads = (pthread_t *)malloc((num_threads - 1) * sizeof(pthread_t));
+    pool->args = (WorkerArgs *)malloc((num_threads - 1) * sizeof(WorkerArgs));
+    if (!pool->threads || !pool->args) {
+        fprintf(stderr, "Error: Memory allocation failed for the thread pool.\n");
+        pool->num_threads = 1;
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_threads - 1; ++i) {
+        pool->args[i].pool = pool;
+        pool->args[i].thread_id = i + 1;
+
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread %d.\n", i + 1);
+            pool->num_threads = i + 1;
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+
+void thread_pool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->num_threads - 1; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+
+    free(pool->threads);
+    free(pool->args);
+    free(pool);
+}
+
+
+int thread_pool_size(const ThreadPool *pool) {
+    return pool ? pool->num_threads : 0;
+}
+
+
+void thread_pool_run(ThreadPool *pool, void (*task)(void *arg, int thread_id, int num_threads), void *arg) {
+    if (pool->num_threads == 1) {
+        task(arg, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->arg = arg;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    task(arg, 0, pool->num_threads);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+
+int thread_pool_default_size(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+}
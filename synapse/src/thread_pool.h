@@ -0,0 +1,25 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef struct ThreadPool ThreadPool;
+
+// Creates a pool of num_threads - 1 workers; the calling thread takes part
+// in every run as thread 0.
+ThreadPool* thread_pool_create(int num_threads);
+void thread_pool_destroy(ThreadPool *pool);
+int thread_pool_size(const ThreadPool *pool);
+
+// Number of online CPUs, at least 1
+int thread_pool_default_size(void);
+
+// Runs task(arg, thread_id, num_threads) once on every thread of the pool
+// and returns when all of them have finished.
+void thread_pool_run(ThreadPool *pool, void (*task)(void *arg, int thread_id, int num_threads), void *arg);
+
+// Even split of [0, total) into num_parts contiguous ranges.
+static inline void thread_pool_range(long total, int part, int num_parts, long *begin, long *end) {
+    *begin = total * part / num_parts;
+    *end = total * (part + 1) / num_parts;
+}
+
+#endif
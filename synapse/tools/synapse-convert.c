@@ -0,0 +1,217 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <zlib.h>
+
+#include "loader.h"
+#include "tensor_file.h"
+
+// Converts CSV files (as produced by mnist2csv.py) or IDX files, raw or
+// gzip-compressed, into tensor files:
+//
+//   synapse-convert data <data.csv|images-idx[.gz]> <data.syt> [--u8]
+//   synapse-convert labels <labels.csv|labels-idx[.gz]> <labels.syt> <num_classes> [--classes]
+//
+// Data rows keep their column count, labels become one-hot float rows, or
+// a single int32 class index column with --classes.
+// IDX images are scaled to [-1, 1] unless --u8 keeps the raw pixels.
+
+#define ROWS_PER_WRITE 1024
+
+
+void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s data <data.csv|images-idx[.gz]> <out.syt> [--u8]\n"
+        "       %s labels <labels.csv|labels-idx[.gz]> <out.syt> <num_classes> [--classes]\n", prog, prog);
+}
+
+
+long count_fields(const char *line) {
+    long count = 1;
+    for (const char *p = line; *p && *p != '\n' && *p != '\r'; ++p) {
+        count += (*p == ',');
+    }
+    return count;
+}
+
+
+// Parses exactly num_cols comma-separated floats from line into row
+int parse_row(const char *line, float *row, long num_cols) {
+    const char *p = line;
+
+    for (long j = 0; j < num_cols; ++j) {
+        char *end;
+        errno = 0;
+        row[j] = strtof(p, &end);
+        if (end == p || errno == ERANGE) return 1;
+
+        p = end;
+        if (j + 1 < num_cols) {
+            if (*p != ',') return 1;
+            ++p;
+        }
+    }
+
+    while (*p == ' ' || *p == '\r' || *p == '\n') ++p;
+    return *p != '\0';
+}
+
+
+int convert(const char *src, const char *dst, long num_classes, int as_classes) {
+    FILE *in = fopen(src, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Failed to open file '%s'.\n", src);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    const SynDtype dtype = as_classes ? SYN_DTYPE_I32 : SYN_DTYPE_F32;
+    long num_cols = as_classes ? 1 : num_classes;
+    long num_rows = 0;
+    long buffered = 0;
+    float *rows = NULL;
+    FILE *out = NULL;
+    int status = 1;
+
+    for (long line_no = 1; getline(&line, &line_cap, in) != -1; ++line_no) {
+        if (line[0] == '\n' || line[0] == '\r') continue;
+
+        if (!out) {
+            if (num_classes == 0) num_cols = count_fields(line);
+
+            rows = (float *)malloc((size_t)ROWS_PER_WRITE * num_cols * sizeof(float));
+            out = syn_tensor_write_begin(dst, dtype, num_cols);
+            if (!rows || !out) goto done;
+        }
+
+        float *row = &rows[(size_t)buffered * num_cols];
+
+        if (num_classes > 0) {
+            char *end;
+            long label = strtol(line, &end, 10);
+            if (end == line || label < 0 || label >= num_classes) {
+                fprintf(stderr, "Error: %s:%ld: invalid label.\n", src, line_no);
+                goto done;
+            }
+
+            if (as_classes) {
+                int32_t index = (int32_t)label;
+                memcpy(row, &index, sizeof(index));
+            } else {
+                memset(row, 0, num_cols * sizeof(float));
+                row[label] = 1.0f;
+            }
+        } else if (parse_row(line, row, num_cols)) {
+            fprintf(stderr, "Error: %s:%ld: expected %ld numeric fields.\n", src, line_no, num_cols);
+            goto done;
+        }
+
+        if (++buffered == ROWS_PER_WRITE) {
+            if (syn_tensor_write_rows(out, dtype, rows, buffered, num_cols)) goto done;
+            num_rows += buffered;
+            buffered = 0;
+        }
+    }
+
+    if (!out) {
+        fprintf(stderr, "Error: '%s' contains no rows.\n", src);
+        goto done;
+    }
+
+    if (syn_tensor_write_rows(out, dtype, rows, buffered, num_cols)) goto done;
+    num_rows += buffered;
+
+    status = syn_tensor_write_end(out, dtype, num_rows, num_cols);
+    out = NULL;
+
+    if (status == 0) {
+        printf("%s: %ld rows x %ld columns -> %s\n", src, num_rows, num_cols, dst);
+    }
+
+done:
+    if (out) {
+        fclose(out);
+        remove(dst);
+    }
+    free(rows);
+    free(line);
+    fclose(in);
+    return status;
+}
+
+
+// IDX files start with two zero bytes, which no CSV file does
+int is_idx(const char *filename) {
+    gzFile file = gzopen(filename, "rb");
+    if (!file) return 0;
+
+    unsigned char magic[2];
+    int idx = gzread(file, magic, 2) == 2 && magic[0] == 0 && magic[1] == 0;
+
+    gzclose(file);
+    return idx;
+}
+
+
+int convert_idx(const char *src, const char *dst, long num_classes, int as_classes, int keep_u8) {
+    int num_samples = 0, num_cols = 0;
+    void *data = NULL;
+    SynDtype dtype = SYN_DTYPE_F32;
+
+    if (num_classes > 0 && as_classes) {
+        num_cols = 1;
+        dtype = SYN_DTYPE_I32;
+        data = read_idx_classes(src, &num_samples, (int)num_classes);
+    } else if (num_classes > 0) {
+        num_cols = (int)num_classes;
+        data = read_idx_labels(src, &num_samples, num_cols);
+    } else if (keep_u8) {
+        dtype = SYN_DTYPE_U8;
+        data = read_idx_images_u8(src, &num_samples, &num_cols);
+    } else {
+        data = read_idx_images(src, &num_samples, &num_cols);
+    }
+
+    if (!data) return 1;
+
+    int status = syn_tensor_write(dst, dtype, data, num_samples, num_cols);
+    free(data);
+
+    if (status == 0) {
+        printf("%s: %d rows x %d columns -> %s\n", src, num_samples, num_cols, dst);
+    }
+
+    return status;
+}
+
+
+int main(int argc, char **argv) {
+    if ((argc == 4 || (argc == 5 && strcmp(argv[4], "--u8") == 0)) && strcmp(argv[1], "data") == 0) {
+        if (is_idx(argv[2])) return convert_idx(argv[2], argv[3], 0, 0, argc == 5);
+
+        if (argc == 5) {
+            fprintf(stderr, "Error: --u8 is only supported for IDX images.\n");
+            return 1;
+        }
+        return convert(argv[2], argv[3], 0, 0);
+    }
+
+    if ((argc == 5 || (argc == 6 && strcmp(argv[5], "--classes") == 0)) && strcmp(argv[1], "labels") == 0) {
+        long num_classes = strtol(argv[4], NULL, 10);
+        if (num_classes <= 0) {
+            fprintf(stderr, "Error: Invalid number of classes '%s'.\n", argv[4]);
+            return 1;
+        }
+
+        if (is_idx(argv[2])) return convert_idx(argv[2], argv[3], num_classes, argc == 6, 0);
+        return convert(argv[2], argv[3], num_classes, argc == 6);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "dataset.h"
+#include "model.h"
+#include "utils.h"
+
+// Quantizes a trained model to INT8, or converts its weights to FP16/BF16,
+// and reports its accuracy and largest output difference against the fp32
+// model on the test split:
+//
+//   synapse-quantize <model.bin> <data.syt> <labels.syt> <out.bin> [calib_samples | --f16 | --bf16]
+//
+// The dataset is split 80/20 like mnist_training; for INT8 the first
+// calib_samples (default 1000) training samples calibrate the activation
+// scales.
+
+#define DEFAULT_CALIB_SAMPLES 1000
+#define EVAL_BATCH 256
+
+
+typedef struct {
+    long correct;
+    long agree;
+    float max_diff;
+} EvalResult;
+
+
+// Label of sample i: its class index, or the argmax of a one-hot row
+int sample_label(const SynDataset *ds, long i) {
+    if (syn_dataset_has_classes(ds)) return syn_dataset_class(ds, i);
+
+    const float *labels;
+    syn_dataset_sample(ds, i, &labels);
+    return find_max_index(labels, syn_dataset_label_size(ds));
+}
+
+
+// Counts the correct predictions of quantized and fp32 on the test set and
+// how often they agree
+int evaluate(const SynModel *fp32, const SynModel *quantized, const SynDataset *test, EvalResult *fp32_result,
+    EvalResult *quant_result
+) {
+    const int input_size = syn_model_input_size(fp32);
+    const int output_size = syn_model_output_size(fp32);
+
+    SynInferCtx *fp32_ctx = syn_create_infer_ctx(fp32, EVAL_BATCH);
+    SynInferCtx *quant_ctx = syn_create_infer_ctx(quantized, EVAL_BATCH);
+    float *inputs = (float *)malloc((size_t)EVAL_BATCH * input_size * sizeof(float));
+    int status = 1;
+
+    if (!fp32_ctx || !quant_ctx || !inputs) goto done;
+
+    *fp32_result = (EvalResult){ 0, 0, 0.0f };
+    *quant_result = (EvalResult){ 0, 0, 0.0f };
+
+    for (long start = 0; start < syn_dataset_size(test); start += EVAL_BATCH) {
+        long count = syn_dataset_size(test) - start;
+        if (count > EVAL_BATCH) count = EVAL_BATCH;
+
+        for (long b = 0; b < count; ++b) {
+            memcpy(&inputs[b * input_size], syn_dataset_sample(test, start + b, NULL), input_size * sizeof(float));
+        }
+
+        const float *fp32_out = syn_infer_batch(fp32_ctx, inputs, (int)count);
+        if (!fp32_out) goto done;
+
+        // The contexts keep their outputs until the next call
+        const float *quant_out = syn_infer_batch(quant_ctx, inputs, (int)count);
+        if (!quant_out) goto done;
+
+        for (long b = 0; b < count; ++b) {
+            int label = sample_label(test, start + b);
+            int fp32_pred = find_max_index(&fp32_out[b * output_size], output_size);
+            int quant_pred = find_max_index(&quant_out[b * output_size], output_size);
+
+            fp32_result->correct += (fp32_pred == label);
+            quant_result->correct += (quant_pred == label);
+            quant_result->agree += (quant_pred == fp32_pred);
+
+            for (int i = 0; i < output_size; ++i) {
+                float diff = fabsf(quant_out[b * output_size + i] - fp32_out[b * output_size + i]);
+                if (diff > quant_result->max_diff) quant_result->max_diff = diff;
+            }
+        }
+    }
+
+    status = 0;
+
+done:
+    syn_delete_infer_ctx(fp32_ctx);
+    syn_delete_infer_ctx(quant_ctx);
+    free(inputs);
+    return status;
+}
+
+
+// INT8 model calibrated on the first calib_samples samples of train
+SynModel* quantize_int8(const SynModel *model, const SynDataset *train, long calib_samples) {
+    const int input_size = syn_model_input_size(model);
+    float *calib = (float *)malloc((size_t)calib_samples * input_size * sizeof(float));
+    if (!calib) {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return NULL;
+    }
+
+    for (long i = 0; i < calib_samples; ++i) {
+        memcpy(&calib[i * input_size], syn_dataset_sample(train, i, NULL), input_size * sizeof(float));
+    }
+
+    SynModel *quantized = syn_quantize_model(model, calib, (int)calib_samples);
+    free(calib);
+    return quantized;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: %s <model.bin> <data.syt> <labels.syt> <out.bin> [calib_samples | --f16 | --bf16]\n",
+            argv[0]);
+        return 1;
+    }
+
+    // -1 for INT8
+    int half_type = -1;
+    if (argc == 6 && strcmp(argv[5], "--f16") == 0) half_type = SYN_HALF_F16;
+    if (argc == 6 && strcmp(argv[5], "--bf16") == 0) half_type = SYN_HALF_BF16;
+
+    long calib_samples = (argc == 6 && half_type < 0) ? strtol(argv[5], NULL, 10) : DEFAULT_CALIB_SAMPLES;
+    if (calib_samples <= 0) {
+        fprintf(stderr, "Error: Invalid number of calibration samples '%s'.\n", argv[5]);
+        return 1;
+    }
+
+    SynModel *model = syn_load_model(argv[1]);
+    SynDataset *dataset = model ? syn_dataset_from_tensors(argv[2], argv[3]) : NULL;
+    SynDataset *train = NULL, *test = NULL;
+    SynModel *quantized = NULL;
+    int status = 1;
+
+    if (!dataset || syn_dataset_split(dataset, 0.2f, &train, &test)) goto done;
+
+    if (syn_dataset_input_size(dataset) != syn_model_input_size(model)) {
+        fprintf(stderr, "Error: Model expects %d inputs, the dataset has %d.\n",
+            syn_model_input_size(model), syn_dataset_input_size(dataset));
+        goto done;
+    }
+
+    if (half_type < 0 && calib_samples > syn_dataset_size(train)) calib_samples = syn_dataset_size(train);
+
+    quantized = (half_type >= 0) ? syn_model_to_half(model, (SynHalfType)half_type) :
+        quantize_int8(model, train, calib_samples);
+    if (!quantized || syn_save_model(quantized, argv[4])) goto done;
+
+    const char *format = (half_type == SYN_HALF_F16) ? "f16" : (half_type == SYN_HALF_BF16) ? "bf16" : "int8";
+    EvalResult fp32_result, quant_result;
+    if (evaluate(model, quantized, test, &fp32_result, &quant_result)) goto done;
+
+    long test_count = syn_dataset_size(test);
+    float fp32_acc = (float)fp32_result.correct / test_count * 100;
+    float quant_acc = (float)quant_result.correct / test_count * 100;
+
+    if (half_type < 0) printf("Calibrated on %ld samples.\n", calib_samples);
+    printf("Evaluated on %ld samples.\n", test_count);
+    printf("fp32 accuracy: %.2f%%\n", fp32_acc);
+    printf("%s accuracy: %.2f%% (%+.2f points)\n", format, quant_acc, quant_acc - fp32_acc);
+    printf("Predictions agreeing with fp32: %.2f%%\n", (float)quant_result.agree / test_count * 100);
+    printf("Largest output difference: %g\n", quant_result.max_diff);
+    printf("Saved '%s'.\n", argv[4]);
+
+    status = 0;
+
+done:
+    syn_delete_model(quantized);
+    syn_delete_model(model);
+    syn_dataset_delete(train);
+    syn_dataset_delete(test);
+    syn_dataset_delete(dataset);
+    return status;
+}